@@ -0,0 +1,128 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <new>
+#include <cstdlib>
+#include "library.hpp"
+#include "book.hpp"
+#include "user.hpp"
+
+using namespace std;
+
+/**
+ * @brief Allocation count of a full catalogue display.
+ *
+ * Fills a library with books whose fields are too long for the small string buffer, then counts
+ * the heap allocations of listing and printing the whole catalogue, then of reading it through
+ * the Book getters, once by reference (the current accessors) and once by copy (what the by-value
+ * getters used to cost). The output is sent to a stream with no buffer so printing allocates nothing.
+ *
+ * Usage: display_alloc_bench [books]   (default: 100000)
+ */
+
+/* The number of calls to the global operator new since the start of the program. */
+static size_t allocation_count = 0;
+
+void *operator new(size_t size)
+{
+    allocation_count++;
+    if(void *block = malloc(size == 0 ? 1 : size))
+    {
+        return block;
+    }
+    throw bad_alloc();
+}
+
+void operator delete(void *block) noexcept
+{
+    free(block);
+}
+
+void operator delete(void *block, size_t) noexcept
+{
+    free(block);
+}
+
+/* Sink preventing the compiler from dropping the copies. */
+static volatile size_t sink;
+
+/**
+ * @brief Counts the allocations of an operation.
+ *
+ * @param operation The operation to measure.
+ * @return size_t The number of calls to operator new made by the operation.
+*/
+template <typename Operation>
+static size_t CountAllocations(Operation operation)
+{
+    size_t before = allocation_count;
+    operation();
+    return allocation_count - before;
+}
+
+/**
+ * @brief Prints one line of the report.
+ *
+ * @param name The name of the measured display.
+ * @param allocations The allocations of the display.
+ * @param books The number of books displayed.
+*/
+static void Report(const string &name, size_t allocations, size_t books)
+{
+    cerr << name << ": " << allocations << " allocations (" << static_cast<double>(allocations) / books
+    << " per book)\n";
+}
+
+int main(int argc, char **argv)
+{
+    size_t book_count = (argc > 1) ? strtoull(argv[1], nullptr, 10) : 100000;
+
+    // Fill the library with books whose fields do not fit in the small string buffer
+    Library library;
+    for(size_t i = 0; i < book_count; i++)
+    {
+        string suffix = to_string(i);
+        library.EmplaceBook("Introduction to Volume " + suffix, "Professor Number " + suffix,
+                            "Category Of Books " + to_string(i % 32), "S" + to_string(i % 1000000));
+    }
+    vector<shared_ptr<Book>> books = library.QueryBooks(BookQuery());
+
+    // Silence cout, a stream without buffer drops the characters without allocating
+    streambuf *saved = cout.rdbuf(nullptr);
+
+    size_t display = CountAllocations([&library]()
+    {
+        for(const shared_ptr<Book> &book : library.GetAllBooks())
+        {
+            cout << book->GetBookNumber() << book->GetBookName() << book->GetBookGener() << book->GetBookAuthor();
+        }
+    });
+
+    size_t by_reference = CountAllocations([&books]()
+    {
+        for(const shared_ptr<Book> &book : books)
+        {
+            cout << book->GetBookNumber() << book->GetBookName() << book->GetBookGener() << book->GetBookAuthor();
+        }
+    });
+
+    size_t by_copy = CountAllocations([&books]()
+    {
+        for(const shared_ptr<Book> &book : books)
+        {
+            string isbn = book->GetBookNumber();
+            string name = book->GetBookName();
+            string genre = book->GetBookGener();
+            string author = book->GetBookAuthor();
+            sink = isbn.size() + name.size() + genre.size() + author.size();
+        }
+    });
+
+    cout.rdbuf(saved);
+
+    Report("Library::GetAllBooks and print", display, books.size());
+    Report("Book getters by reference", by_reference, books.size());
+    Report("Book getters by copy", by_copy, books.size());
+
+    return 0;
+}
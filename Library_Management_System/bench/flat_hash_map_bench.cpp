@@ -0,0 +1,128 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cstdlib>
+#include <unordered_map>
+#include "flat_hash_map.hpp"
+#include "isbn_key.hpp"
+#include "book.hpp"
+#include "user.hpp"
+
+using namespace std;
+
+/**
+ * @brief Micro-benchmark of the catalogue hash maps.
+ *
+ * Compares the node based std::unordered_map the library used to keep its books and users in
+ * with the flat open addressing FlatHashMap, for the same key and value types as the library
+ * tables (IsbnKey -> shared_ptr<Book> and int -> unique_ptr<User>). The values are left empty
+ * so only the cost of the tables is measured.
+ *
+ * Usage: flat_hash_map_bench [entries...]   (default: 1000000)
+ */
+
+/* Sink preventing the compiler from dropping the lookups. */
+static volatile size_t sink;
+
+/**
+ * @brief Measures the average time of an operation repeated over a list of keys.
+ *
+ * @param keys The keys the operation is applied to.
+ * @param operation The operation to time.
+ * @return double The average time of one operation in nanoseconds.
+*/
+template <typename Key, typename Operation>
+static double TimePerOperation(const vector<Key> &keys, Operation operation)
+{
+    auto start = chrono::steady_clock::now();
+    for(const Key &key : keys)
+    {
+        operation(key);
+    }
+    auto stop = chrono::steady_clock::now();
+
+    return chrono::duration<double, nano>(stop - start).count() / static_cast<double>(keys.size());
+}
+
+/**
+ * @brief Runs the insert, hit lookup, miss lookup and erase phases on one map type.
+ *
+ * @param name The name of the map printed in the report.
+ * @param present The keys inserted in the map.
+ * @param absent Keys that are never inserted.
+*/
+template <typename Map, typename Key>
+static void RunMap(const string &name, const vector<Key> &present, const vector<Key> &absent)
+{
+    Map map;
+    size_t found = 0;
+
+    double insert_ns = TimePerOperation(present, [&map](const Key &key) { map.emplace(key, nullptr); });
+    double hit_ns = TimePerOperation(present, [&map, &found](const Key &key) { found += (map.find(key) != map.end()); });
+    double miss_ns = TimePerOperation(absent, [&map, &found](const Key &key) { found += (map.find(key) != map.end()); });
+    double erase_ns = TimePerOperation(present, [&map](const Key &key) { map.erase(key); });
+
+    sink = found;
+
+    cout << setw(12) << present.size() << "  " << left << setw(44) << name << right << fixed << setprecision(1)
+         << setw(10) << insert_ns << setw(10) << hit_ns << setw(10) << miss_ns << setw(10) << erase_ns << "\n";
+}
+
+int main(int argc, char *argv[])
+{
+    // The table sizes to measure.
+    vector<size_t> sizes;
+    for(int i = 1; i < argc; i++)
+    {
+        sizes.push_back(static_cast<size_t>(strtoull(argv[i], nullptr, 10)));
+    }
+    if(sizes.empty())
+    {
+        sizes.push_back(1000000);
+    }
+
+    // Fixed seed so every run probes the tables in the same order.
+    mt19937_64 generator(42);
+
+    cout << setw(12) << "entries" << "  " << left << setw(44) << "map" << right
+         << setw(10) << "insert" << setw(10) << "hit" << setw(10) << "miss" << setw(10) << "erase" << "  (ns/op)\n";
+
+    for(size_t n : sizes)
+    {
+        // Book keys: distinct 13 digit numbers, the misses lie past the inserted range.
+        vector<IsbnKey> isbn_present, isbn_absent;
+        isbn_present.reserve(n);
+        isbn_absent.reserve(n);
+        for(size_t i = 0; i < n; i++)
+        {
+            isbn_present.push_back(IsbnKey::FromValue(9780000000000ULL + i));
+            isbn_absent.push_back(IsbnKey::FromValue(9790000000000ULL + i));
+        }
+        shuffle(isbn_present.begin(), isbn_present.end(), generator);
+        shuffle(isbn_absent.begin(), isbn_absent.end(), generator);
+
+        // User keys: the ids 0..n-1 and negative misses.
+        vector<int> id_present, id_absent;
+        id_present.reserve(n);
+        id_absent.reserve(n);
+        for(size_t i = 0; i < n; i++)
+        {
+            id_present.push_back(static_cast<int>(i));
+            id_absent.push_back(-1 - static_cast<int>(i));
+        }
+        shuffle(id_present.begin(), id_present.end(), generator);
+        shuffle(id_absent.begin(), id_absent.end(), generator);
+
+        RunMap<unordered_map<IsbnKey, shared_ptr<Book>, IsbnKeyHash>>("unordered_map<IsbnKey, shared_ptr<Book>>", isbn_present, isbn_absent);
+        RunMap<FlatHashMap<IsbnKey, shared_ptr<Book>, IsbnKeyHash>>("FlatHashMap<IsbnKey, shared_ptr<Book>>", isbn_present, isbn_absent);
+        RunMap<unordered_map<int, unique_ptr<User>>>("unordered_map<int, unique_ptr<User>>", id_present, id_absent);
+        RunMap<FlatHashMap<int, unique_ptr<User>>>("FlatHashMap<int, unique_ptr<User>>", id_present, id_absent);
+    }
+
+    return 0;
+}
@@ -0,0 +1,433 @@
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <numeric>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <benchmark/benchmark.h>
+#include "library.hpp"
+#include "book.hpp"
+#include "user.hpp"
+
+using namespace std;
+
+/**
+ * @brief Google Benchmark suite of the Library core.
+ *
+ * Every operation is measured on catalogues of 10^3 up to LIBRARY_BENCH_MAX_BOOKS books
+ * (default 10^6, set it to 10000000 for the 10^7 runs, which need several GB of memory), in
+ * powers of ten. The catalogues are generated from a fixed seed and built once per size, so
+ * two runs measure the same data. Operations that change the catalogue are undone in batches
+ * of BATCH outside the timed region, so the catalogue keeps its size however many iterations
+ * the framework runs.
+ *
+ * Usage: library_bench [--benchmark_filter=...] [--benchmark_format=json] [--benchmark_out=results.json]
+ */
+
+/* The number of timed operations between two untimed restorations of the catalogue. */
+static const size_t BATCH = 1024;
+
+/* The number of users registered in every catalogue. */
+static const int USER_COUNT = 10000;
+
+/* The genres of the generated books. */
+static const char *const GENRES[] = {"Mathematics", "Physics", "Medicine", "Law", "Sports", "History", "Poetry", "Biology"};
+
+/**
+ * @brief Writes a number in base 36, the way the generated serial numbers and title words are spelled.
+ *
+ * @param value The number.
+ * @return The digits, at least one.
+*/
+static string Base36(uint64_t value)
+{
+    static const char DIGITS[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+    string digits;
+    do
+    {
+        digits.insert(digits.begin(), DIGITS[value % 36]);
+        value /= 36;
+    } while(value != 0);
+    return digits;
+}
+
+/**
+ * @brief Gets the serial number of a generated book, a local serial of at most 7 characters.
+ *
+ * @param tag The first character, 'B' for the catalogue and 'N' for the books added by the benchmarks.
+ * @param index The index of the book.
+*/
+static string SerialOf(char tag, uint64_t index)
+{
+    return tag + Base36(index);
+}
+
+/**
+ * @brief Gets the word of the title unique to a generated book.
+*/
+static string TitleWordOf(uint64_t index)
+{
+    return "w" + Base36(index);
+}
+
+/**
+ * @brief Gets a library of a given number of books, generated on the first call for that size.
+ *
+ * @param books The number of books of the catalogue.
+ * @return Library& The library, shared by every benchmark of that size.
+*/
+static Library &LibraryOf(size_t books)
+{
+    static mutex guard;
+    static map<size_t, unique_ptr<Library>> libraries;
+
+    lock_guard<mutex> lock(guard);
+    unique_ptr<Library> &library = libraries[books];
+    if(library == nullptr)
+    {
+        library.reset(new Library());
+
+        // Ten books per author, fixed seed for the order of the words
+        mt19937_64 random(books);
+        vector<BookRecord> records(books);
+        for(size_t i = 0; i < books; i++)
+        {
+            records[i].title = "Volume " + TitleWordOf(i) + " of " + GENRES[random() % 8];
+            records[i].author = "Author " + to_string(i / 10);
+            records[i].gener = GENRES[i % 8];
+            records[i].ISBN = SerialOf('B', i);
+        }
+        library->ImportBooks(records);
+
+        for(int id = 1; id <= USER_COUNT; id++)
+        {
+            library->EmplaceUser("Reader " + to_string(id), id);
+        }
+    }
+    return *library;
+}
+
+static void BM_AddNewBookToLibrary(benchmark::State &state)
+{
+    Library &library = LibraryOf(state.range(0));
+    uint64_t next = 0;
+    vector<string> added;
+    added.reserve(BATCH);
+
+    for(auto _ : state)
+    {
+        string serial = SerialOf('N', next++);
+        benchmark::DoNotOptimize(library.AddNewBookToLibrary(new Book("Added " + serial, "Benchmark", "Mathematics", serial)));
+        added.push_back(std::move(serial));
+
+        if(added.size() == BATCH)
+        {
+            state.PauseTiming();
+            for(const string &ISBN : added)
+            {
+                library.RemoveBookFromLibrary(ISBN);
+            }
+            added.clear();
+            state.ResumeTiming();
+        }
+    }
+
+    for(const string &ISBN : added)
+    {
+        library.RemoveBookFromLibrary(ISBN);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_RemoveBookFromLibrary(benchmark::State &state)
+{
+    Library &library = LibraryOf(state.range(0));
+    uint64_t next = 0;
+    vector<string> added;
+
+    for(auto _ : state)
+    {
+        if(added.empty())
+        {
+            state.PauseTiming();
+            for(size_t i = 0; i < BATCH; i++)
+            {
+                string serial = SerialOf('N', next++);
+                library.EmplaceBook("Added " + serial, "Benchmark", "Mathematics", serial);
+                added.push_back(std::move(serial));
+            }
+            state.ResumeTiming();
+        }
+
+        benchmark::DoNotOptimize(library.RemoveBookFromLibrary(added.back()));
+        added.pop_back();
+    }
+
+    for(const string &ISBN : added)
+    {
+        library.RemoveBookFromLibrary(ISBN);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_RegisterNewUser(benchmark::State &state)
+{
+    Library &library = LibraryOf(state.range(0));
+    int next = USER_COUNT + 1;
+    vector<int> added;
+    added.reserve(BATCH);
+
+    for(auto _ : state)
+    {
+        benchmark::DoNotOptimize(library.RegisterNewUser(new User("Visitor", next)));
+        added.push_back(next++);
+
+        if(added.size() == BATCH)
+        {
+            state.PauseTiming();
+            for(int id : added)
+            {
+                library.RemoveUserFromLibrary(id);
+            }
+            added.clear();
+            state.ResumeTiming();
+        }
+    }
+
+    for(int id : added)
+    {
+        library.RemoveUserFromLibrary(id);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+/**
+ * @brief Picks the books and borrowers of the loans of a benchmark thread.
+ *
+ * Every thread draws its books from its own stride of the catalogue, so two threads never
+ * compete for the same book and every loan succeeds.
+*/
+static vector<loan_request_t> LoansOf(const benchmark::State &state, size_t count)
+{
+    size_t books = static_cast<size_t>(state.range(0));
+    size_t threads = static_cast<size_t>(state.threads());
+    size_t stride = books / threads;
+    mt19937_64 random(state.thread_index() + 1);
+
+    // i * step + offset visits every book of the stride once when step is coprime with it,
+    // so the count <= stride loans name distinct books
+    size_t step = 7919;
+    while(gcd(step, stride) != 1)
+    {
+        step += 2;
+    }
+    size_t offset = random() % stride;
+
+    vector<loan_request_t> loans(count);
+    for(size_t i = 0; i < count; i++)
+    {
+        size_t book = state.thread_index() * stride + (i * step + offset) % stride;
+        loans[i].user_id = static_cast<int>(1 + (state.thread_index() * 131 + i) % USER_COUNT);
+        loans[i].key = IsbnKey::FromString(SerialOf('B', book));
+    }
+    return loans;
+}
+
+static void BM_UserBorrowBook(benchmark::State &state)
+{
+    Library &library = LibraryOf(state.range(0));
+    vector<loan_request_t> loans = LoansOf(state, min<size_t>(BATCH, state.range(0) / state.threads()));
+    size_t next = 0;
+
+    for(auto _ : state)
+    {
+        benchmark::DoNotOptimize(library.UserBorrowBook(loans[next].user_id, loans[next].key));
+        if(++next == loans.size())
+        {
+            state.PauseTiming();
+            library.ReturnBooks(loans.data(), loans.size());
+            next = 0;
+            state.ResumeTiming();
+        }
+    }
+
+    library.ReturnBooks(loans.data(), next);
+    state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_UserReturnBook(benchmark::State &state)
+{
+    Library &library = LibraryOf(state.range(0));
+    vector<loan_request_t> loans = LoansOf(state, min<size_t>(BATCH, state.range(0) / state.threads()));
+    size_t next = loans.size();
+
+    for(auto _ : state)
+    {
+        if(next == loans.size())
+        {
+            state.PauseTiming();
+            library.BorrowBooks(loans.data(), loans.size());
+            next = 0;
+            state.ResumeTiming();
+        }
+        benchmark::DoNotOptimize(library.UserReturnBook(loans[next].user_id, loans[next].key));
+        next++;
+    }
+
+    library.ReturnBooks(loans.data() + next, loans.size() - next);
+    state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_BorrowBooksBatch(benchmark::State &state)
+{
+    Library &library = LibraryOf(state.range(0));
+    vector<loan_request_t> loans = LoansOf(state, min<size_t>(20, state.range(0)));
+
+    // A self-checkout stack of 20 books, borrowed then returned
+    for(auto _ : state)
+    {
+        benchmark::DoNotOptimize(library.BorrowBooks(loans.data(), loans.size()));
+        benchmark::DoNotOptimize(library.ReturnBooks(loans.data(), loans.size()));
+    }
+    state.SetItemsProcessed(state.iterations() * loans.size() * 2);
+}
+
+static void BM_SearchForBooks(benchmark::State &state)
+{
+    Library &library = LibraryOf(state.range(0));
+    mt19937_64 random(42);
+
+    // A title word held by a single book
+    for(auto _ : state)
+    {
+        benchmark::DoNotOptimize(library.SearchForBooks(TitleWordOf(random() % state.range(0))));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_FuzzySearchBooks(benchmark::State &state)
+{
+    Library &library = LibraryOf(state.range(0));
+    mt19937_64 random(42);
+
+    // The title word of a book with its last two characters swapped, and a misspelled genre
+    for(auto _ : state)
+    {
+        string word = TitleWordOf(random() % state.range(0));
+        swap(word[word.size() - 2], word[word.size() - 1]);
+        benchmark::DoNotOptimize(library.FuzzySearchBooks(word + " Physcis"));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_SearchForBooksByAuthor(benchmark::State &state)
+{
+    Library &library = LibraryOf(state.range(0));
+    mt19937_64 random(42);
+
+    // An author of ten books
+    for(auto _ : state)
+    {
+        benchmark::DoNotOptimize(library.SearchForBooksByAuthor("Author " + to_string(random() % (state.range(0) / 10))));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_QueryAvailableByGenre(benchmark::State &state)
+{
+    Library &library = LibraryOf(state.range(0));
+    BookQuery query;
+    query.genre = "Physics";
+    query.availability = ONLY_AVAILABLE;
+
+    // An eighth of the catalogue
+    for(auto _ : state)
+    {
+        benchmark::DoNotOptimize(library.QueryBooks(query));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0) / 8);
+}
+
+static void BM_ListBooksPage(benchmark::State &state)
+{
+    Library &library = LibraryOf(state.range(0));
+    mt19937_64 random(42);
+
+    // A page of 50 books by title, from a cursor anywhere in the catalogue
+    for(auto _ : state)
+    {
+        BookCursor cursor;
+        cursor.title = "Volume " + TitleWordOf(random() % state.range(0));
+        cursor.ISBN = "B";
+        benchmark::DoNotOptimize(library.ListBooks(ORDER_BY_TITLE, cursor, 50));
+    }
+    state.SetItemsProcessed(state.iterations() * 50);
+}
+
+static void BM_DisplayAllBooks(benchmark::State &state)
+{
+    Library &library = LibraryOf(state.range(0));
+    int sink = open("/dev/null", O_WRONLY);
+    unique_ptr<ExportFormat> format = ExportFormat::Create(EXPORT_TEXT);
+
+    // The whole catalogue formatted as the console displays it
+    for(auto _ : state)
+    {
+        ExportBuffer out(sink);
+        benchmark::DoNotOptimize(library.ExportBooks(*format, out));
+    }
+
+    close(sink);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void BM_GetAllBooks(benchmark::State &state)
+{
+    Library &library = LibraryOf(state.range(0));
+
+    for(auto _ : state)
+    {
+        benchmark::DoNotOptimize(library.GetAllBooks());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+int main(int argc, char **argv)
+{
+    // The largest catalogue, 10^6 books unless the environment asks for more
+    const char *max_books = getenv("LIBRARY_BENCH_MAX_BOOKS");
+    int64_t largest = (max_books != nullptr) ? strtoll(max_books, nullptr, 10) : 1000000;
+
+    // The operations on one book, from 10^3 books up
+    void (*const single[])(benchmark::State &) = {BM_AddNewBookToLibrary, BM_RemoveBookFromLibrary, BM_RegisterNewUser,
+                                                  BM_UserBorrowBook, BM_UserReturnBook, BM_BorrowBooksBatch,
+                                                  BM_SearchForBooks, BM_FuzzySearchBooks, BM_SearchForBooksByAuthor, BM_ListBooksPage};
+    const char *const single_names[] = {"AddNewBookToLibrary", "RemoveBookFromLibrary", "RegisterNewUser",
+                                        "UserBorrowBook", "UserReturnBook", "BorrowBooksBatch",
+                                        "SearchForBooks", "FuzzySearchBooks", "SearchForBooksByAuthor", "ListBooksPage"};
+    for(size_t i = 0; i < sizeof(single) / sizeof(single[0]); i++)
+    {
+        benchmark::RegisterBenchmark(single_names[i], single[i])->RangeMultiplier(10)->Range(1000, largest);
+    }
+
+    // Loans and returns of disjoint books from several threads
+    benchmark::RegisterBenchmark("UserBorrowBook/contended", BM_UserBorrowBook)->Arg(largest)->ThreadRange(1, 8)->UseRealTime();
+
+    // The operations over the whole catalogue
+    benchmark::RegisterBenchmark("QueryAvailableByGenre", BM_QueryAvailableByGenre)->RangeMultiplier(10)->Range(1000, largest)->Unit(benchmark::kMicrosecond);
+    benchmark::RegisterBenchmark("GetAllBooks", BM_GetAllBooks)->RangeMultiplier(10)->Range(1000, largest)->Unit(benchmark::kMicrosecond);
+    benchmark::RegisterBenchmark("DisplayAllBooks", BM_DisplayAllBooks)->RangeMultiplier(10)->Range(1000, largest)->Unit(benchmark::kMillisecond);
+
+    benchmark::Initialize(&argc, argv);
+    if(benchmark::ReportUnrecognizedArguments(argc, argv))
+    {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
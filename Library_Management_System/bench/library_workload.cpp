@@ -0,0 +1,625 @@
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdint>
+#include <cmath>
+#include "library.hpp"
+#include "book.hpp"
+#include "user.hpp"
+
+using namespace std;
+
+/**
+ * @brief Seeded workload generator and multi-threaded replay driver of the Library API.
+ *
+ * The generator writes a trace of operations from a fixed seed, so the same arguments always
+ * give the same trace. It models the traffic of a university library:
+ *  - the books are borrowed and their titles searched with a Zipf popularity, a few titles
+ *    drawing most of the requests;
+ *  - the returns come in bursts, a return desk emptying its box in one go;
+ *  - the first tenth of the trace is the start of the semester, a storm of registrations.
+ * Every operation belongs to a client, and the operations of a user (or on a book added by the
+ * trace) always go to the same client, so they stay in order whatever the number of threads of
+ * the replay. Clients on different threads still race for the popular books, so with several
+ * threads some loans, and the returns of those loans, are refused as they would be at the desk.
+ *
+ * The replay driver builds the catalogue the trace was generated for, hands the clients out to
+ * its threads, replays every operation and reports the throughput and the p50/p99/p999 latency
+ * of each kind of operation.
+ *
+ * Usage: library_workload generate <trace> [books] [users] [operations] [clients] [seed]
+ *                                          (default: 100000 10000 1000000 64 42)
+ *        library_workload replay <trace> [threads]   (default: the number of cores)
+ */
+
+/**
+ * @brief Enumeration for the kinds of operations of a trace.
+ */
+typedef enum
+{
+    OP_BORROW,              /* A user borrows a book. */
+    OP_RETURN,              /* A user returns a book. */
+    OP_REGISTER,            /* A new user registers. */
+    OP_ADD_BOOK,            /* A new book joins the catalogue. */
+    OP_REMOVE_BOOK,         /* A book leaves the catalogue. */
+    OP_SEARCH_TITLE,        /* A search for a word of the titles. */
+    OP_SEARCH_AUTHOR,       /* A search for the books of an author. */
+    OP_LIST_PAGE,           /* A page of the catalogue in title order. */
+    OP_KIND_COUNT           /* The number of kinds, not a kind. */
+}operation_kind_t;
+
+/* The names of the kinds of operations in the trace and in the report. */
+static const char *const KIND_NAMES[OP_KIND_COUNT] = {"borrow", "return", "register", "add", "remove", "search", "author", "list"};
+
+/* The genres of the generated books. */
+static const char *const GENRES[] = {"Mathematics", "Physics", "Medicine", "Law", "Sports", "History", "Poetry", "Biology"};
+
+/* The exponent of the popularity of the books, the usual value for library circulation. */
+static const double ZIPF_EXPONENT = 0.99;
+
+/**
+ * @brief The size of the library a trace is generated for.
+ */
+struct WorkloadShape
+{
+    // The number of books of the catalogue.
+    size_t books = 100000;
+    // The number of users registered before the trace starts.
+    int users = 10000;
+    // The number of operations of the trace.
+    size_t operations = 1000000;
+    // The number of clients issuing the operations.
+    int clients = 64;
+    // The seed of the generator.
+    uint64_t seed = 42;
+};
+
+/**
+ * @brief An operation of a trace, decoded ahead of the replay so that only the call is timed.
+ */
+struct Operation
+{
+    // The kind of the operation.
+    operation_kind_t kind;
+    // The client issuing the operation.
+    int client;
+    // The user of a loan or a registration, 0 otherwise.
+    int user;
+    // The serial number, search terms or cursor title of the operation.
+    string text;
+    // The serial number of a loan, packed.
+    IsbnKey key;
+};
+
+/**
+ * @brief Writes a number in base 36, the way the generated serial numbers and title words are spelled.
+ *
+ * @param value The number.
+ * @return The digits, at least one.
+*/
+static string Base36(uint64_t value)
+{
+    static const char DIGITS[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+    string digits;
+    do
+    {
+        digits.insert(digits.begin(), DIGITS[value % 36]);
+        value /= 36;
+    } while(value != 0);
+    return digits;
+}
+
+/**
+ * @brief Gets the serial number of a book of the catalogue ('B') or added by the trace ('N').
+*/
+static string SerialOf(char tag, uint64_t index)
+{
+    return tag + Base36(index);
+}
+
+/**
+ * @brief Gets the word of the title unique to a book of the catalogue.
+*/
+static string TitleWordOf(uint64_t index)
+{
+    return "w" + Base36(index);
+}
+
+/**
+ * @brief Fills a library with the catalogue and the users a trace was generated for.
+ *
+ * @param library The library, empty.
+ * @param shape The size of the library.
+*/
+static void BuildLibrary(Library &library, const WorkloadShape &shape)
+{
+    // Ten books per author, the genre of the title drawn from the seed
+    mt19937_64 random(shape.seed);
+    vector<BookRecord> records(shape.books);
+    for(size_t i = 0; i < shape.books; i++)
+    {
+        records[i].title = "Volume " + TitleWordOf(i) + " of " + GENRES[random() % 8];
+        records[i].author = "Author " + to_string(i / 10);
+        records[i].gener = GENRES[i % 8];
+        records[i].ISBN = SerialOf('B', i);
+    }
+    library.ImportBooks(records);
+
+    for(int id = 1; id <= shape.users; id++)
+    {
+        library.EmplaceUser("Student " + to_string(id), id);
+    }
+}
+
+/**
+ * @brief Generates a trace, keeping track of the loans so that the returns are of borrowed books.
+ */
+class WorkloadGenerator
+{
+    private:
+        /* The size of the library. */
+        WorkloadShape shape;
+        /* The source of every random choice. */
+        mt19937_64 random;
+        /* The cumulative probability of the popularity ranks. */
+        vector<double> popularity;
+        /* The book of each popularity rank, so that the popular books are spread over the catalogue. */
+        vector<uint32_t> book_of_rank;
+        /* Whether each book of the catalogue is on the shelf, as far as the trace knows. */
+        vector<char> on_shelf;
+        /* The books on loan to each user, indexed by ID. */
+        vector<vector<uint32_t>> loans;
+        /* The users with at least one loan. */
+        vector<int> borrowers;
+        /* The books added by the trace and not removed yet. */
+        vector<uint64_t> added;
+        /* The number of books added by the trace. */
+        uint64_t added_count = 0;
+        /* The number of registered users. */
+        int user_count;
+
+        /**
+         * @brief Draws a number in [0, 1).
+        */
+        double Uniform()
+        {
+            // The top 53 bits, rather than a standard distribution whose output differs between libraries
+            return static_cast<double>(random() >> 11) * (1.0 / 9007199254740992.0);
+        }
+
+        /**
+         * @brief Draws a book of the catalogue by popularity.
+        */
+        uint32_t PopularBook()
+        {
+            size_t rank = upper_bound(popularity.begin(), popularity.end(), Uniform()) - popularity.begin();
+            return book_of_rank[min(rank, book_of_rank.size() - 1)];
+        }
+
+        /**
+         * @brief Writes one operation of the trace.
+        */
+        void Emit(ostream &trace, operation_kind_t kind, int client, int user, const string &text)
+        {
+            trace << client << ' ' << KIND_NAMES[kind] << ' ' << user << ' ' << text << '\n';
+        }
+
+        /**
+         * @brief Writes a loan of a popular book to a random user.
+        */
+        void EmitBorrow(ostream &trace)
+        {
+            int user = 1 + static_cast<int>(random() % user_count);
+            uint32_t book = PopularBook();
+            Emit(trace, OP_BORROW, user % shape.clients, user, SerialOf('B', book));
+
+            // The loan fails in the replay if the book is already out
+            if(on_shelf[book])
+            {
+                on_shelf[book] = 0;
+                if(loans[user].empty())
+                {
+                    borrowers.push_back(user);
+                }
+                loans[user].push_back(book);
+            }
+        }
+
+        /**
+         * @brief Writes the return of a random loan.
+        */
+        void EmitReturn(ostream &trace)
+        {
+            size_t borrower = random() % borrowers.size();
+            int user = borrowers[borrower];
+            vector<uint32_t> &books = loans[user];
+            size_t loan = random() % books.size();
+            uint32_t book = books[loan];
+            Emit(trace, OP_RETURN, user % shape.clients, user, SerialOf('B', book));
+
+            on_shelf[book] = 1;
+            books[loan] = books.back();
+            books.pop_back();
+            if(books.empty())
+            {
+                borrowers[borrower] = borrowers.back();
+                borrowers.pop_back();
+            }
+        }
+
+        /**
+         * @brief Writes the registration of a new user.
+        */
+        void EmitRegister(ostream &trace)
+        {
+            int user = ++user_count;
+            loans.emplace_back();
+            Emit(trace, OP_REGISTER, user % shape.clients, user, "-");
+        }
+
+    public:
+        /**
+         * @brief Constructs a generator.
+         *
+         * @param shape The size of the library the trace is generated for.
+        */
+        explicit WorkloadGenerator(const WorkloadShape &shape)
+            : shape(shape), random(shape.seed), popularity(shape.books), book_of_rank(shape.books),
+              on_shelf(shape.books, 1), loans(shape.users + 1), user_count(shape.users)
+        {
+            // Zipf distribution: the book of rank r is drawn with a weight of 1 / r^s
+            double total = 0;
+            for(size_t rank = 0; rank < shape.books; rank++)
+            {
+                total += 1.0 / pow(static_cast<double>(rank + 1), ZIPF_EXPONENT);
+                popularity[rank] = total;
+            }
+            for(double &cumulative : popularity)
+            {
+                cumulative /= total;
+            }
+
+            // Fisher-Yates shuffle written out, std::shuffle differs between libraries
+            for(size_t book = 0; book < shape.books; book++)
+            {
+                size_t other = random() % (book + 1);
+                book_of_rank[book] = book_of_rank[other];
+                book_of_rank[other] = static_cast<uint32_t>(book);
+            }
+        }
+
+        /**
+         * @brief Writes the whole trace.
+         *
+         * @param trace The output of the trace.
+        */
+        void Generate(ostream &trace)
+        {
+            trace << "library-workload 1\n";
+            trace << "catalogue " << shape.books << ' ' << shape.users << ' ' << shape.clients << ' ' << shape.seed << '\n';
+
+            size_t semester_start = shape.operations / 10;
+            size_t burst = 0;
+            for(size_t i = 0; i < shape.operations; i++)
+            {
+                // A return desk empties its box: a run of 20 to 60 returns
+                if(burst == 0 && random() % 2000 == 0)
+                {
+                    burst = 20 + random() % 41;
+                }
+                if(burst > 0 && !borrowers.empty())
+                {
+                    burst--;
+                    EmitReturn(trace);
+                    continue;
+                }
+                burst = 0;
+
+                // A quarter of the traffic is registrations at the start of the semester
+                double registrations = (i < semester_start) ? 0.25 : 0.005;
+                if(Uniform() < registrations)
+                {
+                    EmitRegister(trace);
+                    continue;
+                }
+
+                int client = static_cast<int>(random() % shape.clients);
+                double choice = Uniform();
+                if(choice < 0.38 || (choice < 0.58 && borrowers.empty()))
+                {
+                    EmitBorrow(trace);
+                }
+                else if(choice < 0.58)
+                {
+                    EmitReturn(trace);
+                }
+                else if(choice < 0.80)
+                {
+                    Emit(trace, OP_SEARCH_TITLE, client, 0, TitleWordOf(PopularBook()));
+                }
+                else if(choice < 0.90)
+                {
+                    Emit(trace, OP_SEARCH_AUTHOR, client, 0, to_string(PopularBook() / 10));
+                }
+                else if(choice < 0.96)
+                {
+                    Emit(trace, OP_LIST_PAGE, client, 0, TitleWordOf(random() % shape.books));
+                }
+                else if(choice < 0.985 || added.empty())
+                {
+                    // A book added then removed goes to one client, which keeps the removal after the addition
+                    added.push_back(added_count++);
+                    Emit(trace, OP_ADD_BOOK, static_cast<int>(added.back() % shape.clients), 0, SerialOf('N', added.back()));
+                }
+                else
+                {
+                    // Weeding: one of the books added by the trace, never on loan
+                    size_t pick = random() % added.size();
+                    Emit(trace, OP_REMOVE_BOOK, static_cast<int>(added[pick] % shape.clients), 0, SerialOf('N', added[pick]));
+                    added[pick] = added.back();
+                    added.pop_back();
+                }
+            }
+        }
+};
+
+/**
+ * @brief Reads a trace.
+ *
+ * @param path The path of the trace.
+ * @param shape Set to the size of the library the trace was generated for.
+ * @param operations Set to the operations of the trace, decoded.
+ * @return true if the trace was read, false if it can't be opened or is malformed.
+*/
+static bool ReadTrace(const string &path, WorkloadShape &shape, vector<Operation> &operations)
+{
+    ifstream trace(path);
+    string magic, section;
+    int version = 0;
+    if(!(trace >> magic >> version >> section >> shape.books >> shape.users >> shape.clients >> shape.seed)
+       || magic != "library-workload" || version != 1 || section != "catalogue" || shape.clients <= 0)
+    {
+        return false;
+    }
+
+    Operation operation;
+    string kind;
+    while(trace >> operation.client >> kind >> operation.user >> operation.text)
+    {
+        size_t k = find(KIND_NAMES, KIND_NAMES + OP_KIND_COUNT, kind) - KIND_NAMES;
+        if(k == OP_KIND_COUNT)
+        {
+            return false;
+        }
+        operation.kind = static_cast<operation_kind_t>(k);
+
+        // Turn the arguments into what the calls take
+        switch(operation.kind)
+        {
+            case OP_BORROW:
+            case OP_RETURN:
+                operation.key = IsbnKey::FromString(operation.text);
+                break;
+            case OP_REGISTER:
+                operation.text = "Student " + to_string(operation.user);
+                break;
+            case OP_SEARCH_AUTHOR:
+                operation.text = "Author " + operation.text;
+                break;
+            case OP_LIST_PAGE:
+                operation.text = "Volume " + operation.text;
+                break;
+            default:
+                break;
+        }
+        operations.push_back(operation);
+    }
+    return trace.eof();
+}
+
+/**
+ * @brief Calls the Library API for one operation.
+ *
+ * @return true if the library carried the operation out, false if it refused it.
+*/
+static bool Execute(Library &library, const Operation &operation)
+{
+    switch(operation.kind)
+    {
+        case OP_BORROW:
+            return library.UserBorrowBook(operation.user, operation.key) == LOAN_SUCCEEDED;
+        case OP_RETURN:
+            return library.UserReturnBook(operation.user, operation.key) == LOAN_SUCCEEDED;
+        case OP_REGISTER:
+            return library.RegisterNewUser(new User(operation.text, operation.user)) == ADDED_SUCCESSFULLY;
+        case OP_ADD_BOOK:
+            return library.AddNewBookToLibrary(new Book("Acquisition " + operation.text, "Acquisitions", "History", operation.text)) == ADDED_SUCCESSFULLY;
+        case OP_REMOVE_BOOK:
+            return library.RemoveBookFromLibrary(operation.text) == REMOVED;
+        case OP_SEARCH_TITLE:
+            return !library.SearchForBooks(operation.text).empty();
+        case OP_SEARCH_AUTHOR:
+            return !library.SearchForBooksByAuthor(operation.text).empty();
+        case OP_LIST_PAGE:
+        default:
+        {
+            BookCursor cursor;
+            cursor.title = operation.text;
+            cursor.ISBN = "B";
+            return !library.ListBooks(ORDER_BY_TITLE, cursor, 20).books.empty();
+        }
+    }
+}
+
+/**
+ * @brief The measurements of one replay thread.
+ */
+struct ReplayResult
+{
+    // The latency of every operation in nanoseconds, by kind.
+    vector<uint64_t> latencies[OP_KIND_COUNT];
+    // The number of operations the library refused, by kind.
+    size_t refused[OP_KIND_COUNT] = {};
+};
+
+/**
+ * @brief Gets a percentile of sorted latencies.
+*/
+static uint64_t Percentile(const vector<uint64_t> &sorted, double fraction)
+{
+    size_t rank = static_cast<size_t>(fraction * static_cast<double>(sorted.size()));
+    return sorted[min(rank, sorted.size() - 1)];
+}
+
+static int Generate(int argc, char *argv[])
+{
+    WorkloadShape shape;
+    if(argc > 3) shape.books = strtoull(argv[3], nullptr, 10);
+    if(argc > 4) shape.users = atoi(argv[4]);
+    if(argc > 5) shape.operations = strtoull(argv[5], nullptr, 10);
+    if(argc > 6) shape.clients = atoi(argv[6]);
+    if(argc > 7) shape.seed = strtoull(argv[7], nullptr, 10);
+    if(shape.books == 0 || shape.users <= 0 || shape.clients <= 0)
+    {
+        cerr << "The library needs at least one book, one user and one client." << endl;
+        return 1;
+    }
+
+    ofstream trace(argv[2]);
+    if(!trace)
+    {
+        cerr << "Can't create " << argv[2] << endl;
+        return 1;
+    }
+    WorkloadGenerator(shape).Generate(trace);
+    trace.close();
+    if(!trace)
+    {
+        cerr << "Can't write " << argv[2] << endl;
+        return 1;
+    }
+
+    cout << shape.operations << " operations written to " << argv[2] << endl;
+    return 0;
+}
+
+static int Replay(int argc, char *argv[])
+{
+    unsigned threads = (argc > 3) ? static_cast<unsigned>(atoi(argv[3])) : thread::hardware_concurrency();
+    threads = max(threads, 1u);
+
+    WorkloadShape shape;
+    vector<Operation> operations;
+    if(!ReadTrace(argv[2], shape, operations))
+    {
+        cerr << "Can't read the trace " << argv[2] << endl;
+        return 1;
+    }
+
+    Library library;
+    BuildLibrary(library, shape);
+
+    // Every client replays on one thread, in the order of the trace
+    vector<vector<const Operation *>> streams(threads);
+    for(const Operation &operation : operations)
+    {
+        streams[operation.client % threads].push_back(&operation);
+    }
+
+    vector<ReplayResult> results(threads);
+    atomic<unsigned> ready(0);
+    atomic<bool> go(false);
+    vector<thread> workers;
+    for(unsigned t = 0; t < threads; t++)
+    {
+        workers.emplace_back([&, t]()
+        {
+            ReplayResult &result = results[t];
+            for(vector<uint64_t> &latencies : result.latencies)
+            {
+                latencies.reserve(streams[t].size() / 4);
+            }
+
+            // Start every thread at once
+            ready++;
+            while(!go.load())
+            {
+                this_thread::yield();
+            }
+
+            for(const Operation *operation : streams[t])
+            {
+                auto start = chrono::steady_clock::now();
+                bool done = Execute(library, *operation);
+                auto stop = chrono::steady_clock::now();
+
+                result.latencies[operation->kind].push_back(chrono::duration_cast<chrono::nanoseconds>(stop - start).count());
+                result.refused[operation->kind] += !done;
+            }
+        });
+    }
+    while(ready.load() < threads)
+    {
+        this_thread::yield();
+    }
+    auto start = chrono::steady_clock::now();
+    go = true;
+    for(thread &worker : workers)
+    {
+        worker.join();
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << operations.size() << " operations on " << threads << " threads in " << fixed << setprecision(3) << seconds << " s: "
+         << setprecision(0) << operations.size() / seconds << " ops/s\n\n";
+    cout << left << setw(10) << "operation" << right << setw(10) << "count" << setw(10) << "refused" << setw(12) << "ops/s"
+         << setw(10) << "p50" << setw(10) << "p99" << setw(10) << "p999" << setw(12) << "max" << "  (ns)\n";
+
+    for(int kind = 0; kind < OP_KIND_COUNT; kind++)
+    {
+        // Merge the latencies of every thread
+        vector<uint64_t> latencies;
+        size_t refused = 0;
+        for(const ReplayResult &result : results)
+        {
+            latencies.insert(latencies.end(), result.latencies[kind].begin(), result.latencies[kind].end());
+            refused += result.refused[kind];
+        }
+        if(latencies.empty())
+        {
+            continue;
+        }
+        sort(latencies.begin(), latencies.end());
+
+        cout << left << setw(10) << KIND_NAMES[kind] << right << setw(10) << latencies.size() << setw(10) << refused
+             << setw(12) << latencies.size() / seconds << setw(10) << Percentile(latencies, 0.50)
+             << setw(10) << Percentile(latencies, 0.99) << setw(10) << Percentile(latencies, 0.999)
+             << setw(12) << latencies.back() << '\n';
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    string mode = (argc > 1) ? argv[1] : "";
+    if(argc > 2 && mode == "generate")
+    {
+        return Generate(argc, argv);
+    }
+    if(argc > 2 && mode == "replay")
+    {
+        return Replay(argc, argv);
+    }
+
+    cerr << "Usage: " << argv[0] << " generate <trace> [books] [users] [operations] [clients] [seed]\n"
+         << "       " << argv[0] << " replay <trace> [threads]" << endl;
+    return 1;
+}
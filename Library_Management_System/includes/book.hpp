@@ -1,9 +1,33 @@
 #ifndef _BOOK_HPP_
 #define _BOOK_HPP_
 
+#include <string>
+#include <cstdint>
+#include <atomic>
+
 // Use the standard namespace for convenience
 using namespace std;
 
+/**
+ * @brief Dense handle identifying the slot of a book inside the library.
+ */
+typedef uint32_t book_handle_t;
+
+/**
+ * @brief The fields of a book not yet added to a library, as read from an import file.
+ */
+struct BookRecord
+{
+    // The title of the book.
+    string title;
+    // The author of the book.
+    string author;
+    // The genre of the book.
+    string gener;
+    // The ISBN number of the book.
+    string ISBN;
+};
+
 /**
  * @brief A class representing a book in a library.
  * 
@@ -13,6 +37,9 @@ using namespace std;
 class Book
 {
     private: 
+        // The bit of the loan word set while the book is on loan, the low 32 bits hold the borrower ID.
+        static const uint64_t LOAN_TAG = 1ull << 32;
+
         // The title of the book. 
         string book_title;
         // The author of the book.
@@ -21,8 +48,25 @@ class Book
         string book_gener;
         // The ISBN number of the book.
         string book_ISBN;
-        // The availability status of the book
-        bool availability;
+        // The loan word of the book, 0 while available, LOAN_TAG | borrower ID while on loan.
+        atomic<uint64_t> loan_word;
+        // The slot of the book inside the library it was added to.
+        book_handle_t book_slot;
+        // The position of the book in the list of books of its borrower, meaningful only while on loan.
+        uint32_t loan_index;
+
+        /**
+         * @brief Puts the book back on the shelf, dropping its loan word.
+         * 
+         * Private since a loan always names its borrower (see TryClaim()): a book marked borrowed
+         * without one could never be returned. Only the snapshot loader of the library may reset it.
+         * 
+         * @param choise true to make the book available, false leaves the loan word as it is.
+        */
+        void SetBookAvailability(bool choise);
+
+        // The library alone may reset a loan word, for its snapshot loader.
+        friend class Library;
     
     public:
 
@@ -36,14 +80,15 @@ class Book
         /**
          * @brief Parameterized constructor for the Book class.
          * 
-         * Initializes a Book object with the specified title, author, genre, and ISBN.
+         * Initializes a Book object with the specified title, author, genre, and ISBN. The strings
+         * are taken by value and moved in, so temporaries are never copied.
          * 
          * @param title The title of the book.
          * @param author The author of the book.
          * @param gener The genre of the book. (Note: Typo in "gener" should be "genre")
          * @param ISBN The ISBN number of the book.
         */     
-        Book(const string &title,const string &author,const string &gener,const string &ISBN);
+        Book(string title, string author, string gener, string ISBN);
         
         /**
          * @brief Destructor for the Book class.
@@ -57,72 +102,131 @@ class Book
          * 
          * @param name The new title of the book.
         */
-        void SetBookName(string &name);
+        void SetBookName(string name);
 
         /**
          * @brief Sets the ISBN number of the book.
          * 
          * @param ISBN The new ISBN number of the book.
         */
-        void SetBookNumber(string &ISBN);
+        void SetBookNumber(string ISBN);
         
         /**
          * @brief Sets the author of the book.
          * 
          * @param author The new author of the book.
         */
-        void SetBookAuthor(string &author);
+        void SetBookAuthor(string author);
 
         /**
          * @brief Sets the genre of the book.
          * 
          * @param gener The new genre of the book. 
         */
-        void SetBookGener(string &gener);  
+        void SetBookGener(string gener);  
+
+        /**
+         * @brief Atomically claims the book for a borrower.
+         * 
+         * The loan word is swapped from available to borrowed by the user with a single
+         * compare-and-swap, so when several users race for the same book exactly one wins,
+         * without any lock.
+         * 
+         * @param user_id The ID of the user borrowing the book.
+         * @return true if the book was available and is now on loan to the user.
+        */
+        bool TryClaim(int user_id);
+
+        /**
+         * @brief Atomically releases the book held by a borrower.
+         * 
+         * @param user_id The ID of the user returning the book.
+         * @return true if the book was on loan to the user and is now available.
+        */
+        bool Release(int user_id);
+
+        /**
+         * @brief Checks whether the book is on loan to a user.
+         * 
+         * @param user_id The ID of the user.
+         * @return true if the user holds the book.
+        */
+        bool IsBorrowedBy(int user_id) const;
 
         /**
-         * @brief Sets the availability status of the book.
+         * @brief Gets the user currently holding the book.
          * 
-         * @param choise The new availability status of the book (true if available, false otherwise).
+         * The borrower is read from the loan word of the book, so the lookup is O(1).
+         * 
+         * @param user_id Receives the ID of the borrower.
+         * @return true if the book is on loan to a user, false if it is available.
         */
-        void SetBookAvailability(bool &choise); 
+        bool GetBookBorrower(int &user_id) const;
 
-        /* getter methods */
+        /**
+         * @brief Sets the slot of the book inside the library.
+         * 
+         * @param slot The dense handle assigned to the book by the library.
+        */
+        void SetBookSlot(book_handle_t slot);
+
+        /**
+         * @brief Sets the position of the book in the list of books of its borrower.
+         * 
+         * @param index The position of the book in the borrowed books of the user holding it.
+        */
+        void SetLoanIndex(uint32_t index);
+
+        /* getter methods, returning references to the fields so reading a book never allocates */
 
         /**
          * @brief Gets the title of the book.
          * 
          * @return The title of the book.
         */
-        string GetBookName();
+        const string &GetBookName() const;
 
         /**
          * @brief Gets the author of the book.
          * 
          * @return The author of the book.
         */
-        string GetBookAuthor();
+        const string &GetBookAuthor() const;
 
         /**
          * @brief Gets the genre of the book.
          * 
          * @return The genre of the book. 
         */
-        string GetBookGener();
+        const string &GetBookGener() const;
 
         /**
          * @brief Gets the ISBN number of the book.
          * 
          * @return The ISBN number of the book.
         */
-        string GetBookNumber();
+        const string &GetBookNumber() const;
 
         /**
          * @brief Gets the availability status of the book.
          * 
          * @return The availability status of the book (true if available, false otherwise).
         */
-        bool GetBookAvailability();
+        bool GetBookAvailability() const;
+
+        /**
+         * @brief Gets the slot of the book inside the library.
+         * 
+         * @return The dense handle assigned to the book by the library.
+        */
+        book_handle_t GetBookSlot() const;
+
+        /**
+         * @brief Gets the position of the book in the list of books of its borrower.
+         * 
+         * @return The position of the book in the borrowed books of the user holding it.
+        */
+        uint32_t GetLoanIndex() const;
 };
 
 
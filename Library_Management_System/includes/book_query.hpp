@@ -0,0 +1,41 @@
+#ifndef _BOOK_QUERY_HPP_
+#define _BOOK_QUERY_HPP_
+
+#include <string>
+
+// Use the standard namespace for convenience
+using namespace std;
+
+/**
+ * @brief Enumeration for filtering the books of a query by their availability.
+ */
+typedef enum
+{
+    ANY_AVAILABILITY,       /* Keeps the books whatever their availability. */
+    ONLY_AVAILABLE,         /* Keeps only the books that can be borrowed. */
+    ONLY_BORROWED           /* Keeps only the books currently borrowed by a user. */
+}availability_filter_t;
+
+/**
+ * @brief A compound query over the books of the library.
+ *
+ * Every predicate left empty is ignored, the others are combined with a logical AND.
+ * The indexed predicates (title terms, author, author prefix and genre) are answered from
+ * the posting lists of the library indexes, the availability is only checked on the books
+ * surviving all of them.
+ */
+struct BookQuery
+{
+    // Terms that must all appear in the title of the book.
+    string title;
+    // The exact author of the book.
+    string author;
+    // The beginning of the author name of the book (e.g. "Dr. A").
+    string author_prefix;
+    // The exact genre of the book.
+    string genre;
+    // The availability the book must have.
+    availability_filter_t availability = ANY_AVAILABILITY;
+};
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef _CATALOGUE_LOADER_HPP_
+#define _CATALOGUE_LOADER_HPP_
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include "book.hpp"
+#include "library.hpp"
+
+// Use the standard namespace for convenience
+using namespace std;
+
+/**
+ * @brief Enumeration for handling the result of importing a catalogue file.
+ */
+typedef enum
+{
+    LOADED_SUCCESSFULLY,    /* Indicates that the file was parsed and its books imported. */
+    FILE_NOT_OPENED,        /* Indicates that the file does not exist or can't be read. */
+    FILE_NOT_MAPPED,        /* Indicates that the file could not be mapped in memory. */
+    LOADED_NOT_DURABLE      /* Indicates that the books were imported, but the write-ahead log could not make them durable. */
+}load_handling_t;
+
+/**
+ * @brief The outcome of importing a catalogue file.
+ */
+typedef struct
+{
+    size_t records;             /* The number of records read from the file. */
+    size_t imported;            /* The number of books added to the library. */
+    size_t rejected;            /* The records skipped: malformed line, invalid or duplicate serial number. */
+    double seconds;             /* The wall clock time of the whole import. */
+    double records_per_second;  /* The import throughput. */
+}load_report_t;
+
+/**
+ * @brief A bulk importer of CSV and TSV book catalogues.
+ *
+ * The file is memory-mapped and cut into one chunk per thread at line boundaries. Every chunk
+ * is parsed on its own core into book records, which are then added to the library in a single
+ * batch through Library::ImportBooks(), with every table reserved once for the whole file.
+ *
+ * Every line holds the title, author, genre and serial number of a book, in that order. The
+ * delimiter is a tab if the first line holds one, a comma otherwise. Fields may be enclosed in
+ * double quotes (doubled to escape them) but may not span lines. A first line starting with a
+ * "title" field is taken as a header and skipped.
+ */
+class CatalogueLoader
+{
+    private:
+        /* The number of threads parsing the file. */
+        unsigned thread_count;
+
+    public:
+        /**
+         * @brief Constructs a loader.
+         *
+         * @param threads The number of parsing threads, 0 to use every core.
+        */
+        explicit CatalogueLoader(unsigned threads = 0);
+
+        /**
+         * @brief Imports the books of a catalogue file into a library.
+         *
+         * @param path The path of the CSV or TSV file.
+         * @param library The library receiving the books.
+         * @param report Receives the counters and throughput of the import.
+         * @return load_handling_t Enumeration value indicating the result of the operation.
+        */
+        load_handling_t LoadFile(const string &path, Library &library, load_report_t &report);
+
+        /**
+         * @brief Parses the lines of a chunk of a catalogue file.
+         *
+         * @param begin The first character of the chunk, at the start of a line.
+         * @param end One past the last character of the chunk, at the end of a line.
+         * @param delimiter The field delimiter, a tab or a comma.
+         * @param records Receives one record per well formed line.
+         * @return size_t The number of malformed lines skipped.
+        */
+        static size_t ParseChunk(const char *begin, const char *end, char delimiter, vector<BookRecord> &records);
+};
+
+#endif
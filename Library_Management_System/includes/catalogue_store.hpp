@@ -0,0 +1,293 @@
+#ifndef _CATALOGUE_STORE_HPP_
+#define _CATALOGUE_STORE_HPP_
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include <unordered_map>
+#include "book.hpp"
+#include "slot_bitmap.hpp"
+#include "segmented_array.hpp"
+
+// Use the standard namespace for convenience
+using namespace std;
+
+/**
+ * @brief Inventory counters of a set of books.
+ */
+typedef struct
+{
+    size_t total;           /* The number of books. */
+    size_t available;       /* The number of books that can be borrowed. */
+}inventory_stats_t;
+
+/**
+ * @brief A column of strings packed back to back in a single character buffer.
+ *
+ * Every slot stores the offset and the length of its string inside the pool, so reading a
+ * whole column walks two flat arrays and one contiguous buffer instead of chasing a heap
+ * allocation per string. Erased strings leave garbage behind, reclaimed by Compact().
+ */
+class StringPool
+{
+    private:
+        /* The characters of every string of the column, back to back. */
+        string pool;
+        /* The offset of the string of every slot inside the pool. */
+        vector<uint64_t> offsets;
+        /* The length of the string of every slot. */
+        vector<uint32_t> lengths;
+        /* The number of pool bytes no slot refers to anymore. */
+        size_t garbage_bytes = 0;
+
+    public:
+        /**
+         * @brief Stores the string of a slot, growing the column if needed.
+         *
+         * @param slot The slot receiving the string.
+         * @param value The string to store.
+        */
+        void Store(book_handle_t slot, const string &value);
+
+        /**
+         * @brief Erases the string of a slot.
+         *
+         * @param slot The slot to erase.
+        */
+        void Erase(book_handle_t slot);
+
+        /**
+         * @brief Gets the string of a slot without copying it.
+         *
+         * The view stays valid until the next Store() or Compact() on the column.
+         *
+         * @param slot The slot to read.
+         * @return A view over the characters of the slot inside the pool.
+        */
+        string_view Get(book_handle_t slot) const
+        {
+            return string_view(pool.data() + offsets[slot], lengths[slot]);
+        }
+
+        /**
+         * @brief Gets the number of pool bytes no slot refers to anymore.
+         *
+         * @return The number of garbage bytes.
+        */
+        size_t GarbageBytes() const;
+
+        /**
+         * @brief Gets the total size of the pool in bytes.
+         *
+         * @return The number of bytes of the pool, garbage included.
+        */
+        size_t PoolBytes() const;
+
+        /**
+         * @brief Rewrites the pool with the strings still referred to by a slot.
+        */
+        void Compact();
+
+        /**
+         * @brief Reserves room for a number of slots and pool bytes.
+         *
+         * @param slots The number of slots.
+         * @param bytes The number of characters of the pool.
+        */
+        void Reserve(size_t slots, size_t bytes);
+
+        /**
+         * @brief Removes all the strings from the column.
+        */
+        void Clear();
+};
+
+/**
+ * @brief A columnar (structure of arrays) store of the book catalogue.
+ *
+ * The title, author, genre and ISBN of every book live in four string pools indexed by the
+ * book slot, and the availability of the books is packed in a bitset next to a bitset of the
+ * occupied slots. Full scans, availability counts and exports walk these flat arrays at memory
+ * bandwidth instead of dereferencing a Book object per record.
+ *
+ * The availability bits and the genre counters are the only state a loan touches, and they
+ * live in segmented arrays that never move, so loans and returns update them without any
+ * lock of the store while books are stored or erased.
+ */
+class CatalogueStore
+{
+    private:
+        /* The titles of the books. */
+        StringPool titles;
+        /* The authors of the books. */
+        StringPool authors;
+        /* The genres of the books. */
+        StringPool genres;
+        /* The ISBNs of the books. */
+        StringPool isbns;
+
+        /* One bit per slot, set when the slot holds a book. */
+        SlotBitmap live;
+        /* One bit per slot, set when the book of the slot is available. */
+        SlotBitmap available;
+
+        /* The dense id of every distinct normalized genre. */
+        unordered_map<string, uint32_t> genre_ids;
+        /* The name of every genre id, as spelled by the first book of the genre. */
+        vector<string> genre_names;
+        /* The inventory counters of every genre id, in place while new genres are added. */
+        SegmentedArray<inventory_stats_t, 6> genre_counts;
+        /* The genre id of the book of every slot, in place while the store grows. */
+        SegmentedArray<uint32_t> slot_genres;
+
+        /* The number of slots of the store, occupied or not. */
+        size_t slot_count = 0;
+
+        /**
+         * @brief Compacts the string pools once their garbage outweighs their live strings.
+        */
+        void CompactIfNeeded();
+
+    public:
+        /**
+         * @brief Stores the columns of a book in a slot.
+         *
+         * @param slot The slot of the book.
+         * @param book The book to store.
+        */
+        void StoreBook(book_handle_t slot, const Book &book);
+
+        /**
+         * @brief Erases the book of a slot.
+         *
+         * @param slot The slot of the book.
+        */
+        void EraseBook(book_handle_t slot);
+
+        /**
+         * @brief Updates the availability bit of a book.
+         *
+         * The counters of the genre of the book are adjusted in O(1) when the bit changes. Both the
+         * bit and the counters are updated atomically in place, so availability changes of different
+         * books may run in parallel, even while other books are stored or erased.
+         *
+         * @param slot The slot of the book.
+         * @param is_available true if the book is available, false if it is borrowed.
+        */
+        void SetAvailability(book_handle_t slot, bool is_available);
+
+        /**
+         * @brief Gets the number of slots of the store, occupied or not.
+         *
+         * @return One past the highest slot ever stored.
+        */
+        size_t SlotCount() const { return slot_count; }
+
+        /**
+         * @brief Checks whether a slot holds a book.
+         *
+         * @param slot The slot to check.
+         * @return true if a book is stored in the slot.
+        */
+        bool IsLive(book_handle_t slot) const { return live.Test(slot); }
+
+        /**
+         * @brief Checks whether the book of a slot is available.
+         *
+         * @param slot The slot to check.
+         * @return true if a book is stored in the slot and can be borrowed.
+        */
+        bool IsAvailable(book_handle_t slot) const { return available.Test(slot); }
+
+        /**
+         * @brief Gets the title of the book of a slot without copying it.
+         *
+         * @param slot The slot of the book.
+         * @return A view valid until the next modification of the store.
+        */
+        string_view GetTitle(book_handle_t slot) const { return titles.Get(slot); }
+
+        /**
+         * @brief Gets the author of the book of a slot without copying it.
+         *
+         * @param slot The slot of the book.
+         * @return A view valid until the next modification of the store.
+        */
+        string_view GetAuthor(book_handle_t slot) const { return authors.Get(slot); }
+
+        /**
+         * @brief Gets the genre of the book of a slot without copying it.
+         *
+         * @param slot The slot of the book.
+         * @return A view valid until the next modification of the store.
+        */
+        string_view GetGenre(book_handle_t slot) const { return genres.Get(slot); }
+
+        /**
+         * @brief Gets the ISBN of the book of a slot without copying it.
+         *
+         * @param slot The slot of the book.
+         * @return A view valid until the next modification of the store.
+        */
+        string_view GetISBN(book_handle_t slot) const { return isbns.Get(slot); }
+
+        /**
+         * @brief Counts the books of the store with a popcount over the live bitset.
+         *
+         * @return The number of books stored.
+        */
+        size_t CountBooks() const;
+
+        /**
+         * @brief Counts the available books with a popcount over the availability bitset.
+         *
+         * @return The number of books that can be borrowed.
+        */
+        size_t CountAvailable() const;
+
+        /**
+         * @brief Gets the inventory counters of a genre in O(1).
+         *
+         * @param genre The genre, compared case insensitively.
+         * @return The number of books and available books of the genre.
+        */
+        inventory_stats_t GetGenreInventory(const string &genre) const;
+
+        /**
+         * @brief Gets the inventory counters of every genre holding at least one book.
+         *
+         * @return Pairs of genre name and counters, in order of first appearance of the genre.
+        */
+        vector<pair<string, inventory_stats_t>> GetInventoryByGenre() const;
+
+        /**
+         * @brief Gets the availability bitset of the books.
+         *
+         * @return The bitmap holding one availability bit per slot.
+        */
+        const SlotBitmap &AvailabilityBitmap() const { return available; }
+
+        /**
+         * @brief Reserves room for a number of books.
+         *
+         * @param slots The number of book slots.
+         * @param average_bytes The expected length of one field, used to size the pools.
+        */
+        void Reserve(size_t slots, size_t average_bytes = 16);
+
+        /**
+         * @brief Removes all the books from the store.
+        */
+        void Clear();
+
+        /**
+         * @brief Exchanges the books of two stores, nobody may access either of them meanwhile.
+         *
+         * @param other The store to exchange the books with.
+        */
+        void Swap(CatalogueStore &other);
+};
+
+#endif
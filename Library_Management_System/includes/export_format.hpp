@@ -0,0 +1,195 @@
+#ifndef _EXPORT_FORMAT_HPP_
+#define _EXPORT_FORMAT_HPP_
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+
+// Use the standard namespace for convenience
+using namespace std;
+
+/**
+ * @brief Enumeration for the built-in formats of an export.
+ */
+typedef enum
+{
+    EXPORT_TEXT,            /* One block of "field: value" lines per record, as the console displays them. */
+    EXPORT_CSV,             /* Comma separated values with a header line, readable by the catalogue importer. */
+    EXPORT_JSONL,           /* One JSON object per line. */
+    EXPORT_BINARY           /* Length-prefixed fields after an 8 byte magic. */
+}export_format_t;
+
+/**
+ * @brief Enumeration for handling the result of an export.
+ */
+typedef enum
+{
+    EXPORTED_SUCCESSFULLY,  /* Indicates that every record was written. */
+    EXPORT_NOT_OPENED,      /* Indicates that the output file can't be created. */
+    EXPORT_NOT_WRITTEN      /* Indicates that a write to the output failed. */
+}export_handling_t;
+
+/**
+ * @brief The fields of a book handed to an export format, viewed in place in the catalogue.
+ */
+typedef struct
+{
+    string_view ISBN;       /* The serial number of the book. */
+    string_view title;      /* The title of the book. */
+    string_view author;     /* The author of the book. */
+    string_view genre;      /* The genre of the book. */
+    bool available;         /* Whether the book can be borrowed. */
+}book_view_t;
+
+/**
+ * @brief The fields of a user handed to an export format.
+ */
+typedef struct
+{
+    int id;                 /* The ID of the user. */
+    string_view name;       /* The name of the user. */
+    size_t loans;           /* The number of books on loan to the user. */
+}user_view_t;
+
+/**
+ * @brief A large reusable output buffer in front of a file descriptor.
+ *
+ * The records are formatted straight into the buffer, which reaches the file in one write()
+ * per megabyte, so an export costs a memcpy per field rather than a stream call.
+ */
+class ExportBuffer
+{
+    private:
+        /* The descriptor of the output. */
+        int fd;
+        /* The bytes not yet written. */
+        vector<char> buffer;
+        /* The number of buffered bytes. */
+        size_t used = 0;
+        /* Whether every write succeeded. */
+        bool healthy = true;
+
+    public:
+        /**
+         * @brief Constructs a buffer in front of a file descriptor.
+         *
+         * @param file The descriptor of the output, left open by the buffer.
+         * @param capacity The size of the buffer in bytes.
+        */
+        explicit ExportBuffer(int file, size_t capacity = 1 << 20);
+
+        /**
+         * @brief Destructs the buffer, writing the bytes left in it.
+        */
+        ~ExportBuffer();
+
+        /**
+         * @brief Appends bytes to the output.
+         *
+         * @param data The bytes to append.
+         * @param size The number of bytes.
+        */
+        void Append(const char *data, size_t size)
+        {
+            if(used + size > buffer.size())
+            {
+                AppendSlow(data, size);
+                return;
+            }
+            memcpy(buffer.data() + used, data, size);
+            used += size;
+        }
+
+        /**
+         * @brief Appends a string to the output.
+        */
+        void Append(string_view text) { Append(text.data(), text.size()); }
+
+        /**
+         * @brief Appends one character to the output.
+        */
+        void Append(char c)
+        {
+            if(used == buffer.size())
+            {
+                Flush();
+            }
+            buffer[used++] = c;
+        }
+
+        /**
+         * @brief Appends the decimal digits of an integer to the output.
+        */
+        void AppendNumber(int64_t value);
+
+        /**
+         * @brief Appends the raw bytes of a value to the output, in host byte order.
+        */
+        template <typename T>
+        void AppendRaw(T value) { Append(reinterpret_cast<const char *>(&value), sizeof(value)); }
+
+        /**
+         * @brief Writes the buffered bytes to the output.
+         *
+         * @return true if every write so far succeeded.
+        */
+        bool Flush();
+
+    private:
+        /**
+         * @brief Appends bytes that do not fit in the space left in the buffer.
+        */
+        void AppendSlow(const char *data, size_t size);
+
+        /**
+         * @brief Writes bytes to the output, retrying the writes interrupted by a signal.
+        */
+        void WriteAll(const char *data, size_t size);
+};
+
+/**
+ * @brief The layout of the records of an export.
+ *
+ * A format turns each book or user into bytes appended to an ExportBuffer. The built-in formats
+ * are created from an export_format_t, and any other layout can be plugged in by deriving
+ * from this class and handing it to Library::ExportBooks() or Library::ExportUsers().
+ */
+class ExportFormat
+{
+    public:
+        virtual ~ExportFormat() = default;
+
+        /**
+         * @brief Creates a built-in format.
+         *
+         * @param format The format to create.
+         * @return unique_ptr<ExportFormat> The format.
+        */
+        static unique_ptr<ExportFormat> Create(export_format_t format);
+
+        /**
+         * @brief Writes what precedes the books, such as a header line.
+        */
+        virtual void BeginBooks(ExportBuffer &out) { (void)out; }
+
+        /**
+         * @brief Writes one book.
+        */
+        virtual void WriteBook(ExportBuffer &out, const book_view_t &book) = 0;
+
+        /**
+         * @brief Writes what precedes the users, such as a header line.
+        */
+        virtual void BeginUsers(ExportBuffer &out) { (void)out; }
+
+        /**
+         * @brief Writes one user.
+        */
+        virtual void WriteUser(ExportBuffer &out, const user_view_t &user) = 0;
+};
+
+#endif
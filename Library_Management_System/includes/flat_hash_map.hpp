@@ -0,0 +1,501 @@
+#ifndef _FLAT_HASH_MAP_HPP_
+#define _FLAT_HASH_MAP_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <tuple>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Use the standard namespace for convenience
+using namespace std;
+
+/**
+ * @brief A cache friendly open addressing hash map (Swiss table layout).
+ *
+ * The entries live in one flat array of slots, next to an array holding one control byte per
+ * slot: the 7 low bits of the hash of a full slot, or a marker for an empty or deleted slot.
+ * A lookup loads the control bytes of a group of 16 slots at once and compares them to the
+ * wanted hash bits with SSE2 (or a portable loop), so most lookups touch one control cache line
+ * and one slot, with no allocation per entry and no pointer chasing.
+ *
+ * The container exposes the subset of the std::unordered_map interface used by the library
+ * (find, emplace, erase, iteration, size, clear, reserve). Any insertion may move the entries,
+ * so iterators, pointers and references to them are invalidated by emplace and reserve; erase
+ * only invalidates the erased entry.
+ */
+template <typename K, typename V, typename Hash = hash<K>, typename KeyEqual = equal_to<K>>
+class FlatHashMap
+{
+    public:
+        /* The entries, whose keys can't be changed in place, as in std::unordered_map. */
+        typedef pair<const K, V> value_type;
+
+    private:
+        /* The number of control bytes probed at once. */
+        static constexpr size_t GROUP_WIDTH = 16;
+        /* The control byte of a slot that never held an entry. */
+        static constexpr int8_t CTRL_EMPTY = -128;
+        /* The control byte of a slot whose entry was erased (tombstone). */
+        static constexpr int8_t CTRL_DELETED = -2;
+
+        /* The control bytes, capacity + GROUP_WIDTH of them (the first group is cloned at the end). */
+        int8_t *ctrl = nullptr;
+        /* The slots holding the entries, constructed only where the control byte is full. */
+        value_type *slots = nullptr;
+        /* The number of slots, zero or a power of two not smaller than GROUP_WIDTH. */
+        size_t capacity = 0;
+        /* The number of entries. */
+        size_t entry_count = 0;
+        /* The number of empty slots that can still be filled before the table must grow. */
+        size_t growth_left = 0;
+
+        /* The hash functor of the keys. */
+        Hash hasher;
+        /* The equality functor of the keys. */
+        KeyEqual key_equal;
+
+        /**
+         * @brief Hashes a key and spreads the result over all the bits.
+         *
+         * std::hash of integers is the identity, so the hash is mixed before its low bits are
+         * used as control byte and its high bits as probe start.
+        */
+        size_t HashOf(const K &key) const
+        {
+            uint64_t h = static_cast<uint64_t>(hasher(key));
+            h *= 0x9E3779B97F4A7C15ULL;
+            return static_cast<size_t>(h ^ (h >> 32));
+        }
+
+        /**
+         * @brief Gets the bit mask of the slots of a group whose control byte equals a value.
+        */
+        static uint32_t MatchByte(const int8_t *group, int8_t value)
+        {
+#if defined(__SSE2__)
+            __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(group));
+            return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(value))));
+#else
+            uint32_t mask = 0;
+            for(size_t i = 0; i < GROUP_WIDTH; i++)
+            {
+                mask |= static_cast<uint32_t>(group[i] == value) << i;
+            }
+            return mask;
+#endif
+        }
+
+        /**
+         * @brief Gets the bit mask of the slots of a group that are empty or deleted.
+        */
+        static uint32_t MatchEmptyOrDeleted(const int8_t *group)
+        {
+#if defined(__SSE2__)
+            __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(group));
+            return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_set1_epi8(-1), bytes)));
+#else
+            uint32_t mask = 0;
+            for(size_t i = 0; i < GROUP_WIDTH; i++)
+            {
+                mask |= static_cast<uint32_t>(group[i] < -1) << i;
+            }
+            return mask;
+#endif
+        }
+
+        /**
+         * @brief Gets the number of entries a table of a given capacity can hold (7/8 load factor).
+        */
+        static size_t MaxLoad(size_t slot_count)
+        {
+            return slot_count - slot_count / 8;
+        }
+
+        /**
+         * @brief Writes the control byte of a slot, and its clone if the slot is in the first group.
+        */
+        void SetCtrl(size_t index, int8_t value)
+        {
+            ctrl[index] = value;
+            if(index < GROUP_WIDTH)
+            {
+                ctrl[capacity + index] = value;
+            }
+        }
+
+        /**
+         * @brief Finds the slot of a key.
+         *
+         * @return The index of the slot, or capacity if the key is absent.
+        */
+        size_t FindIndex(const K &key, size_t h) const
+        {
+            if(capacity == 0)
+            {
+                return 0;
+            }
+
+            size_t mask = capacity - 1;
+            int8_t h2 = static_cast<int8_t>(h & 0x7F);
+            size_t pos = (h >> 7) & mask;
+            size_t step = 0;
+
+            while(true)
+            {
+                const int8_t *group = ctrl + pos;
+
+                // Check every slot of the group holding the same 7 hash bits.
+                for(uint32_t match = MatchByte(group, h2); match != 0; match &= match - 1)
+                {
+                    size_t index = (pos + static_cast<size_t>(__builtin_ctz(match))) & mask;
+                    if(key_equal(slots[index].first, key))
+                    {
+                        return index;
+                    }
+                }
+
+                // An empty slot ends the probe sequence, the key was never inserted further.
+                if(MatchByte(group, CTRL_EMPTY) != 0)
+                {
+                    return capacity;
+                }
+
+                // Move to the next group (triangular probing visits every group once).
+                step += GROUP_WIDTH;
+                pos = (pos + step) & mask;
+            }
+        }
+
+        /**
+         * @brief Finds the first empty or deleted slot of the probe sequence of a hash.
+        */
+        size_t FindInsertIndex(size_t h) const
+        {
+            size_t mask = capacity - 1;
+            size_t pos = (h >> 7) & mask;
+            size_t step = 0;
+
+            while(true)
+            {
+                uint32_t match = MatchEmptyOrDeleted(ctrl + pos);
+                if(match != 0)
+                {
+                    return (pos + static_cast<size_t>(__builtin_ctz(match))) & mask;
+                }
+
+                step += GROUP_WIDTH;
+                pos = (pos + step) & mask;
+            }
+        }
+
+        /**
+         * @brief Moves every entry to a new table of a given capacity, dropping the tombstones.
+        */
+        void Rehash(size_t new_capacity)
+        {
+            int8_t *old_ctrl = ctrl;
+            value_type *old_slots = slots;
+            size_t old_capacity = capacity;
+
+            // Allocate the new arrays, every control byte starts empty.
+            capacity = new_capacity;
+            ctrl = static_cast<int8_t *>(::operator new(capacity + GROUP_WIDTH));
+            memset(ctrl, static_cast<unsigned char>(CTRL_EMPTY), capacity + GROUP_WIDTH);
+            slots = static_cast<value_type *>(::operator new(capacity * sizeof(value_type)));
+            growth_left = MaxLoad(capacity) - entry_count;
+
+            // Move the entries of the full slots of the old table.
+            for(size_t i = 0; i < old_capacity; i++)
+            {
+                if(old_ctrl[i] >= 0)
+                {
+                    size_t h = HashOf(old_slots[i].first);
+                    size_t index = FindInsertIndex(h);
+                    SetCtrl(index, static_cast<int8_t>(h & 0x7F));
+                    // The key is const, so it is copied while the value is moved.
+                    new (&slots[index]) value_type(std::move(old_slots[i]));
+                    old_slots[i].~value_type();
+                }
+            }
+
+            ::operator delete(old_ctrl);
+            ::operator delete(old_slots);
+        }
+
+        /**
+         * @brief Makes room for one more entry, growing or cleaning the table if needed.
+        */
+        void PrepareInsert()
+        {
+            if(growth_left > 0)
+            {
+                return;
+            }
+
+            if(capacity == 0)
+            {
+                Rehash(GROUP_WIDTH);
+            }
+            else if(entry_count + 1 > MaxLoad(capacity) / 2)
+            {
+                // Mostly live entries: double the table.
+                Rehash(capacity * 2);
+            }
+            else
+            {
+                // Mostly tombstones: rebuild at the same size.
+                Rehash(capacity);
+            }
+        }
+
+        /**
+         * @brief Destroys every entry, keeping the arrays.
+        */
+        void DestroyEntries()
+        {
+            if(!is_trivially_destructible<value_type>::value)
+            {
+                for(size_t i = 0; i < capacity; i++)
+                {
+                    if(ctrl[i] >= 0)
+                    {
+                        slots[i].~value_type();
+                    }
+                }
+            }
+        }
+
+        /**
+         * @brief An iterator over the full slots of the map.
+        */
+        template <bool IsConst>
+        class Iterator
+        {
+            private:
+                typedef typename conditional<IsConst, const FlatHashMap, FlatHashMap>::type map_type;
+
+                /* The map being iterated. */
+                map_type *map;
+                /* The index of the current slot, capacity at the end. */
+                size_t index;
+
+                /* Advances to the next full slot (or the end). */
+                void SkipFree()
+                {
+                    while(index < map->capacity && map->ctrl[index] < 0)
+                    {
+                        index++;
+                    }
+                }
+
+                friend class FlatHashMap;
+
+            public:
+                typedef typename conditional<IsConst, const value_type, value_type>::type entry_type;
+
+                Iterator(map_type *owner, size_t start) : map(owner), index(start) { SkipFree(); }
+
+                /* Allows converting an iterator to a const_iterator. */
+                template <bool OtherConst, typename = typename enable_if<IsConst && !OtherConst>::type>
+                Iterator(const Iterator<OtherConst> &other) : map(other.map), index(other.index) {}
+
+                entry_type &operator*() const { return map->slots[index]; }
+                entry_type *operator->() const { return &map->slots[index]; }
+
+                Iterator &operator++() { index++; SkipFree(); return *this; }
+                Iterator operator++(int) { Iterator previous = *this; ++(*this); return previous; }
+
+                bool operator==(const Iterator &other) const { return index == other.index; }
+                bool operator!=(const Iterator &other) const { return index != other.index; }
+
+                template <bool> friend class Iterator;
+        };
+
+    public:
+        typedef Iterator<false> iterator;
+        typedef Iterator<true> const_iterator;
+
+        FlatHashMap() = default;
+
+        FlatHashMap(const FlatHashMap &) = delete;
+        FlatHashMap &operator=(const FlatHashMap &) = delete;
+
+        FlatHashMap(FlatHashMap &&other) noexcept { swap(other); }
+
+        FlatHashMap &operator=(FlatHashMap &&other) noexcept
+        {
+            FlatHashMap moved(std::move(other));
+            swap(moved);
+            return *this;
+        }
+
+        ~FlatHashMap()
+        {
+            DestroyEntries();
+            ::operator delete(ctrl);
+            ::operator delete(slots);
+        }
+
+        /**
+         * @brief Exchanges the content of two maps.
+        */
+        void swap(FlatHashMap &other) noexcept
+        {
+            std::swap(ctrl, other.ctrl);
+            std::swap(slots, other.slots);
+            std::swap(capacity, other.capacity);
+            std::swap(entry_count, other.entry_count);
+            std::swap(growth_left, other.growth_left);
+            std::swap(hasher, other.hasher);
+            std::swap(key_equal, other.key_equal);
+        }
+
+        iterator begin() { return iterator(this, 0); }
+        iterator end() { return iterator(this, capacity); }
+        const_iterator begin() const { return const_iterator(this, 0); }
+        const_iterator end() const { return const_iterator(this, capacity); }
+
+        size_t size() const { return entry_count; }
+        bool empty() const { return entry_count == 0; }
+
+        /**
+         * @brief Finds the entry of a key.
+         *
+         * @return An iterator to the entry, or end() if the key is absent.
+        */
+        iterator find(const K &key) { return iterator(this, FindIndex(key, HashOf(key))); }
+        const_iterator find(const K &key) const { return const_iterator(this, FindIndex(key, HashOf(key))); }
+
+        /**
+         * @brief Counts the entries of a key.
+         *
+         * @return 1 if the key is present, 0 otherwise.
+        */
+        size_t count(const K &key) const { return FindIndex(key, HashOf(key)) != capacity ? 1 : 0; }
+
+        /**
+         * @brief Starts loading the first group probed for a key, without waiting for it.
+         *
+         * Prefetching the keys of a batch before looking any of them up overlaps their cache misses.
+        */
+        void prefetch(const K &key) const
+        {
+            if(capacity == 0)
+            {
+                return;
+            }
+
+            size_t pos = (HashOf(key) >> 7) & (capacity - 1);
+            __builtin_prefetch(ctrl + pos);
+            __builtin_prefetch(slots + pos);
+        }
+
+        /**
+         * @brief Inserts an entry if the key is absent.
+         *
+         * The value is constructed in place from the arguments only when the key is inserted.
+         *
+         * @return An iterator to the entry of the key, and whether it was inserted.
+        */
+        template <typename... Args>
+        pair<iterator, bool> emplace(const K &key, Args &&... args)
+        {
+            size_t h = HashOf(key);
+            size_t index = FindIndex(key, h);
+
+            if(index != capacity)
+            {
+                // The key is already present.
+                return make_pair(iterator(this, index), false);
+            }
+
+            // Take the first free slot of the probe sequence, growing the table first if needed.
+            PrepareInsert();
+            index = FindInsertIndex(h);
+            if(ctrl[index] == CTRL_EMPTY)
+            {
+                growth_left--;
+            }
+
+            SetCtrl(index, static_cast<int8_t>(h & 0x7F));
+            new (&slots[index]) value_type(piecewise_construct, forward_as_tuple(key),
+                                           forward_as_tuple(std::forward<Args>(args)...));
+            entry_count++;
+
+            return make_pair(iterator(this, index), true);
+        }
+
+        /**
+         * @brief Gets the value of a key, inserting a default constructed one if absent.
+        */
+        V &operator[](const K &key) { return emplace(key).first->second; }
+
+        /**
+         * @brief Erases the entry an iterator points to.
+        */
+        void erase(const_iterator position)
+        {
+            slots[position.index].~value_type();
+            SetCtrl(position.index, CTRL_DELETED);
+            entry_count--;
+        }
+
+        void erase(iterator position) { erase(const_iterator(position)); }
+
+        /**
+         * @brief Erases the entry of a key.
+         *
+         * @return The number of erased entries (0 or 1).
+        */
+        size_t erase(const K &key)
+        {
+            size_t index = FindIndex(key, HashOf(key));
+            if(index == capacity)
+            {
+                return 0;
+            }
+            erase(const_iterator(this, index));
+            return 1;
+        }
+
+        /**
+         * @brief Erases every entry, keeping the allocated table.
+        */
+        void clear()
+        {
+            if(capacity == 0)
+            {
+                return;
+            }
+            DestroyEntries();
+            memset(ctrl, static_cast<unsigned char>(CTRL_EMPTY), capacity + GROUP_WIDTH);
+            entry_count = 0;
+            growth_left = MaxLoad(capacity);
+        }
+
+        /**
+         * @brief Grows the table so it can hold a number of entries without rehashing.
+        */
+        void reserve(size_t entries)
+        {
+            size_t new_capacity = GROUP_WIDTH;
+            while(MaxLoad(new_capacity) < entries)
+            {
+                new_capacity *= 2;
+            }
+            if(new_capacity > capacity)
+            {
+                Rehash(new_capacity);
+            }
+        }
+};
+
+#endif
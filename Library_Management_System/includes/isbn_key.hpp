@@ -0,0 +1,149 @@
+#ifndef _ISBN_KEY_HPP_
+#define _ISBN_KEY_HPP_
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+
+// Use the standard namespace for convenience
+using namespace std;
+
+/**
+ * @brief A normalized, fixed-width binary key identifying a book.
+ *
+ * The key packs the serial number of a book into two 64-bit words so the catalogue maps
+ * can hash and compare it without any heap allocation:
+ * - a valid ISBN-13, or an ISBN-10 converted to its ISBN-13 form, is stored as its 13-digit
+ *   number (below 2^44) in the first word;
+ * - any other serial of 1 to 15 printable characters (e.g. "123qwe") is a local serial, stored
+ *   byte by byte under a tag bit: the first 7 characters in the first word, the rest in the second.
+ *   A local serial can't be longer than 15 characters, separators included.
+ * Hyphens and blanks are ignored in an ISBN, so "978-0-306-40615-7" and "9780306406157" give the
+ * same key, but a local serial is kept byte for byte, so "173-813" and "1738-13" stay distinct.
+ * A serial shaped like an ISBN once its hyphens and blanks are stripped (13 digits, or 9 digits
+ * and a digit or X) but failing its checksum is a mistyped ISBN and gives the invalid key,
+ * whatever its punctuation. Anything else (empty, longer than 15 characters, unprintable) gives
+ * the invalid key too.
+ */
+class IsbnKey
+{
+    private:
+        /* The packed key, 0 when the key is invalid. */
+        uint64_t value;
+
+        /* The characters 8 to 15 of a local serial, 0 otherwise. */
+        uint64_t extra;
+
+        /* The tag bit marking a packed local serial rather than an ISBN-13 number. */
+        static constexpr uint64_t LOCAL_SERIAL_TAG = uint64_t(1) << 63;
+
+        /* The longest local serial a key can hold. */
+        static constexpr size_t MAX_LOCAL_SERIAL = 15;
+
+        /**
+         * @brief Constructs a key from its packed words.
+         *
+         * @param packed The first word of the key.
+         * @param packed_extra The second word of the key.
+        */
+        IsbnKey(uint64_t packed, uint64_t packed_extra) : value(packed), extra(packed_extra) {}
+
+    public:
+        /**
+         * @brief Constructs the invalid key.
+        */
+        IsbnKey() : value(0), extra(0) {}
+
+        /**
+         * @brief Parses and normalizes a serial number into a key.
+         *
+         * The parsing works on a fixed stack buffer and never allocates.
+         *
+         * @param text The ISBN-10 or ISBN-13 (hyphens and blanks allowed) or the local serial.
+         * @return The normalized key, invalid if the text is not a valid serial.
+        */
+        static IsbnKey FromString(string_view text);
+
+        /**
+         * @brief Rebuilds a key from the words returned by GetValue() and GetExtra().
+         *
+         * @param packed The first word of the key.
+         * @param packed_extra The second word of the key, 0 for an ISBN or a local serial of up to 7 characters.
+         * @return The key holding those words.
+        */
+        static IsbnKey FromValue(uint64_t packed, uint64_t packed_extra = 0) { return IsbnKey(packed, packed_extra); }
+
+        /**
+         * @brief Checks whether the key holds a serial.
+         *
+         * @return true if the parsed text was a valid ISBN or local serial.
+        */
+        bool IsValid() const { return value != 0; }
+
+        /**
+         * @brief Checks whether the key holds a checksum-validated ISBN.
+         *
+         * @return true for an ISBN-10 or ISBN-13, false for a local serial or the invalid key.
+        */
+        bool IsIsbn() const { return value != 0 && (value & LOCAL_SERIAL_TAG) == 0; }
+
+        /**
+         * @brief Gets the first word of the key.
+         *
+         * @return The ISBN-13 number, or the tag bit and the first 7 characters of a local serial.
+        */
+        uint64_t GetValue() const { return value; }
+
+        /**
+         * @brief Gets the second word of the key.
+         *
+         * @return The characters 8 to 15 of a local serial, 0 otherwise.
+        */
+        uint64_t GetExtra() const { return extra; }
+
+        /**
+         * @brief Formats the key back to its normalized text.
+         *
+         * @return The 13 digits of an ISBN, the characters of a local serial, or "" if invalid.
+        */
+        string ToString() const;
+
+        /**
+         * @brief Compares two keys.
+         *
+         * @param other The key to compare with.
+         * @return true if both keys hold the same serial.
+        */
+        bool operator==(const IsbnKey &other) const { return value == other.value && extra == other.extra; }
+
+        /**
+         * @brief Compares two keys.
+         *
+         * @param other The key to compare with.
+         * @return true if the keys hold different serials.
+        */
+        bool operator!=(const IsbnKey &other) const { return !(*this == other); }
+};
+
+/**
+ * @brief Hash functor of the ISBN keys.
+ *
+ * The packed words are run through a 64-bit finalizer so that consecutive ISBNs, which share
+ * their high digits, spread over the whole hash range.
+ */
+struct IsbnKeyHash
+{
+    size_t operator()(const IsbnKey &key) const
+    {
+        uint64_t h = key.GetValue() ^ (key.GetExtra() * 0x9e3779b97f4a7c15ULL);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return static_cast<size_t>(h);
+    }
+};
+
+#endif
@@ -3,8 +3,23 @@
 
 #include <unordered_map>
 #include <memory>
+#include <vector>
+#include <mutex>
+#include <shared_mutex>
 #include "book.hpp"
 #include "user.hpp"
+#include "title_index.hpp"
+#include "trigram_index.hpp"
+#include "posting_index.hpp"
+#include "book_query.hpp"
+#include "catalogue_store.hpp"
+#include "isbn_key.hpp"
+#include "flat_hash_map.hpp"
+#include "object_arena.hpp"
+#include "write_ahead_log.hpp"
+#include "export_format.hpp"
+#include "ordered_book_index.hpp"
+#include "operation_stats.hpp"
 
 /**
  * @brief Enumeration for handling the result of adding a book to the library.
@@ -12,7 +27,9 @@
 typedef enum
 {
     ALREADY_TAKEN,          /* Indicates that the book is already present in the library. */
-    ADDED_SUCCESSFULLY      /* Indicates that the book was added successfully. */
+    ADDED_SUCCESSFULLY,     /* Indicates that the book was added successfully. */
+    INVALID_ISBN,           /* Indicates that the serial number of the book is not a valid ISBN or local serial. */
+    ADDED_NOT_DURABLE       /* Indicates that the book or user was added, but the write-ahead log could not make it durable. */
 }add_handling_t;
 
 /**
@@ -22,9 +39,44 @@ typedef enum
 {
     NOT_EXCIST,
     EXCIT,
-    REMOVED
+    REMOVED,
+    REMOVED_NOT_DURABLE     /* Indicates that the book or user was removed, but the write-ahead log could not make it durable. */
 }remove_handling_t;
 
+/**
+ * @brief Enumeration for handling the result of saving or loading a snapshot of the library.
+ */
+typedef enum
+{
+    SNAPSHOT_SAVED,         /* Indicates that the snapshot was written and renamed in place. */
+    SNAPSHOT_LOADED,        /* Indicates that the library was restored from the snapshot. */
+    SNAPSHOT_NOT_OPENED,    /* Indicates that the snapshot file can't be opened, mapped or written. */
+    SNAPSHOT_CORRUPTED,     /* Indicates that the file is not a snapshot or is truncated. */
+    SNAPSHOT_OLD_VERSION    /* Indicates that the snapshot was written by an incompatible version. */
+}snapshot_handling_t;
+
+/**
+ * @brief Enumeration for the result of a loan or a return.
+ */
+typedef enum
+{
+    LOAN_SUCCEEDED,         /* Indicates that the book was borrowed or returned. */
+    LOAN_UNKNOWN_USER,      /* Indicates that no user is registered with the ID. */
+    LOAN_UNKNOWN_BOOK,      /* Indicates that no book of the library has the serial number. */
+    LOAN_NOT_AVAILABLE,     /* Indicates that the book to borrow is already on loan. */
+    LOAN_NOT_BORROWED,      /* Indicates that the book to return is not on loan to the user. */
+    LOAN_NOT_DURABLE        /* Indicates that the book was borrowed or returned, but the write-ahead log could not make it durable. */
+}loan_status_t;
+
+/**
+ * @brief One loan or return of a batch: a user and the key of a book.
+ */
+typedef struct
+{
+    int user_id;            /* The ID of the user borrowing or returning the book. */
+    IsbnKey key;            /* The normalized key of the book, IsbnKey::FromString() of its serial number. */
+}loan_request_t;
+
 // Use the standard namespace for convenience
 using namespace std;
 
@@ -34,16 +86,172 @@ using namespace std;
  * The Library class manages a collection of books and users. It provides functionalities 
  * for adding, removing, searching, and displaying books and users, as well as handling 
  * book borrowing and returning operations.
+ * 
+ * Every method may be called concurrently. The books and users tables are striped into shards
+ * keyed by ISBN / user ID, each behind its own lock, so borrows and returns of unrelated books
+ * run in parallel. The catalogue-wide structures (slots, columnar store, search indexes) sit
+ * behind a reader/writer lock: the searches share it, while adding or removing a book takes it
+ * exclusively. Borrows and returns never take it: they lock the shard of the user, share the
+ * shard of the book and flip the availability bit of the book, which the catalogue keeps in
+ * place while it grows. Locks are always taken in the order catalogue, user shard, book shard.
+ * The availability of a book is claimed with a compare-and-swap on its loan word, so borrowers
+ * of the same book only share its shard and never wait on each other. The searches and listings
+ * return shared pointers, which keep a book alive once it is removed and past the library, whose
+ * arena they co-own. The users are handed out as plain pointers, valid while the library lives.
  */
 
 class Library
 {
     private: 
-        /* A hash map that stores books with their ISBN as keys. */
-        unordered_map<string, shared_ptr<Book>> books;
+        /* The slab allocator the emplaced books and users are constructed in, declared first so it outlives the users.
+           The books co-own it, and a library restoring a snapshot for another one shares the arena of that library. */
+        shared_ptr<ObjectArena> arena = make_shared<ObjectArena>();
+
+        /* The number of shards the books and users tables are striped into (a power of two). */
+        static const size_t SHARD_COUNT = 64;
+
+        /**
+         * @brief A stripe of the books table with the lock protecting it.
+         */
+        struct BookShard
+        {
+            /* Protects the books table of the shard, the availability of a book is claimed atomically. */
+            shared_mutex lock;
+            /* A flat open addressing hash map that stores books with their normalized binary ISBN as keys. */
+            FlatHashMap<IsbnKey, shared_ptr<Book>, IsbnKeyHash> books;
+        };
+
+        /**
+         * @brief A stripe of the users table with the lock protecting it.
+         */
+        struct UserShard
+        {
+            /* Protects the users of the shard and their lists of borrowed books. */
+            shared_mutex lock;
+            /* A flat open addressing hash map that stores users with their ID as keys. */
+            FlatHashMap<int, unique_ptr<User, ArenaDeleter<User>>> users;
+        };
+
+        /* The shards of the books table. */
+        BookShard book_shards[SHARD_COUNT];
+
+        /* The shards of the users table. */
+        UserShard user_shards[SHARD_COUNT];
+
+        /* Protects the slots, the strings of the columnar catalogue and the search indexes, never taken by loans. */
+        shared_mutex catalogue_lock;
+
+        /* The books indexed by their dense handle, empty slots belong to removed books. */
+        vector<shared_ptr<Book>> book_slots;
+
+        /* The handles released by removed books, reused by the next added books. */
+        vector<book_handle_t> free_book_slots;
+
+        /* The write-ahead log recording every mutation, none if not attached. */
+        WriteAheadLog *log = nullptr;
+
+        /* The counters and latency histograms of the operations, empty if compiled out. */
+        OperationStats stats;
+
+        /* The columnar copy of the catalogue, indexed by book slot, serving scans and counts. */
+        CatalogueStore catalogue;
+
+        /* The books sorted by title, then serial number, for the paged listings. */
+        OrderedBookIndex title_order;
+
+        /* The books sorted by serial number, for the paged listings. */
+        OrderedBookIndex isbn_order;
+
+        /* The inverted index from title terms to book handles. */
+        TitleIndex title_index;
+
+        /* The trigram index over the terms of the titles and authors, for the fuzzy searches. */
+        TrigramIndex fuzzy_index;
+
+        /* The secondary hash index from normalized author names to book handles, kept ordered for prefix queries. */
+        PostingIndex author_index;
+
+        /* The secondary hash index from normalized genres to book handles. */
+        PostingIndex genre_index;
+
+        /**
+         * @brief Gets the shard of the books table holding a key.
+         * 
+         * @param key The normalized key of the book.
+         * @return BookShard& The shard the key belongs to.
+        */
+        BookShard &ShardOf(IsbnKey key);
+
+        /**
+         * @brief Gets the shard of the users table holding an ID.
+         * 
+         * @param id The ID of the user.
+         * @return UserShard& The shard the ID belongs to.
+        */
+        UserShard &ShardOf(int id);
+
+        /**
+         * @brief Gives a slot to a book just inserted in the books table and indexes it.
+         * 
+         * The caller holds the catalogue lock exclusively.
+         * 
+         * @param book The book stored in the books table.
+         * @param ordered false if the caller adds the slot to the ordered indexes with its whole batch.
+        */
+        void IndexNewBook(const shared_ptr<Book> &book, bool ordered = true);
+
+        /**
+         * @brief Resolves a list of book handles to the books they refer to.
+         * 
+         * @param handles The handles of the books.
+         * @return The books in the same order as the handles.
+        */
+        vector<shared_ptr<Book>> ResolveBookHandles(const vector<book_handle_t> &handles);
+
+        /**
+         * @brief Removes every user, book and index entry from the library.
+         * 
+         * The caller holds every lock of the library, or is its destructor.
+        */
+        void ClearContents();
+
+        /**
+         * @brief Exchanges every user, book and index entry with another library.
+         * 
+         * The caller holds every lock of both libraries, or owns the other one alone.
+         * 
+         * @param other The library to exchange the contents with.
+        */
+        void SwapContents(Library &other);
 
-        /* A hash map that stores users with their ID as keys. */
-        unordered_map<int, unique_ptr<User>> users;     
+        /**
+         * @brief Restores a mapped snapshot into this library, which is empty and not shared yet.
+         * 
+         * @param data The content of the snapshot file.
+         * @param size The size of the snapshot file.
+         * @return snapshot_handling_t SNAPSHOT_LOADED, or the reason the snapshot is rejected.
+        */
+        snapshot_handling_t RestoreSnapshot(const char *data, size_t size);
+
+        /**
+         * @brief Writes the whole state of the library to a snapshot file.
+         * 
+         * The caller holds the catalogue lock exclusively and every user shard.
+         * 
+         * @param path The path of the snapshot file.
+         * @return snapshot_handling_t SNAPSHOT_SAVED, or SNAPSHOT_NOT_OPENED if the file can't be written.
+        */
+        snapshot_handling_t WriteSnapshot(const string &path);
+
+        /**
+         * @brief Applies a batch of loans or returns.
+         * 
+         * @param requests The operations, applied in order.
+         * @param count The number of operations.
+         * @param borrow true to borrow the books, false to return them.
+         * @return vector<loan_status_t> The result of every operation, in the same order.
+        */
+        vector<loan_status_t> ApplyLoans(const loan_request_t *requests, size_t count, bool borrow);
 
     public: 
         /**
@@ -56,14 +264,16 @@ class Library
         /**
          * @brief Destructs a Library object.
          * 
-         * Cleans up resources and destroys the library.
+         * Cleans up resources and destroys the library. The slabs of the emplaced books and users
+         * are released in one shot once every object is destroyed.
         */
         ~Library();
 
         /**
          * @brief Adds a new book to the library.
          * 
-         * This method attempts to add a book to the library's collection. If the book is already
+         * This method attempts to add a book to the library's collection. If the serial number of the
+         * book is neither a valid ISBN nor a local serial, it returns INVALID_ISBN. If the book is already
          * present in the library, it returns ALREADY_TAKEN. If the book is added successfully,
          * it returns ADDED_SUCCESSFULLY.
          * 
@@ -72,18 +282,49 @@ class Library
         */
         add_handling_t AddNewBookToLibrary(Book *book);
 
+        /**
+         * @brief Constructs a new book in place and adds it to the library.
+         * 
+         * The book and its shared_ptr control block are allocated together from the slab allocator
+         * of the library, and nothing is allocated if the ISBN is invalid or already taken.
+         * The memory is released with the library, or with the last shared_ptr held past it.
+         * 
+         * @param title The title of the book.
+         * @param author The author of the book.
+         * @param gener The genre of the book.
+         * @param ISBN The ISBN number of the book.
+         * @return add_handling_t Enumeration value indicating the result of the operation.
+        */
+        add_handling_t EmplaceBook(const string &title, const string &author, const string &gener, const string &ISBN);
+
         /**
          * @brief Removes a book from the library using its ISBN.
          * 
          * This method attempts to remove a book from the library's collection based on its ISBN.
          * If the book does not exist, it returns NOT_EXCIST. If the book exists but could not be removed,
-         * it returns EXCIT. If the book is successfully removed, it returns REMOVED.
+         * it returns EXCIT. If the book is successfully removed, it returns REMOVED. A book on loan
+         * is first taken back from its borrower, found through the loan word of the book.
          * 
          * @param ISBN The ISBN of the book to be removed.
          * @return remove_handling_t Enumeration value indicating the result of the operation.
         */
         remove_handling_t RemoveBookFromLibrary(const string &ISBN);
 
+        /**
+         * @brief Adds a batch of books to the library in one pass.
+         * 
+         * The tables, slots and catalogue are reserved for the whole batch up front and every
+         * lock is taken once, so importing millions of records never rehashes per record.
+         * Records whose serial number is invalid or already taken are skipped. The statistics count
+         * the import as one addition call, with every record counted by its outcome.
+         * 
+         * @param records The books to add, their strings are moved into the library.
+         * @param durable Receives false if the books were added but the write-ahead log could not make
+         * them durable, may be null.
+         * @return size_t The number of books added.
+        */
+        size_t ImportBooks(vector<BookRecord> &records, bool *durable = nullptr);
+
         /**
          * @brief Registers a new user in the library.
          * 
@@ -96,12 +337,25 @@ class Library
         */
         add_handling_t RegisterNewUser(User *new_user);
 
+        /**
+         * @brief Constructs a new user in place and registers them in the library.
+         * 
+         * The user is allocated from the slab allocator of the library, and nothing is allocated
+         * if the ID is already taken. The memory is released with the library.
+         * 
+         * @param name The name of the user.
+         * @param id The ID of the user.
+         * @return add_handling_t Enumeration value indicating the result of the operation.
+        */
+        add_handling_t EmplaceUser(const string &name, int id);
+
         /**
          * @brief Removes a user from the library using their ID.
          * 
          * This method attempts to remove a user from the library's records based on their ID.
          * If the user does not exist, it returns NOT_EXCIST. If the user exists but could not
          * be removed, it returns EXCIT. If the user is successfully removed, it returns REMOVED.
+         * The books still on loan to the user are made available again.
          * 
          * @param id The ID of the user to be removed.
          * @return remove_handling_t Enumeration value indicating the result of the operation.
@@ -109,18 +363,81 @@ class Library
         remove_handling_t RemoveUserFromLibrary(const int &id);
 
         /**
-         * @brief Displays all books currently in the library.
+         * @brief Gets every book of the library.
+         * 
+         * The books are collected from the live slots of the columnar catalogue. Formatting them is
+         * left to the caller.
+         * 
+         * @return vector<shared_ptr<Book>> The books, ordered by their slot in the library.
+        */
+        vector<shared_ptr<Book>> GetAllBooks();
+
+        /**
+         * @brief Gets every user registered in the library.
+         * 
+         * The users stay valid until they are removed.
+         * 
+         * @return vector<User *> The users, grouped by shard.
+        */
+        vector<User *> GetAllUsers();
+
+        /**
+         * @brief Lists one page of the catalogue, sorted by title or by serial number.
+         * 
+         * The books are kept in ordered indexes, so a page costs one descent to the cursor plus
+         * one step per book, whatever its position in the catalogue. Pass the next cursor of a
+         * page to get the page after it; pages stay stable while books are added or removed.
+         * 
+         * @param order The order of the listing.
+         * @param after The cursor of the previous page, a default one for the first page.
+         * @param limit The largest number of books of the page.
+         * @return BookPage The books of the page, the cursor of the next page and whether it exists.
+        */
+        BookPage ListBooks(book_order_t order, const BookCursor &after, size_t limit);
+
+        /**
+         * @brief Streams every book of the library through an export format.
+         * 
+         * The fields are read in place from the columnar catalogue and formatted straight into the
+         * buffer, so the export costs a memcpy per field and one write() per buffer. Books can't be
+         * added or removed while the export runs, loans and returns go on.
+         * 
+         * @param format The layout of the records, a built-in one or any derived class.
+         * @param out The buffer the records are appended to, flushed by the caller.
+         * @return size_t The number of books exported.
+        */
+        size_t ExportBooks(ExportFormat &format, ExportBuffer &out);
+
+        /**
+         * @brief Exports every book of the library to a file.
+         * 
+         * @param path The path of the output file.
+         * @param format The format of the records.
+         * @param exported Receives the number of books written.
+         * @return export_handling_t Enumeration value indicating the result of the operation.
+        */
+        export_handling_t ExportBooks(const string &path, export_format_t format, size_t &exported);
+
+        /**
+         * @brief Streams every user of the library through an export format.
          * 
-         * This method prints out details of all the books in the library's collection.
+         * The user shards are visited one at a time, each shared with the other readers.
+         * 
+         * @param format The layout of the records, a built-in one or any derived class.
+         * @param out The buffer the records are appended to, flushed by the caller.
+         * @return size_t The number of users exported.
         */
-        void DisplayAllBooks();
+        size_t ExportUsers(ExportFormat &format, ExportBuffer &out);
 
         /**
-         * @brief Displays all users currently registered in the library.
+         * @brief Exports every user of the library to a file.
          * 
-         * This method prints out details of all users registered in the library.
+         * @param path The path of the output file.
+         * @param format The format of the records.
+         * @param exported Receives the number of users written.
+         * @return export_handling_t Enumeration value indicating the result of the operation.
         */
-        void DisplayAllUsers();
+        export_handling_t ExportUsers(const string &path, export_format_t format, size_t &exported);
 
         /**
          * @brief Allows a user to borrow a book from the library.
@@ -130,8 +447,20 @@ class Library
          * 
          * @param user_id The ID of the user borrowing the book.
          * @param temp_ISBN The ISBN of the book being borrowed.
+         * @return loan_status_t Enumeration value indicating the result of the operation.
+        */
+        loan_status_t UserBorrowBook(const int &user_id ,const string &temp_ISBN);
+
+        /**
+         * @brief Allows a user to borrow a book identified by its binary key.
+         * 
+         * Every table is probed exactly once, with no string hashing or allocation.
+         * 
+         * @param user_id The ID of the user borrowing the book.
+         * @param key The normalized key of the book being borrowed.
+         * @return loan_status_t Enumeration value indicating the result of the operation.
         */
-        void UserBorrowBook(const int &user_id ,const string &temp_ISBN);
+        loan_status_t UserBorrowBook(const int &user_id, IsbnKey key);
 
         /**
          * @brief Allows a user to return a book to the library.
@@ -141,12 +470,228 @@ class Library
          * 
          * @param user_id The ID of the user returning the book.
          * @param temp_ISBN The ISBN of the book being returned.
+         * @return loan_status_t Enumeration value indicating the result of the operation.
+        */
+        loan_status_t UserReturnBook(const int &user_id ,const string &temp_ISBN);
+
+        /**
+         * @brief Allows a user to return a book identified by its binary key.
+         * 
+         * Every table is probed exactly once, with no string hashing or allocation.
+         * 
+         * @param user_id The ID of the user returning the book.
+         * @param key The normalized key of the book being returned.
+         * @return loan_status_t Enumeration value indicating the result of the operation.
+        */
+        loan_status_t UserReturnBook(const int &user_id, IsbnKey key);
+
+        /**
+         * @brief Borrows a batch of books, such as a stack scanned at a self-checkout kiosk.
+         * 
+         * A user shard stays locked across consecutive operations of its users, and the catalogue
+         * lock is never taken. All the book keys are prefetched before any is probed, so the cache
+         * misses of the lookups overlap. Nothing is printed, and the log is committed once for the
+         * whole batch.
+         * 
+         * @param requests The loans, applied in order.
+         * @param count The number of loans.
+         * @return vector<loan_status_t> The result of every loan, in the same order.
+        */
+        vector<loan_status_t> BorrowBooks(const loan_request_t *requests, size_t count);
+
+        /**
+         * @brief Returns a batch of books, with the same locking and prefetching as BorrowBooks().
+         * 
+         * @param requests The returns, applied in order.
+         * @param count The number of returns.
+         * @return vector<loan_status_t> The result of every return, in the same order.
+        */
+        vector<loan_status_t> ReturnBooks(const loan_request_t *requests, size_t count);
+
+        /**
+         * @brief Finds the user currently holding a book.
+         * 
+         * The borrower is recorded in the loan word of the book, so the lookup costs one probe
+         * of the books table instead of a walk over the loans of every user.
+         * 
+         * @param ISBN The ISBN of the book.
+         * @param user_id Receives the ID of the borrower.
+         * @return true if the book exists and is on loan to a registered user.
+        */
+        bool FindBookBorrower(const string &ISBN, int &user_id);
+
+        /**
+         * @brief Saves the whole state of the library (books, users, loans and search indexes).
+         * 
+         * The snapshot is written to a temporary file next to the target, flushed to disk and
+         * renamed over the target, so a crash never leaves a half written snapshot behind.
+         * 
+         * @param path The path of the snapshot file.
+         * @return snapshot_handling_t SNAPSHOT_SAVED, or SNAPSHOT_NOT_OPENED if the file can't be written.
+        */
+        snapshot_handling_t SaveSnapshot(const string &path);
+
+        /**
+         * @brief Saves the whole state of the library and empties its attached log.
+         * 
+         * The snapshot is saved like SaveSnapshot() does, then the log is truncated while every
+         * mutation is still blocked, so no change can slip in between and be lost with the log.
+         * Use it rather than SaveSnapshot() for the snapshot the log is replayed over.
+         * 
+         * @param path The path of the snapshot file.
+         * @return snapshot_handling_t SNAPSHOT_SAVED, or SNAPSHOT_NOT_OPENED if the file can't be written.
+        */
+        snapshot_handling_t Checkpoint(const string &path);
+
+        /**
+         * @brief Attaches a write-ahead log recording every later mutation of the library.
+         * 
+         * Every successful addition, removal, registration, loan and return is appended to the log
+         * while its locks are held, then committed once they are released, so the call returns
+         * only when the mutation is on disk. A mutation applied but not written or synced reports
+         * ADDED_NOT_DURABLE, REMOVED_NOT_DURABLE or LOAN_NOT_DURABLE, and so does every later one once
+         * the log has failed. Attach the log after replaying it, so the replayed
+         * mutations are not logged twice, and empty it with Checkpoint() rather than by hand.
+         * 
+         * @param wal The log, which must outlive the library, or nullptr to detach it.
+        */
+        void AttachLog(WriteAheadLog *wal);
+
+        /**
+         * @brief Gets a copy of the counters and latency histograms of the operations of the library.
+         * 
+         * Every operation is counted by outcome (hit, miss, rejected) and its latency recorded in
+         * a histogram, per thread and without locks. Build with -DLIBRARY_STATS=OFF to compile the
+         * recording out entirely. Dump the copy with StatsSnapshot::WriteText() or WritePrometheus().
+         * 
+         * @return StatsSnapshot The statistics since the library was constructed, all zeros if they
+         *         are compiled out.
         */
-        void UserReturnBook(const int &user_id ,const string &temp_ISBN);
+        StatsSnapshot Stats() const;
+
+        /**
+         * @brief Replaces the state of the library with a snapshot.
+         * 
+         * The file is memory-mapped and its fixed-size records are read in place: the strings are
+         * copied straight from the mapping and the search indexes are restored list by list. Only the
+         * vocabulary of the fuzzy index is rebuilt from the titles and authors, which are not saved
+         * with it. The snapshot is restored aside and swapped in only once it is whole, so a rejected
+         * snapshot leaves the library untouched. The attached log is emptied along with the swap, its
+         * records describing the replaced state.
+         * 
+         * @param path The path of the snapshot file.
+         * @return snapshot_handling_t Enumeration value indicating the result of the operation.
+        */
+        snapshot_handling_t LoadSnapshot(const string &path);
     
-        Book *SearchForBook(string title);
-        // Book *SearchForBook(string author);
-        // Book *SearchForBook(string genre);
+        /**
+         * @brief Searches for a book by its title.
+         * 
+         * The title is looked up in the inverted title index, so the cost depends on the number
+         * of matching books rather than on the size of the catalogue. A book whose title has exactly
+         * the terms of the query is preferred, otherwise the first book containing all of them is returned.
+         * If no title holds every term, the best match of FuzzySearchBooks() is returned.
+         * 
+         * @param title The title of the book to search for.
+         * @return shared_ptr<Book> The found book, or nullptr if no title matches even approximately.
+        */
+        shared_ptr<Book> SearchForBook(string title);
+
+        /**
+         * @brief Searches for the books whose title or author approximately holds every term of a query.
+         * 
+         * Each term of the query matches the catalogue terms it equals, starts, lies inside, or is
+         * within a few edits of (one edit from 4 characters, two from 8), so "Linar Algebr" finds
+         * "Linear Algebra". The candidates come from a trigram index over the vocabulary of the
+         * catalogue and are verified with a bounded edit distance, so the cost follows the number
+         * of similar terms and their books rather than the size of the catalogue.
+         * 
+         * @param query The partial or misspelled title or author name.
+         * @param limit The largest number of books returned.
+         * @return vector<shared_ptr<Book>> The matching books, the closest first: an exact term before a prefix,
+         *         a prefix before a substring or an edit, then by slot in the library.
+        */
+        vector<shared_ptr<Book>> FuzzySearchBooks(const string &query, size_t limit = 20);
+
+        /**
+         * @brief Searches for all the books whose titles contain every term of a query.
+         * 
+         * Terms are matched case insensitively, in any order ("algebra linear" finds "LinearAlgebra").
+         * 
+         * @param title The title (or part of it) to search for.
+         * @return vector<shared_ptr<Book>> The matching books, ordered by their slot in the library.
+        */
+        vector<shared_ptr<Book>> SearchForBooks(const string &title);
+
+        /**
+         * @brief Searches for all the books written by an author.
+         * 
+         * The author is looked up in the secondary author index, so the cost depends on the number
+         * of books of the author rather than on the size of the catalogue. Names are compared case
+         * insensitively and blank runs are ignored.
+         * 
+         * @param author The name of the author.
+         * @return vector<shared_ptr<Book>> The books of the author, ordered by their slot in the library.
+        */
+        vector<shared_ptr<Book>> SearchForBooksByAuthor(const string &author);
+
+        /**
+         * @brief Searches for all the books of a genre.
+         * 
+         * The genre is looked up in the secondary genre index, so the cost depends on the number
+         * of books of the genre rather than on the size of the catalogue. Genres are compared case
+         * insensitively and blank runs are ignored.
+         * 
+         * @param genre The genre of the books.
+         * @return vector<shared_ptr<Book>> The books of the genre, ordered by their slot in the library.
+        */
+        vector<shared_ptr<Book>> SearchForBooksByGenre(const string &genre);
+
+        /**
+         * @brief Runs a compound query over the books of the library.
+         * 
+         * The indexed predicates of the query are planned against the title, author and genre
+         * indexes: their posting lists are intersected from the most selective one, and the Book
+         * objects are only touched to resolve the survivors, whose availability is read from the catalogue bitset.
+         * A query without indexed predicates falls back to a scan of the catalogue bitsets.
+         * 
+         * @param query The predicates the books must all satisfy.
+         * @return vector<shared_ptr<Book>> The matching books, ordered by their slot in the library.
+        */
+        vector<shared_ptr<Book>> QueryBooks(const BookQuery &query);
+
+        /**
+         * @brief Counts the books currently available for borrowing.
+         * 
+         * The count is a popcount over the packed availability bitset of the catalogue.
+         * 
+         * @return size_t The number of available books.
+        */
+        size_t CountAvailableBooks();
+
+        /**
+         * @brief Counts the books currently on loan.
+         * 
+         * @return size_t The number of borrowed books.
+        */
+        size_t CountBorrowedBooks();
+
+        /**
+         * @brief Gets the inventory counters of a genre.
+         * 
+         * The counters are maintained on every add, remove, borrow and return, so reading them is O(1).
+         * 
+         * @param genre The genre, compared case insensitively.
+         * @return inventory_stats_t The number of books and available books of the genre.
+        */
+        inventory_stats_t GetGenreInventory(const string &genre);
+
+        /**
+         * @brief Gets the inventory counters of every genre of the library.
+         * 
+         * @return vector<pair<string, inventory_stats_t>> Pairs of genre name and counters.
+        */
+        vector<pair<string, inventory_stats_t>> GetInventoryByGenre();
 };
 
 
@@ -0,0 +1,167 @@
+#ifndef _OBJECT_ARENA_HPP_
+#define _OBJECT_ARENA_HPP_
+
+#include <cstddef>
+#include <vector>
+#include <new>
+#include <mutex>
+#include <memory>
+
+// Use the standard namespace for convenience
+using namespace std;
+
+/**
+ * @brief A slab allocator for the small objects owned by the library.
+ *
+ * Memory is carved out of large slabs with a bump pointer, so a bulk load of books and users
+ * costs one system allocation per slab instead of one (or two, with the shared_ptr control
+ * block) per record. Released blocks go to a free list of their size class and are reused by
+ * the next allocations of the same size. Every slab is given back at once when the arena is
+ * destroyed; the objects must have been destroyed before that. Allocation and deallocation are
+ * serialized by an internal mutex since the last owner of a book may release it from any thread.
+ */
+class ObjectArena
+{
+    private:
+        /* The granularity (and alignment) of every block handed out by the arena. */
+        static constexpr size_t BLOCK_ALIGN = alignof(max_align_t);
+        /* The size of a regular slab. */
+        static constexpr size_t SLAB_BYTES = 256 * 1024;
+        /* The largest block served from the free lists, bigger ones get a dedicated slab. */
+        static constexpr size_t MAX_SMALL_BYTES = 1024;
+
+        /* A released block, linked into the free list of its size class. */
+        struct FreeBlock
+        {
+            FreeBlock *next;
+        };
+
+        /* Serializes the allocations and deallocations. */
+        mutable mutex lock;
+        /* Every slab allocated so far. */
+        vector<void *> slabs;
+        /* The next free byte of the current slab. */
+        char *cursor = nullptr;
+        /* The number of bytes left in the current slab. */
+        size_t remaining = 0;
+        /* The free list of every size class (one class per BLOCK_ALIGN bytes). */
+        FreeBlock *free_lists[MAX_SMALL_BYTES / BLOCK_ALIGN + 1] = {};
+        /* The total number of bytes obtained from the system. */
+        size_t reserved_bytes = 0;
+
+        /**
+         * @brief Rounds a size up to a multiple of BLOCK_ALIGN.
+        */
+        static size_t RoundUp(size_t bytes)
+        {
+            return (bytes + BLOCK_ALIGN - 1) & ~(BLOCK_ALIGN - 1);
+        }
+
+    public:
+        ObjectArena() = default;
+        ObjectArena(const ObjectArena &) = delete;
+        ObjectArena &operator=(const ObjectArena &) = delete;
+
+        /**
+         * @brief Releases every slab in one shot.
+        */
+        ~ObjectArena();
+
+        /**
+         * @brief Allocates a block of memory.
+         *
+         * @param bytes The size of the block.
+         * @return Pointer to a block aligned for any fundamental type.
+        */
+        void *Allocate(size_t bytes);
+
+        /**
+         * @brief Gives a block back to the arena for reuse.
+         *
+         * @param block The block returned by Allocate().
+         * @param bytes The size the block was allocated with.
+        */
+        void Deallocate(void *block, size_t bytes);
+
+        /**
+         * @brief Gets the number of slabs obtained from the system.
+         *
+         * @return The number of slabs.
+        */
+        size_t SlabCount() const;
+
+        /**
+         * @brief Gets the number of bytes obtained from the system.
+         *
+         * @return The total size of the slabs.
+        */
+        size_t ReservedBytes() const;
+};
+
+/**
+ * @brief A standard allocator drawing its memory from an ObjectArena.
+ *
+ * Used with allocate_shared so a Book and its shared_ptr control block share one arena block.
+ * The allocator co-owns the arena and the control block keeps a copy of it, so a book held
+ * past the library keeps the slabs alive until its last shared_ptr is dropped.
+ */
+template <typename T>
+class ArenaAllocator
+{
+    public:
+        typedef T value_type;
+
+        /* The arena providing the memory. */
+        shared_ptr<ObjectArena> arena;
+
+        explicit ArenaAllocator(shared_ptr<ObjectArena> source) : arena(std::move(source)) {}
+
+        template <typename U>
+        ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.arena) {}
+
+        T *allocate(size_t n)
+        {
+            static_assert(alignof(T) <= alignof(max_align_t), "over-aligned types are not supported");
+            return static_cast<T *>(arena->Allocate(n * sizeof(T)));
+        }
+
+        void deallocate(T *block, size_t n)
+        {
+            arena->Deallocate(block, n * sizeof(T));
+        }
+
+        template <typename U>
+        bool operator==(const ArenaAllocator<U> &other) const { return arena == other.arena; }
+
+        template <typename U>
+        bool operator!=(const ArenaAllocator<U> &other) const { return arena != other.arena; }
+};
+
+/**
+ * @brief A unique_ptr deleter destroying objects constructed in an ObjectArena.
+ *
+ * A deleter without arena falls back to delete, so heap objects handed to the library
+ * keep working next to the arena ones. The deleter doesn't own the arena: the objects it
+ * destroys must not outlive their owner of the arena, as the users never outlive their library.
+ */
+template <typename T>
+struct ArenaDeleter
+{
+    /* The arena the object was constructed in, nullptr for a heap object. */
+    ObjectArena *arena = nullptr;
+
+    void operator()(T *object) const
+    {
+        if(arena == nullptr)
+        {
+            delete object;
+        }
+        else
+        {
+            object->~T();
+            arena->Deallocate(object, sizeof(T));
+        }
+    }
+};
+
+#endif
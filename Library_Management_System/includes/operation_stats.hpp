@@ -0,0 +1,360 @@
+#ifndef _OPERATION_STATS_HPP_
+#define _OPERATION_STATS_HPP_
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <ostream>
+#include <cstdint>
+#include <cstddef>
+
+// Use the standard namespace for convenience
+using namespace std;
+
+/**
+ * @brief Enumeration for the operations of a library counted and timed by its statistics.
+ */
+typedef enum
+{
+    STAT_ADD_BOOK,          /* AddNewBookToLibrary(), EmplaceBook() and ImportBooks(), whose outcomes are counted per record. */
+    STAT_REMOVE_BOOK,       /* RemoveBookFromLibrary(). */
+    STAT_REGISTER_USER,     /* RegisterNewUser() and EmplaceUser(). */
+    STAT_REMOVE_USER,       /* RemoveUserFromLibrary(). */
+    STAT_BORROW,            /* UserBorrowBook(). */
+    STAT_RETURN,            /* UserReturnBook(). */
+    STAT_BORROW_BATCH,      /* BorrowBooks(), the outcomes counted per request and the latency per batch. */
+    STAT_RETURN_BATCH,      /* ReturnBooks(), the outcomes counted per request and the latency per batch. */
+    STAT_SEARCH_TITLE,      /* SearchForBook() and SearchForBooks(). */
+    STAT_SEARCH_AUTHOR,     /* SearchForBooksByAuthor(). */
+    STAT_SEARCH_GENRE,      /* SearchForBooksByGenre(). */
+    STAT_SEARCH_FUZZY,      /* FuzzySearchBooks(). */
+    STAT_QUERY,             /* QueryBooks(). */
+    STAT_LIST,              /* ListBooks(). */
+    STAT_OPERATION_COUNT    /* The number of operations, not an operation. */
+}stat_operation_t;
+
+/**
+ * @brief Enumeration for the outcomes of an operation.
+ */
+typedef enum
+{
+    STAT_HIT,               /* The operation succeeded, or the search found at least one book. */
+    STAT_MISS,              /* The book or user named doesn't exist, or the search found nothing. */
+    STAT_REJECTED,          /* The book or user exists but its state forbids the operation: serial number or ID
+                               already taken, book already borrowed, book not borrowed by the user, book or user
+                               with a loan to remove. */
+    STAT_FAILED,            /* The operation was applied, but the write-ahead log could not make it durable. */
+    STAT_OUTCOME_COUNT      /* The number of outcomes, not an outcome. */
+}stat_outcome_t;
+
+/**
+ * @brief A copy of the statistics of a library at one point in time.
+ *
+ * The latencies are kept in a log-linear histogram in the manner of HdrHistogram: exact up to
+ * 32 ns, then 32 buckets per power of two, so any percentile is known within 3 %. Latencies
+ * beyond 2^36 ns (about a minute) fall in the last bucket.
+ */
+class StatsSnapshot
+{
+    public:
+        /* The number of buckets of a latency histogram. */
+        static const size_t BUCKET_COUNT = 1024;
+
+        /**
+         * @brief Gets the histogram bucket of a latency.
+         *
+         * @param nanoseconds The latency.
+         * @return size_t The index of its bucket.
+        */
+        static size_t BucketOf(uint64_t nanoseconds)
+        {
+            if(nanoseconds < 32)
+            {
+                return static_cast<size_t>(nanoseconds);
+            }
+            unsigned exponent = 63 - __builtin_clzll(nanoseconds);
+            if(exponent > 35)
+            {
+                return BUCKET_COUNT - 1;
+            }
+            return 32 * (exponent - 4) + ((nanoseconds >> (exponent - 5)) & 31);
+        }
+
+        /**
+         * @brief Gets the largest latency of a histogram bucket.
+        */
+        static uint64_t BucketCeiling(size_t bucket);
+
+        /**
+         * @brief Gets the name of an operation, as printed in the dumps.
+        */
+        static const char *OperationName(stat_operation_t operation);
+
+        /**
+         * @brief Gets the name of an outcome, as printed in the dumps.
+        */
+        static const char *OutcomeName(stat_outcome_t outcome);
+
+        // Whether the library was built with the statistics, every count is zero otherwise.
+        bool enabled = false;
+
+        // The number of operations of each kind by outcome (requests for the batches).
+        uint64_t outcomes[STAT_OPERATION_COUNT][STAT_OUTCOME_COUNT] = {};
+
+        // The total latency of each kind of operation, in nanoseconds.
+        uint64_t latency_sum[STAT_OPERATION_COUNT] = {};
+
+        // The latency histograms, BUCKET_COUNT buckets per kind of operation.
+        vector<uint64_t> buckets = vector<uint64_t>(STAT_OPERATION_COUNT * BUCKET_COUNT);
+
+        /**
+         * @brief Gets the number of calls of an operation.
+        */
+        uint64_t GetCalls(stat_operation_t operation) const;
+
+        /**
+         * @brief Gets the mean latency of an operation in nanoseconds, 0 if never called.
+        */
+        double GetMeanLatency(stat_operation_t operation) const;
+
+        /**
+         * @brief Gets a percentile of the latency of an operation.
+         *
+         * @param operation The operation.
+         * @param fraction The percentile as a fraction (0.99 for p99).
+         * @return uint64_t The latency in nanoseconds, rounded up to the end of its bucket; 0 if never called.
+        */
+        uint64_t GetLatencyPercentile(stat_operation_t operation, double fraction) const;
+
+        /**
+         * @brief Writes a table of the operations called: counts by outcome, mean and percentiles.
+        */
+        void WriteText(ostream &out) const;
+
+        /**
+         * @brief Writes the statistics in the Prometheus text exposition format.
+         *
+         * The outcomes are the counter library_operations_total and the latencies the summary
+         * library_operation_latency_seconds, with the p50, p99 and p999 quantiles.
+        */
+        void WritePrometheus(ostream &out) const;
+};
+
+#if defined(LIBRARY_STATS)
+
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+/**
+ * @brief A clock cheap enough to read twice per operation.
+ *
+ * On x86-64 it reads the time stamp counter, constant rate on every CPU of the last decade, and
+ * converts the ticks with a rate measured once against steady_clock; elsewhere it is steady_clock.
+ */
+class OperationClock
+{
+    public:
+        /**
+         * @brief Reads the clock, in ticks.
+        */
+        static uint64_t Now()
+        {
+#if defined(__x86_64__)
+            return __rdtsc();
+#else
+            return static_cast<uint64_t>(chrono::steady_clock::now().time_since_epoch().count());
+#endif
+        }
+
+        /**
+         * @brief Gets the length of a tick in nanoseconds, measured on the first call.
+        */
+        static double NanosecondsPerTick();
+};
+
+/**
+ * @brief The counters and latency histograms of the operations of a library.
+ *
+ * Every thread records into its own block, created on its first operation on the library and
+ * found again through a thread-local cache, so recording is a few relaxed loads and stores with
+ * no lock and no cache line shared between threads. A block has a single writer, so an
+ * increment is a relaxed load and store rather than a locked read-modify-write. Snapshot()
+ * sums the blocks of every thread that ever used the library.
+ */
+class OperationStats
+{
+    private:
+        /**
+         * @brief The counters and histograms written by one thread.
+         */
+        struct alignas(64) ThreadStats
+        {
+            /* The number of operations by outcome. */
+            atomic<uint64_t> outcomes[STAT_OPERATION_COUNT][STAT_OUTCOME_COUNT];
+            /* The total latency of each operation, in nanoseconds. */
+            atomic<uint64_t> latency_sum[STAT_OPERATION_COUNT];
+            /* The latency histograms. */
+            atomic<uint64_t> buckets[STAT_OPERATION_COUNT][StatsSnapshot::BUCKET_COUNT];
+        };
+
+        /* The number of the statistics, unique in the process, naming them in the thread-local caches. */
+        uint64_t serial;
+
+        /* The length of a tick of the clock in nanoseconds. */
+        double nanoseconds_per_tick;
+
+        /* Protects the list of blocks. */
+        mutable mutex registry_lock;
+        /* The block of every thread that recorded an operation. */
+        vector<unique_ptr<ThreadStats>> threads;
+
+        /**
+         * @brief Gets the block of the calling thread, creating it on its first operation.
+        */
+        ThreadStats &Local();
+
+        /**
+         * @brief Adds to a counter only the calling thread writes.
+        */
+        static void Add(atomic<uint64_t> &counter, uint64_t value)
+        {
+            counter.store(counter.load(memory_order_relaxed) + value, memory_order_relaxed);
+        }
+
+    public:
+        /**
+         * @brief Constructs statistics with every count at zero.
+        */
+        OperationStats();
+
+        OperationStats(const OperationStats &) = delete;
+        OperationStats &operator=(const OperationStats &) = delete;
+
+        /**
+         * @brief Converts a number of ticks of OperationClock into nanoseconds.
+        */
+        uint64_t ToNanoseconds(uint64_t ticks) const
+        {
+            return static_cast<uint64_t>(static_cast<double>(ticks) * nanoseconds_per_tick);
+        }
+
+        /**
+         * @brief Records one operation.
+         *
+         * @param operation The operation.
+         * @param outcome Its outcome.
+         * @param nanoseconds Its latency.
+        */
+        void Record(stat_operation_t operation, stat_outcome_t outcome, uint64_t nanoseconds)
+        {
+            ThreadStats &local = Local();
+            Add(local.outcomes[operation][outcome], 1);
+            Add(local.latency_sum[operation], nanoseconds);
+            Add(local.buckets[operation][StatsSnapshot::BucketOf(nanoseconds)], 1);
+        }
+
+        /**
+         * @brief Counts the outcomes of a batch, whose latency is recorded separately.
+         *
+         * @param operation The operation.
+         * @param outcome The outcome.
+         * @param count The number of requests of the batch with that outcome.
+        */
+        void Count(stat_operation_t operation, stat_outcome_t outcome, uint64_t count)
+        {
+            Add(Local().outcomes[operation][outcome], count);
+        }
+
+        /**
+         * @brief Records the latency of an operation whose outcomes were counted by Count().
+        */
+        void RecordLatency(stat_operation_t operation, uint64_t nanoseconds)
+        {
+            ThreadStats &local = Local();
+            Add(local.latency_sum[operation], nanoseconds);
+            Add(local.buckets[operation][StatsSnapshot::BucketOf(nanoseconds)], 1);
+        }
+
+        /**
+         * @brief Sums the blocks of every thread.
+         *
+         * @return StatsSnapshot The counts, consistent per counter though not across counters
+         *         while operations run.
+        */
+        StatsSnapshot Snapshot() const;
+};
+
+/**
+ * @brief Times an operation from its construction to the call of Finish() with its result.
+ */
+class OperationTimer
+{
+    private:
+        /* The statistics the operation is recorded in. */
+        OperationStats &stats;
+        /* The operation. */
+        stat_operation_t operation;
+        /* When the operation started, in ticks of OperationClock. */
+        uint64_t start;
+
+    public:
+        OperationTimer(OperationStats &stats, stat_operation_t operation)
+            : stats(stats), operation(operation), start(OperationClock::Now())
+        {
+        }
+
+        /**
+         * @brief Gets the time elapsed since the operation started, in nanoseconds.
+        */
+        uint64_t Elapsed() const
+        {
+            return stats.ToNanoseconds(OperationClock::Now() - start);
+        }
+
+        /**
+         * @brief Records the operation with the outcome of its result.
+         *
+         * @param result The result of the operation, classified by an OutcomeOf() overload.
+         * @return The result, to be returned by the operation.
+        */
+        template <typename Result>
+        Result Finish(Result result)
+        {
+            stats.Record(operation, OutcomeOf(result), Elapsed());
+            return result;
+        }
+};
+
+#else
+
+/**
+ * @brief The statistics compiled out: every call is empty and the snapshot is all zeros.
+ */
+class OperationStats
+{
+    public:
+        void Record(stat_operation_t, stat_outcome_t, uint64_t) {}
+        void Count(stat_operation_t, stat_outcome_t, uint64_t) {}
+        void RecordLatency(stat_operation_t, uint64_t) {}
+        StatsSnapshot Snapshot() const { return StatsSnapshot(); }
+};
+
+/**
+ * @brief The timer compiled out: Finish() only hands the result back.
+ */
+class OperationTimer
+{
+    public:
+        OperationTimer(OperationStats &, stat_operation_t) {}
+        uint64_t Elapsed() const { return 0; }
+
+        template <typename Result>
+        Result Finish(Result result) { return result; }
+};
+
+#endif
+
+#endif
@@ -0,0 +1,220 @@
+#ifndef _ORDERED_BOOK_INDEX_HPP_
+#define _ORDERED_BOOK_INDEX_HPP_
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <set>
+#include <memory>
+#include <cstdint>
+#include "book.hpp"
+#include "catalogue_store.hpp"
+
+// Use the standard namespace for convenience
+using namespace std;
+
+/**
+ * @brief Enumeration for the orders the catalogue can be listed in.
+ */
+typedef enum
+{
+    ORDER_BY_TITLE,         /* Titles in byte order, books sharing a title ordered by serial number. */
+    ORDER_BY_ISBN           /* Serial numbers in byte order. */
+}book_order_t;
+
+/**
+ * @brief The position of a listing: the page after it starts with the next book in order.
+ *
+ * A default cursor (empty serial number) starts at the first book. The cursor holds the sort
+ * key of the last book of a page rather than an offset, so a page stays stable while books are
+ * added or removed before it, and the next one is found with a single tree descent.
+ */
+struct BookCursor
+{
+    // The title of the last book listed, only used in title order.
+    string title;
+
+    // The serial number of the last book listed, empty to start from the first book.
+    string ISBN;
+};
+
+/**
+ * @brief A page of a listing of the catalogue.
+ */
+struct BookPage
+{
+    // The books of the page, in listing order.
+    vector<shared_ptr<Book>> books;
+
+    // The cursor to pass to get the next page.
+    BookCursor next;
+
+    // Whether more books follow the page.
+    bool has_more = false;
+};
+
+/**
+ * @brief The book handles of the catalogue kept sorted by title or by serial number.
+ *
+ * The tree holds the handles with the first 8 bytes of their sort key, so most comparisons
+ * are settled by one integer compare inside the node; only ties read the full title and
+ * serial number in place from the columnar catalogue. A handle must therefore be inserted after
+ * its fields are stored there and erased before they are. Listing a page costs one descent to
+ * the cursor plus one step per book of the page.
+ */
+class OrderedBookIndex
+{
+    private:
+        /**
+         * @brief A handle with the leading bytes of its sort key.
+         */
+        struct OrderedSlot
+        {
+            /* The first 8 bytes of the sort key, big endian and zero padded. */
+            uint64_t prefix;
+            /* The handle of the book. */
+            book_handle_t slot;
+        };
+
+        /**
+         * @brief A cursor with the leading bytes of its sort key, to search the tree with.
+         */
+        struct CursorProbe
+        {
+            /* The first 8 bytes of the sort key, big endian and zero padded. */
+            uint64_t prefix;
+            /* The cursor. */
+            const BookCursor *cursor;
+        };
+
+        /**
+         * @brief Compares handles (and cursors) by the sort key of their books.
+         */
+        struct SlotOrder
+        {
+            /* Lets the tree be searched with a cursor instead of a handle. */
+            typedef void is_transparent;
+
+            /* The catalogue holding the fields of the books. */
+            const CatalogueStore *catalogue;
+            /* The order of the index. */
+            book_order_t order;
+
+            bool operator()(const OrderedSlot &left, const OrderedSlot &right) const;
+            bool operator()(const OrderedSlot &left, const CursorProbe &right) const;
+            bool operator()(const CursorProbe &left, const OrderedSlot &right) const;
+
+            /**
+             * @brief Compares two sort keys: negative, zero or positive as left sorts before, with or after right.
+            */
+            int Compare(string_view left_title, string_view left_isbn, string_view right_title, string_view right_isbn) const;
+        };
+
+        /* The catalogue holding the fields of the books. */
+        const CatalogueStore *catalogue;
+        /* The order of the index. */
+        book_order_t order;
+
+        /* The handles in order. */
+        set<OrderedSlot, SlotOrder> slots;
+
+        /**
+         * @brief Gets the first 8 bytes of a sort key as a big endian integer, zero padded.
+        */
+        static uint64_t PrefixOf(string_view key);
+
+        /**
+         * @brief Pairs a handle with the prefix of its sort key.
+        */
+        OrderedSlot EntryOf(book_handle_t slot) const;
+
+        /**
+         * @brief Pairs handles with their prefixes and sorts them.
+        */
+        vector<OrderedSlot> SortedEntries(const vector<book_handle_t> &handles) const;
+
+    public:
+        /**
+         * @brief Constructs an empty index.
+         *
+         * @param catalogue The catalogue holding the fields of the books, which must outlive the index.
+         * @param order The order of the index.
+        */
+        OrderedBookIndex(const CatalogueStore &catalogue, book_order_t order);
+
+        /**
+         * @brief Adds a book, whose fields are already stored in the catalogue.
+         *
+         * @param slot The handle of the book.
+        */
+        void Insert(book_handle_t slot);
+
+        /**
+         * @brief Adds a batch of books, whose fields are already stored in the catalogue.
+         *
+         * A batch small next to the index is inserted book by book; a larger one is sorted on its
+         * own and merged with the index in a single ordered pass.
+         *
+         * @param handles The handles of the books.
+        */
+        void InsertBatch(const vector<book_handle_t> &handles);
+
+        /**
+         * @brief Removes a book, whose fields are still stored in the catalogue.
+         *
+         * @param slot The handle of the book.
+        */
+        void Erase(book_handle_t slot);
+
+        /**
+         * @brief Replaces the content of the index with handles already in order.
+         *
+         * Every handle is appended at the end of the tree, which is linear rather than one
+         * descent per book. A handle out of order still lands in its place, only slower, and
+         * a duplicate is dropped.
+         *
+         * @param handles The handles of every book, as returned by GetHandles().
+         * @param count The number of handles.
+        */
+        void Load(const book_handle_t *handles, size_t count);
+
+        /**
+         * @brief Gets every handle of the index, in order.
+         *
+         * @return vector<book_handle_t> The handles.
+        */
+        vector<book_handle_t> GetHandles() const;
+
+        /**
+         * @brief Gets the number of books of the index.
+        */
+        size_t Size() const { return slots.size(); }
+
+        /**
+         * @brief Gets the handles of the books following a cursor.
+         *
+         * @param after The cursor, a default one to start from the first book.
+         * @param limit The largest number of handles returned.
+         * @param has_more Set to whether more books follow the returned ones.
+         * @return vector<book_handle_t> The handles, in order.
+        */
+        vector<book_handle_t> Page(const BookCursor &after, size_t limit, bool &has_more) const;
+
+        /**
+         * @brief Removes every book from the index.
+        */
+        void Clear();
+
+        /**
+         * @brief Exchanges the books of two indexes of the same order.
+         *
+         * Each index keeps comparing through its own catalogue, so the catalogues must have
+         * exchanged their books first. The tree nodes move across without any allocation, each
+         * one appended at the end of its new tree.
+         *
+         * @param other The index to exchange the books with.
+        */
+        void Swap(OrderedBookIndex &other);
+};
+
+#endif
@@ -0,0 +1,133 @@
+#ifndef _SEGMENTED_ARRAY_HPP_
+#define _SEGMENTED_ARRAY_HPP_
+
+#include <cstddef>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <algorithm>
+
+// Use the standard namespace for convenience
+using namespace std;
+
+/**
+ * @brief A growable array whose elements never move.
+ *
+ * The elements live in fixed-size segments reached through a directory of segment pointers.
+ * Growing the array allocates new segments and, when the directory is full, publishes a copy
+ * of it twice as large; the old directories are kept until the array is cleared. An element
+ * can therefore be read or updated in place (atomically if needed) while another thread grows
+ * the array, which a vector reallocating its buffer would not allow. New elements are zeroed.
+ *
+ * Growing and clearing are not thread-safe with each other: a single writer grows the array,
+ * and nobody may access it while it is cleared.
+ */
+template <typename T, unsigned SEGMENT_BITS = 12>
+class SegmentedArray
+{
+    private:
+        /* The number of elements of a segment. */
+        static const size_t SEGMENT_SIZE = size_t(1) << SEGMENT_BITS;
+
+        /* The published directory, loaded by every access. */
+        atomic<T **> directory{nullptr};
+        /* Every directory published so far, the last one is the current one. */
+        vector<unique_ptr<T *[]>> directories;
+        /* The number of entries of the current directory. */
+        size_t directory_size = 0;
+        /* The segments, in index order. */
+        vector<unique_ptr<T[]>> segments;
+
+    public:
+        SegmentedArray() = default;
+        SegmentedArray(const SegmentedArray &) = delete;
+        SegmentedArray &operator=(const SegmentedArray &) = delete;
+
+        /**
+         * @brief Gets an element, which must lie below Capacity().
+        */
+        T &operator[](size_t index)
+        {
+            return directory.load(memory_order_acquire)[index >> SEGMENT_BITS][index & (SEGMENT_SIZE - 1)];
+        }
+
+        /**
+         * @brief Gets an element, which must lie below Capacity().
+        */
+        const T &operator[](size_t index) const
+        {
+            return directory.load(memory_order_acquire)[index >> SEGMENT_BITS][index & (SEGMENT_SIZE - 1)];
+        }
+
+        /**
+         * @brief Gets the number of elements allocated so far.
+        */
+        size_t Capacity() const
+        {
+            return segments.size() * SEGMENT_SIZE;
+        }
+
+        /**
+         * @brief Allocates the segments covering a number of elements, the existing ones stay in place.
+         *
+         * @param size The number of elements to cover.
+        */
+        void Grow(size_t size)
+        {
+            size_t needed = (size + SEGMENT_SIZE - 1) / SEGMENT_SIZE;
+            if(needed <= segments.size())
+            {
+                return;
+            }
+
+            // Publish a larger copy of the directory, the readers of the old one still find their segments
+            if(needed > directory_size)
+            {
+                size_t new_size = max(needed, 2 * directory_size);
+                unique_ptr<T *[]> grown(new T *[new_size]());
+                for(size_t i = 0; i < segments.size(); i++)
+                {
+                    grown[i] = segments[i].get();
+                }
+                directory_size = new_size;
+                directories.push_back(std::move(grown));
+                directory.store(directories.back().get(), memory_order_release);
+            }
+
+            // Fill the new entries, no reader looks past the elements published to it
+            T **current = directories.back().get();
+            while(segments.size() < needed)
+            {
+                segments.emplace_back(new T[SEGMENT_SIZE]());
+                current[segments.size() - 1] = segments.back().get();
+            }
+        }
+
+        /**
+         * @brief Releases every segment and directory.
+        */
+        void Clear()
+        {
+            directory.store(nullptr, memory_order_relaxed);
+            directories.clear();
+            directory_size = 0;
+            segments.clear();
+        }
+
+        /**
+         * @brief Exchanges the elements of two arrays, nobody may access either of them meanwhile.
+         *
+         * @param other The array to exchange the elements with.
+        */
+        void Swap(SegmentedArray &other)
+        {
+            T **published = directory.load(memory_order_relaxed);
+            directory.store(other.directory.load(memory_order_relaxed), memory_order_relaxed);
+            other.directory.store(published, memory_order_relaxed);
+            directories.swap(other.directories);
+            std::swap(directory_size, other.directory_size);
+            segments.swap(other.segments);
+        }
+};
+
+#endif
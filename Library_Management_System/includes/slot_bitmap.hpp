@@ -0,0 +1,115 @@
+#ifndef _SLOT_BITMAP_HPP_
+#define _SLOT_BITMAP_HPP_
+
+#include <vector>
+#include <cstdint>
+#include "book.hpp"
+#include "segmented_array.hpp"
+
+// Use the standard namespace for convenience
+using namespace std;
+
+/**
+ * @brief A packed bitset indexed by book slot.
+ *
+ * Every slot owns one bit inside an array of 64-bit words, so a library-wide flag such as
+ * the availability of the books costs one bit per book and counting the set flags is a
+ * popcount per word instead of a visit per book. The words live in a segmented array, so
+ * growing the bitmap never moves the words other threads are flipping.
+ */
+class SlotBitmap
+{
+    private:
+        /* The words holding the bits, slot s lives in bit (s % 64) of word (s / 64). */
+        SegmentedArray<uint64_t> words;
+        /* The number of words covered by the bitmap. */
+        size_t word_count = 0;
+
+    public:
+        /**
+         * @brief Grows the bitmap so it covers a number of slots, new bits are cleared.
+         *
+         * @param slots The number of slots to cover.
+        */
+        void Resize(size_t slots);
+
+        /**
+         * @brief Reserves room for a number of slots.
+         *
+         * @param slots The number of slots.
+        */
+        void Reserve(size_t slots);
+
+        /**
+         * @brief Sets or clears the bit of a slot.
+         *
+         * The word is updated with an atomic read-modify-write, so threads flipping bits of
+         * different slots of the same word never lose each other's updates, even while another
+         * thread grows the bitmap.
+         *
+         * @param slot The slot to update.
+         * @param value The new value of the bit.
+         * @return The previous value of the bit.
+        */
+        bool Assign(book_handle_t slot, bool value)
+        {
+            uint64_t mask = uint64_t(1) << (slot & 63);
+            uint64_t *word = &words[slot >> 6];
+            uint64_t previous = value ? __atomic_fetch_or(word, mask, __ATOMIC_RELAXED)
+                                      : __atomic_fetch_and(word, ~mask, __ATOMIC_RELAXED);
+            return (previous & mask) != 0;
+        }
+
+        /**
+         * @brief Gets the bit of a slot.
+         *
+         * @param slot The slot to read, slots beyond the bitmap read as cleared.
+         * @return The value of the bit.
+        */
+        bool Test(book_handle_t slot) const
+        {
+            return (slot >> 6) < word_count && ((__atomic_load_n(&words[slot >> 6], __ATOMIC_RELAXED) >> (slot & 63)) & 1);
+        }
+
+        /**
+         * @brief Counts the set bits with a popcount per word.
+         *
+         * @return The number of slots whose bit is set.
+        */
+        size_t Count() const;
+
+        /**
+         * @brief Counts the slots set in both this bitmap and another one.
+         *
+         * @param other The bitmap to combine with.
+         * @return The popcount of the bitwise AND of the two bitmaps.
+        */
+        size_t CountAnd(const SlotBitmap &other) const;
+
+        /**
+         * @brief Gets the number of words of the bitmap, for bulk scans.
+        */
+        size_t WordCount() const { return word_count; }
+
+        /**
+         * @brief Gets a word of the bitmap, for bulk scans.
+         *
+         * @param index The index of the word, below WordCount().
+         * @return The 64 bits of slots 64 * index to 64 * index + 63.
+        */
+        uint64_t Word(size_t index) const { return __atomic_load_n(&words[index], __ATOMIC_RELAXED); }
+
+        /**
+         * @brief Clears the bitmap.
+        */
+        void Clear();
+
+        /**
+         * @brief Exchanges the bits of two bitmaps, nobody may access either of them meanwhile.
+         *
+         * @param other The bitmap to exchange the bits with.
+        */
+        void Swap(SlotBitmap &other);
+};
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef _TITLE_INDEX_HPP_
+#define _TITLE_INDEX_HPP_
+
+#include <string>
+#include <vector>
+#include "book.hpp"
+#include "posting_index.hpp"
+
+// Use the standard namespace for convenience
+using namespace std;
+
+/**
+ * @brief A tokenized full-text index over the titles of the books.
+ *
+ * Every title is split into lowercase terms and each term points to the sorted posting list
+ * of the books containing it, so a title query costs a few hash lookups plus work proportional
+ * to the matching books instead of a walk over the whole catalogue.
+ */
+class TitleIndex
+{
+    private:
+        /* The inverted index from title terms to book handles. */
+        PostingIndex terms;
+
+    public:
+        /**
+         * @brief Splits a title into normalized search terms.
+         *
+         * Terms are separated by any non alphanumeric character and by lower to upper case
+         * transitions (so "LinearAlgebra" yields "linear" and "algebra"), then lowercased.
+         * Repeated terms are kept only once.
+         *
+         * @param title The title to split.
+         * @return The terms of the title in order of first appearance.
+        */
+        static vector<string> TokenizeTitle(const string &title);
+
+        /**
+         * @brief Indexes the title of a book.
+         *
+         * @param handle The handle of the book.
+         * @param title The title of the book.
+        */
+        void AddTitle(book_handle_t handle, const string &title);
+
+        /**
+         * @brief Removes the title of a book from the index.
+         *
+         * @param handle The handle of the book.
+         * @param title The title the book was indexed with.
+        */
+        void RemoveTitle(book_handle_t handle, const string &title);
+
+        /**
+         * @brief Collects the posting lists of every term of a query.
+         *
+         * @param query The title (or part of it) to search for.
+         * @param lists The list receiving one posting list per term of the query.
+         * @return false if a term of the query is held by no book, true otherwise.
+        */
+        bool CollectPostings(const string &query, vector<const PostingList *> &lists) const;
+
+        /**
+         * @brief Finds the books whose titles contain every term of a query.
+         *
+         * The posting lists of the terms are intersected from the shortest one, so the cost
+         * follows the number of candidates rather than the size of the catalogue.
+         *
+         * @param query The title (or part of it) to search for.
+         * @return The sorted handles of the matching books.
+        */
+        vector<book_handle_t> SearchTitle(const string &query) const;
+
+        /**
+         * @brief Gets the inverted index of the title terms.
+         *
+         * @return The posting index from the title terms to the book handles.
+        */
+        const PostingIndex &GetTerms() const { return terms; }
+
+        /**
+         * @brief Gets the inverted index of the title terms for restoring a saved index.
+         *
+         * @return The posting index from the title terms to the book handles.
+        */
+        PostingIndex &GetTerms() { return terms; }
+
+        /**
+         * @brief Removes all the titles from the index.
+        */
+        void Clear();
+};
+
+#endif
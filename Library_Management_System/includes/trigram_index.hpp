@@ -0,0 +1,175 @@
+#ifndef _TRIGRAM_INDEX_HPP_
+#define _TRIGRAM_INDEX_HPP_
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include "book.hpp"
+#include "posting_index.hpp"
+
+// Use the standard namespace for convenience
+using namespace std;
+
+/**
+ * @brief A term of the catalogue approximately matching a term of a query.
+ */
+typedef struct
+{
+    uint32_t term;          /* The ID of the term in the vocabulary of the index. */
+    unsigned cost;          /* 0 for the same term, 1 if the query term starts it, 2 if it lies inside it,
+                               2 per edit (insertion, deletion, substitution or swap of neighbours) otherwise. */
+}term_match_t;
+
+/**
+ * @brief A trigram index over the terms of the titles and authors, for fuzzy and substring searches.
+ *
+ * The index holds the vocabulary of the catalogue (every distinct term of a title or an author
+ * name, as split by TitleIndex::TokenizeTitle) rather than the books, and maps every trigram
+ * to the terms containing it. A query term is matched in two steps:
+ *  - candidate filtering: the terms listed under the rarest trigrams of the query term, which
+ *    any term close enough to it must hold some of;
+ *  - verification: the edit distance of each candidate, bounded so that a hopeless candidate
+ *    is dropped after a few rows, or a plain substring check.
+ * The books of the matching terms then come from the posting lists of the title terms and of
+ * the author terms, and a book must match every term of the query.
+ *
+ * The allowed edit distance grows with the length of the query term: none up to 3 characters,
+ * one up to 7, two beyond.
+ */
+class TrigramIndex
+{
+    private:
+        /**
+         * @brief A term of the vocabulary.
+         */
+        struct TermEntry
+        {
+            /* The ID of the term, its position in terms. */
+            uint32_t id;
+            /* The number of titles and author names holding the term. */
+            uint32_t references;
+        };
+
+        /* The books of every title term, owned by the title index. */
+        const PostingIndex *title_terms;
+
+        /* The books of every term of the author names. */
+        PostingIndex author_terms;
+
+        /* The terms of the catalogue with their ID and number of references. */
+        unordered_map<string, TermEntry> vocabulary;
+
+        /* The text of every term by ID, empty for a released ID. */
+        vector<string> terms;
+
+        /* The IDs released by terms no title or author holds anymore. */
+        vector<uint32_t> free_ids;
+
+        /* The IDs of the terms containing each trigram, in no particular order. */
+        unordered_map<uint32_t, vector<uint32_t>> trigrams;
+
+        /**
+         * @brief Gets the distinct trigrams of a term.
+         *
+         * @param term The term.
+         * @param padded Whether the term is padded with two blanks in front and one behind, which
+         *               gives even a one letter term a trigram and weighs its first letters more.
+         * @return vector<uint32_t> The trigrams packed into integers, sorted.
+        */
+        static vector<uint32_t> TrigramsOf(string_view term, bool padded);
+
+        /**
+         * @brief Adds a reference to a term, inserting it in the vocabulary if new.
+        */
+        void AddTerm(const string &term);
+
+        /**
+         * @brief Drops a reference to a term, removing it from the vocabulary if it was the last.
+        */
+        void RemoveTerm(const string &term);
+
+        /**
+         * @brief Finds the terms of the vocabulary approximately matching a term of a query.
+         *
+         * @param term The normalized query term.
+         * @return vector<term_match_t> The matching terms, cheapest first.
+        */
+        vector<term_match_t> MatchTerm(const string &term) const;
+
+    public:
+        /* The largest number of vocabulary terms a query term may match, the cheapest are kept. */
+        static const size_t MAX_TERM_MATCHES = 256;
+
+        /**
+         * @brief Constructs an empty index.
+         *
+         * @param title_terms The posting lists of the title terms, which must outlive the index.
+        */
+        explicit TrigramIndex(const PostingIndex &title_terms);
+
+        /**
+         * @brief Gets the number of edits allowed between a query term and a catalogue term.
+         *
+         * @param length The length of the query term.
+        */
+        static unsigned MaxDistance(size_t length);
+
+        /**
+         * @brief Computes the edit distance of two terms, stopping once it exceeds a bound.
+         *
+         * The distance counts insertions, deletions, substitutions and swaps of two neighbouring
+         * characters (the optimal string alignment distance).
+         *
+         * @param left The first term.
+         * @param right The second term.
+         * @param bound The largest distance of interest.
+         * @return unsigned The distance, or bound + 1 if it is larger than bound.
+        */
+        static unsigned EditDistance(string_view left, string_view right, unsigned bound);
+
+        /**
+         * @brief Adds the terms of the title and author of a book.
+         *
+         * @param handle The handle of the book.
+         * @param title The title of the book.
+         * @param author The author of the book.
+        */
+        void AddBook(book_handle_t handle, const string &title, const string &author);
+
+        /**
+         * @brief Removes the terms of the title and author of a book.
+         *
+         * @param handle The handle of the book.
+         * @param title The title the book was indexed with.
+         * @param author The author the book was indexed with.
+        */
+        void RemoveBook(book_handle_t handle, const string &title, const string &author);
+
+        /**
+         * @brief Finds the books whose title or author approximately holds every term of a query.
+         *
+         * The books are ranked by the sum over the terms of the query of their cheapest match,
+         * then by handle.
+         *
+         * @param query The partial or misspelled title or author name.
+         * @param limit The largest number of books returned.
+         * @return vector<book_handle_t> The handles of the best books, best first.
+        */
+        vector<book_handle_t> Search(const string &query, size_t limit) const;
+
+        /**
+         * @brief Removes every term from the index.
+        */
+        void Clear();
+
+        /**
+         * @brief Exchanges the terms of two indexes, each one keeps reading its own title terms.
+         *
+         * @param other The index to exchange the terms with.
+        */
+        void Swap(TrigramIndex &other);
+};
+
+#endif
@@ -34,7 +34,7 @@ class User
         string user_name; 
         // The unique identifier for the user.
         int user_id;
-        // List of books borrowed by the user.
+        // List of books borrowed by the user, each book remembers its position in it.
         vector<shared_ptr<Book>> books_borrowed;
 
     public:
@@ -48,12 +48,13 @@ class User
         /**
          * @brief Parameterized constructor for the User class.
          * 
-         * Initializes a User object with the provided name and ID.
+         * Initializes a User object with the provided name and ID. The name is taken by value
+         * and moved in, so a temporary is never copied.
          * 
-         * @param name Reference to the user's name.
-         * @param id Reference to the user's ID.
+         * @param name The user's name.
+         * @param id The user's ID.
          */
-        User(string &name, int &id);
+        User(string name, int id);
 
         /**
          * @brief Destructor for the User class.
@@ -67,7 +68,7 @@ class User
          * 
          * @param name The new name of the user.
          */
-        void SetUserName(const string &name);
+        void SetUserName(string name);
 
         /**
          * @brief Sets the user's ID.
@@ -81,14 +82,14 @@ class User
          * 
          * @return The name of the user.
         */
-        string GetUserName();
+        const string &GetUserName() const;
 
         /**
          * @brief Gets the user's ID.
          * 
          * @return The ID of the user.
         */
-        int GetUserId();
+        int GetUserId() const;
 
         /**
          * @brief Allows the user to borrow a book.
@@ -99,25 +100,29 @@ class User
          * @param book Shared pointer to the book to be borrowed.
          * @return Ret_val_t Enumeration indicating the result of the operation.
         */
-        Ret_val_t UserBorrowBook(shared_ptr<Book> book);
+        Ret_val_t UserBorrowBook(const shared_ptr<Book> &book);
 
         /**
          * @brief Allows the user to return a book.
          * 
          * Removes the specified book from the list of borrowed books if the book is currently
-         * borrowed by the user.
+         * borrowed by the user. The book is found through its loan index and the last book of the
+         * list takes its place, so the return is O(1) whatever the number of loans.
          * 
          * @param book Shared pointer to the book to be returned.
          * @return Ret_val_t Enumeration indicating the result of the operation.
         */
-        Ret_val_t UserReturnBook(shared_ptr<Book> book);
+        Ret_val_t UserReturnBook(const shared_ptr<Book> &book);
 
         /**
          * @brief Gets the list of books borrowed by the user.
          * 
-         * @return A vector of shared pointers to the books borrowed by the user.
+         * The books are kept contiguous but not in borrowing order, since returns move the last
+         * book of the list into the freed position.
+         * 
+         * @return A read-only view of the books borrowed by the user, valid until the next borrow or return.
         */
-        vector<shared_ptr<Book>> GetBorrowedBooks();   
+        const vector<shared_ptr<Book>> &GetBorrowedBooks() const;   
 };
 
 
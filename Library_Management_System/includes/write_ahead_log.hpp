@@ -0,0 +1,197 @@
+#ifndef _WRITE_AHEAD_LOG_HPP_
+#define _WRITE_AHEAD_LOG_HPP_
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+#include <condition_variable>
+#include "isbn_key.hpp"
+
+// Use the standard namespace for convenience
+using namespace std;
+
+class Library;
+
+/**
+ * @brief Enumeration for the kinds of records of the write-ahead log.
+ */
+typedef enum
+{
+    LOG_ADD_BOOK = 1,       /* A book was added: title, author, genre and serial number. */
+    LOG_REMOVE_BOOK,        /* A book was removed: serial number. */
+    LOG_REGISTER_USER,      /* A user was registered: ID and name. */
+    LOG_REMOVE_USER,        /* A user was removed: ID. */
+    LOG_BORROW_BOOK,        /* A user borrowed a book: user ID and the two words of the book key. */
+    LOG_RETURN_BOOK         /* A user returned a book: user ID and the two words of the book key. */
+}log_record_t;
+
+/**
+ * @brief An append-only log of the mutations of a library, made durable by group commit.
+ *
+ * Every mutation is encoded as a compact binary record (length, checksum, kind, payload) and
+ * appended to an in-memory batch under a short lock, which hands it a sequence number. A
+ * caller then waits in Commit() until its record is on disk: the first waiter becomes the
+ * leader, writes the whole pending batch and runs a single fdatasync for it, while the records
+ * appended in the meantime form the next batch. Durability costs one fsync per batch, not per
+ * mutation.
+ *
+ * On startup, Replay() applies the records of the log to a library and cuts a torn tail left
+ * by a crash. The log is emptied by Library::Checkpoint() once a snapshot holds its effects.
+ */
+class WriteAheadLog
+{
+    private:
+        /* The descriptor of the log file, -1 while closed. */
+        int fd = -1;
+
+        /* Protects the pending batch and the sequence numbers. */
+        mutex lock;
+        /* Signalled whenever a batch reaches the disk. */
+        condition_variable flushed;
+
+        /* The records appended but not yet written. */
+        string pending;
+        /* The sequence number of the last appended record. */
+        uint64_t last_sequence = 0;
+        /* The sequence number of the last record known to be on disk. */
+        uint64_t durable_sequence = 0;
+        /* Whether a leader is writing a batch. */
+        bool flushing = false;
+        /* Whether every write and sync succeeded. */
+        bool healthy = true;
+
+        /* The number of batches written, for reporting. */
+        uint64_t batch_count = 0;
+
+        /**
+         * @brief Frames a payload as a record and appends it to the pending batch.
+         *
+         * @param kind The kind of the record.
+         * @param payload The encoded fields of the record.
+         * @return uint64_t The sequence number of the record.
+        */
+        uint64_t Append(log_record_t kind, const string &payload);
+
+    public:
+        /**
+         * @brief Destructs the log, committing the pending records.
+        */
+        ~WriteAheadLog();
+
+        /**
+         * @brief Opens (or creates) a log file for replay and appending.
+         *
+         * @param path The path of the log file.
+         * @return true if the file could be opened.
+        */
+        bool Open(const string &path);
+
+        /**
+         * @brief Commits the pending records and closes the log file.
+        */
+        void Close();
+
+        /**
+         * @brief Applies every record of the log to a library.
+         *
+         * The library must not have the log attached, so the replayed mutations are not logged
+         * again. Replay stops at the first truncated or corrupted record, and the file is cut
+         * there so new records follow the last valid one. An intact record of an unknown kind or
+         * with a malformed payload, written by another version, also stops the replay, but the
+         * file is left untouched and the log refuses new records: IsHealthy() then returns false.
+         *
+         * @param library The library the records are applied to.
+         * @return size_t The number of records replayed.
+        */
+        size_t Replay(Library &library);
+
+        /**
+         * @brief Empties the log, once a snapshot holds the effect of every record.
+         *
+         * Every record logged so far must be covered by the snapshot, so the call must be made while
+         * the library still blocks every mutation, as Library::Checkpoint() does: the pending records
+         * are dropped and reported durable to their waiters.
+         *
+         * @return true if the file could be truncated.
+        */
+        bool Truncate();
+
+        /**
+         * @brief Logs the addition of a book.
+         *
+         * @param title The title of the book.
+         * @param author The author of the book.
+         * @param gener The genre of the book.
+         * @param ISBN The serial number of the book.
+         * @return uint64_t The sequence number to commit.
+        */
+        uint64_t LogAddBook(const string &title, const string &author, const string &gener, const string &ISBN);
+
+        /**
+         * @brief Logs the removal of a book.
+         *
+         * @param ISBN The serial number of the book.
+         * @return uint64_t The sequence number to commit.
+        */
+        uint64_t LogRemoveBook(const string &ISBN);
+
+        /**
+         * @brief Logs the registration of a user.
+         *
+         * @param id The ID of the user.
+         * @param name The name of the user.
+         * @return uint64_t The sequence number to commit.
+        */
+        uint64_t LogRegisterUser(int id, const string &name);
+
+        /**
+         * @brief Logs the removal of a user.
+         *
+         * @param id The ID of the user.
+         * @return uint64_t The sequence number to commit.
+        */
+        uint64_t LogRemoveUser(int id);
+
+        /**
+         * @brief Logs a loan.
+         *
+         * @param user_id The ID of the borrower.
+         * @param key The key of the book.
+         * @return uint64_t The sequence number to commit.
+        */
+        uint64_t LogBorrowBook(int user_id, IsbnKey key);
+
+        /**
+         * @brief Logs a return.
+         *
+         * @param user_id The ID of the borrower.
+         * @param key The key of the book.
+         * @return uint64_t The sequence number to commit.
+        */
+        uint64_t LogReturnBook(int user_id, IsbnKey key);
+
+        /**
+         * @brief Waits until a record and every record before it are on disk.
+         *
+         * @param sequence The sequence number returned when the record was logged.
+         * @return true if the record is durable, false if the log could not be written.
+        */
+        bool Commit(uint64_t sequence);
+
+        /**
+         * @brief Tells whether records can still be appended to the log.
+         *
+         * @return true if every write and sync succeeded and the replay could read every intact record.
+        */
+        bool IsHealthy();
+
+        /**
+         * @brief Gets the number of batches written so far.
+         *
+         * @return The number of fsyncs issued by the group commit.
+        */
+        uint64_t BatchCount();
+};
+
+#endif
@@ -16,31 +16,34 @@ using namespace std;
 Book::Book()
 {   
     // Sets the availability status of the book to true by default.
-    availability = true;
+    loan_word.store(0, memory_order_relaxed);
+    // The book has no slot until it is added to a library.
+    book_slot = 0;
+    // The book is in no list of borrowed books until it is borrowed.
+    loan_index = 0;
 }
 
 /**
  * @brief Parameterized constructor for the Book class.
  * 
- * Initializes a Book object with the specified title, author, genre, and ISBN.
+ * Initializes a Book object with the specified title, author, genre, and ISBN. The strings
+ * are taken by value and moved in, so temporaries are never copied.
  * 
  * @param title The title of the book.
  * @param author The author of the book.
  * @param gener The genre of the book. (Note: Typo in "gener" should be "genre")
  * @param ISBN The ISBN number of the book.
 */
-Book::Book(const string &title,const string &author,const string &gener,const string &ISBN)
+Book::Book(string title, string author, string gener, string ISBN)
+    : book_title(std::move(title)), book_author(std::move(author)), book_gener(std::move(gener)), book_ISBN(std::move(ISBN))
 {
-    // Sets the book title to the value provided by the parameter.
-    book_title = title;
-    // Sets the book author to the value provided by the parameter.
-    book_author = author;
-    // Sets the book genre to the value provided by the parameter.
-    book_gener = gener;
-    // Sets the book ISBN to the value provided by the parameter.
-    book_ISBN = ISBN;
+    // The title, author, genre and ISBN are moved in from the parameters.
     // Sets the availability status of the book to true by default.
-    availability = true;
+    loan_word.store(0, memory_order_relaxed);
+    // The book has no slot until it is added to a library.
+    book_slot = 0;
+    // The book is in no list of borrowed books until it is borrowed.
+    loan_index = 0;
 }
 
 /**
@@ -58,10 +61,10 @@ Book::~Book()
  * 
  * @param name The new title of the book.
 */
-void Book::SetBookName(string &name)
+void Book::SetBookName(string name)
 {
     // Updates the book's title to the new value provided.
-    book_title = name;
+    book_title = std::move(name);
 }
 
 /**
@@ -69,10 +72,10 @@ void Book::SetBookName(string &name)
  * 
  * @param author The new author of the book.
 */
-void Book::SetBookAuthor(string &author)
+void Book::SetBookAuthor(string author)
 {
     // Updates the book's author to the new value provided.
-    book_author = author;
+    book_author = std::move(author);
 }
 
 /**
@@ -80,10 +83,10 @@ void Book::SetBookAuthor(string &author)
  * 
  * @param ISBN The new ISBN number of the book.
 */
-void Book::SetBookNumber(string &ISBN)
+void Book::SetBookNumber(string ISBN)
 {
     // Updates the book's ISBN number to the new value provided.
-    book_ISBN = ISBN;
+    book_ISBN = std::move(ISBN);
 }
 
 /**
@@ -91,21 +94,105 @@ void Book::SetBookNumber(string &ISBN)
  * 
  * @param gener The new genre of the book. 
 */
-void Book::SetBookGener(string &gener)
+void Book::SetBookGener(string gener)
 {
     // Updates the book's genre to the new value provided.
-    book_gener = gener;
+    book_gener = std::move(gener);
 }
 
 /**
- * @brief Sets the availability status of the book.
+ * @brief Puts the book back on the shelf, dropping its loan word.
  * 
- * @param choise The new availability status of the book (true if available, false otherwise).
+ * @param choise true to make the book available, false leaves the loan word as it is.
 */
-void Book::SetBookAvailability(bool &choise)
+void Book::SetBookAvailability(bool choise)
 {
-    // Updates the book's availability status to the new value provided.
-    availability = choise;
+    // A loan is only ever made by TryClaim(), which names the borrower.
+    if(choise)
+    {
+        loan_word.store(0, memory_order_release);
+    }
+}
+
+/**
+ * @brief Sets the position of the book in the list of books of its borrower.
+ * 
+ * @param index The position of the book in the borrowed books of the user holding it.
+*/
+void Book::SetLoanIndex(uint32_t index)
+{
+    // Updates the position the borrower keeps the book at.
+    loan_index = index;
+}
+
+/**
+ * @brief Atomically claims the book for a borrower.
+ * 
+ * @param user_id The ID of the user borrowing the book.
+ * @return true if the book was available and is now on loan to the user.
+*/
+bool Book::TryClaim(int user_id)
+{
+    // Swap the loan word from available to borrowed by the user, failing if anyone holds it.
+    uint64_t expected = 0;
+    uint64_t claimed = LOAN_TAG | static_cast<uint32_t>(user_id);
+    return loan_word.compare_exchange_strong(expected, claimed, memory_order_acq_rel, memory_order_acquire);
+}
+
+/**
+ * @brief Atomically releases the book held by a borrower.
+ * 
+ * @param user_id The ID of the user returning the book.
+ * @return true if the book was on loan to the user and is now available.
+*/
+bool Book::Release(int user_id)
+{
+    // Swap the loan word back to available, only if the user is the one holding it.
+    uint64_t expected = LOAN_TAG | static_cast<uint32_t>(user_id);
+    return loan_word.compare_exchange_strong(expected, 0, memory_order_acq_rel, memory_order_acquire);
+}
+
+/**
+ * @brief Checks whether the book is on loan to a user.
+ * 
+ * @param user_id The ID of the user.
+ * @return true if the user holds the book.
+*/
+bool Book::IsBorrowedBy(int user_id) const
+{
+    // Compare the loan word with the one the user would have claimed.
+    return loan_word.load(memory_order_acquire) == (LOAN_TAG | static_cast<uint32_t>(user_id));
+}
+
+/**
+ * @brief Gets the user currently holding the book.
+ * 
+ * @param user_id Receives the ID of the borrower.
+ * @return true if the book is on loan to a user, false if it is available.
+*/
+bool Book::GetBookBorrower(int &user_id) const
+{
+    // Only a tagged loan word names a borrower.
+    uint64_t word = loan_word.load(memory_order_acquire);
+    if((word & LOAN_TAG) == 0)
+    {
+        return false;
+    }
+
+    // The low 32 bits of the loan word hold the ID of the borrower.
+    user_id = static_cast<int>(static_cast<uint32_t>(word));
+    return true;
+}
+
+/**
+ * @brief Sets the slot of the book inside the library.
+ * 
+ * @param slot The dense handle assigned to the book by the library.
+*/
+void Book::SetBookSlot(book_handle_t slot)
+{
+    // Updates the book's slot to the handle assigned by the library.
+    book_slot = slot;
 }
 
 /**
@@ -113,7 +200,7 @@ void Book::SetBookAvailability(bool &choise)
  * 
  * @return The title of the book.
 */
-string Book::GetBookName()
+const string &Book::GetBookName() const
 {
     // Returns the current title of the book.
     return book_title; 
@@ -124,7 +211,7 @@ string Book::GetBookName()
  * 
  * @return The author of the book.
 */
-string Book::GetBookAuthor()
+const string &Book::GetBookAuthor() const
 {
     // Returns the current author of the book.
     return book_author;
@@ -135,7 +222,7 @@ string Book::GetBookAuthor()
  * 
  * @return The genre of the book.
 */
-string Book::GetBookGener()
+const string &Book::GetBookGener() const
 {
     // Returns the current genre of the book.
     return book_gener;
@@ -146,7 +233,7 @@ string Book::GetBookGener()
  * 
  * @return The ISBN number of the book.
 */
-string Book::GetBookNumber()
+const string &Book::GetBookNumber() const
 {
     // Returns the current ISBN number of the book.
     return book_ISBN;
@@ -157,8 +244,30 @@ string Book::GetBookNumber()
  * 
  * @return The availability status of the book (true if available, false otherwise).
 */
-bool Book::GetBookAvailability()
+bool Book::GetBookAvailability() const
+{
+    // The book is available while nobody holds its loan word.
+    return loan_word.load(memory_order_acquire) == 0;
+}
+
+/**
+ * @brief Gets the slot of the book inside the library.
+ * 
+ * @return The dense handle assigned to the book by the library.
+*/
+book_handle_t Book::GetBookSlot() const
+{
+    // Returns the slot assigned to the book by the library.
+    return book_slot;
+}
+
+/**
+ * @brief Gets the position of the book in the list of books of its borrower.
+ * 
+ * @return The position of the book in the borrowed books of the user holding it.
+*/
+uint32_t Book::GetLoanIndex() const
 {
-    // Returns the current availability status of the book.
-    return availability;
+    // Returns the position the borrower keeps the book at.
+    return loan_index;
 }
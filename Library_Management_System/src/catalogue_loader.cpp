@@ -0,0 +1,272 @@
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cctype>
+#include <cstring>
+#include <strings.h>
+#include <utility>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "catalogue_loader.hpp"
+
+using namespace std;
+
+/**
+ * @brief Reads one field of a line and moves the cursor past its delimiter.
+ *
+ * @param cursor The first character of the field, moved past the field and its delimiter.
+ * @param end The end of the line.
+ * @param delimiter The field delimiter.
+ * @param field Receives the unquoted content of the field.
+ * @return false if the line is over before the field, true otherwise.
+*/
+static bool ParseField(const char *&cursor, const char *end, char delimiter, string &field)
+{
+    field.clear();
+
+    if(cursor > end)
+    {
+        // The previous field was the last one of the line.
+        return false;
+    }
+
+    if(cursor < end && *cursor == '"')
+    {
+        // A quoted field ends at a quote that is not doubled.
+        cursor++;
+        while(cursor < end)
+        {
+            if(*cursor == '"')
+            {
+                if(cursor + 1 < end && cursor[1] == '"')
+                {
+                    field.push_back('"');
+                    cursor += 2;
+                    continue;
+                }
+                cursor++;
+                break;
+            }
+            field.push_back(*cursor++);
+        }
+
+        // Skip anything left up to the delimiter.
+        while(cursor < end && *cursor != delimiter)
+        {
+            cursor++;
+        }
+    }
+    else
+    {
+        // A plain field ends at the delimiter, copied in one go.
+        const char *stop = static_cast<const char *>(memchr(cursor, delimiter, end - cursor));
+        if(stop == nullptr)
+        {
+            stop = end;
+        }
+        field.assign(cursor, stop);
+        cursor = stop;
+    }
+
+    // Step over the delimiter, landing past the end after the last field.
+    cursor++;
+    return true;
+}
+
+/**
+ * @brief Constructs a loader.
+ *
+ * @param threads The number of parsing threads, 0 to use every core.
+*/
+CatalogueLoader::CatalogueLoader(unsigned threads)
+{
+    // Use every core unless a number of threads is requested.
+    thread_count = (threads != 0) ? threads : thread::hardware_concurrency();
+    if(thread_count == 0)
+    {
+        thread_count = 1;
+    }
+}
+
+/**
+ * @brief Parses the lines of a chunk of a catalogue file.
+ *
+ * @param begin The first character of the chunk, at the start of a line.
+ * @param end One past the last character of the chunk, at the end of a line.
+ * @param delimiter The field delimiter, a tab or a comma.
+ * @param records Receives one record per well formed line.
+ * @return size_t The number of malformed lines skipped.
+*/
+size_t CatalogueLoader::ParseChunk(const char *begin, const char *end, char delimiter, vector<BookRecord> &records)
+{
+    // The number of lines without the four fields of a book.
+    size_t malformed = 0;
+
+    while(begin < end)
+    {
+        // Find the end of the line, without its carriage return.
+        const char *line_end = static_cast<const char *>(memchr(begin, '\n', end - begin));
+        const char *next = (line_end == nullptr) ? end : line_end + 1;
+        if(line_end == nullptr)
+        {
+            line_end = end;
+        }
+        if(line_end > begin && line_end[-1] == '\r')
+        {
+            line_end--;
+        }
+
+        // Skip the blank lines.
+        if(line_end == begin)
+        {
+            begin = next;
+            continue;
+        }
+
+        // Read the title, author, genre and serial number of the book.
+        BookRecord record;
+        const char *cursor = begin;
+        if(ParseField(cursor, line_end, delimiter, record.title) &&
+           ParseField(cursor, line_end, delimiter, record.author) &&
+           ParseField(cursor, line_end, delimiter, record.gener) &&
+           ParseField(cursor, line_end, delimiter, record.ISBN))
+        {
+            records.push_back(std::move(record));
+        }
+        else
+        {
+            malformed++;
+        }
+
+        begin = next;
+    }
+
+    return malformed;
+}
+
+/**
+ * @brief Imports the books of a catalogue file into a library.
+ *
+ * @param path The path of the CSV or TSV file.
+ * @param library The library receiving the books.
+ * @param report Receives the counters and throughput of the import.
+ * @return load_handling_t Enumeration value indicating the result of the operation.
+*/
+load_handling_t CatalogueLoader::LoadFile(const string &path, Library &library, load_report_t &report)
+{
+    auto start = chrono::steady_clock::now();
+    report = load_report_t();
+
+    // Open the file and get its size.
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+    {
+        return FILE_NOT_OPENED;
+    }
+    struct stat info;
+    if(fstat(fd, &info) != 0)
+    {
+        close(fd);
+        return FILE_NOT_OPENED;
+    }
+    size_t size = static_cast<size_t>(info.st_size);
+    if(size == 0)
+    {
+        // An empty file holds no book.
+        close(fd);
+        return LOADED_SUCCESSFULLY;
+    }
+
+    // Map the whole file, the pages are read ahead since every chunk is walked once in order.
+    void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(mapping == MAP_FAILED)
+    {
+        return FILE_NOT_MAPPED;
+    }
+    madvise(mapping, size, MADV_SEQUENTIAL);
+
+    const char *data = static_cast<const char *>(mapping);
+    const char *end = data + size;
+
+    // The first line picks the delimiter and may be a header.
+    const char *first_end = static_cast<const char *>(memchr(data, '\n', size));
+    if(first_end == nullptr)
+    {
+        first_end = end;
+    }
+    char delimiter = (memchr(data, '\t', first_end - data) != nullptr) ? '\t' : ',';
+
+    const char *body = data;
+    if(first_end - data >= 5 && strncasecmp(data + ((*data == '"') ? 1 : 0), "title", 5) == 0)
+    {
+        body = (first_end == end) ? end : first_end + 1;
+    }
+
+    // Cut the body into one chunk per thread, each chunk ending right after a line feed.
+    size_t chunk_count = thread_count;
+    vector<const char *> bounds;
+    bounds.push_back(body);
+    for(size_t i = 1; i < chunk_count; i++)
+    {
+        const char *bound = body + (end - body) * i / chunk_count;
+        if(bound < bounds.back())
+        {
+            bound = bounds.back();
+        }
+        const char *line_feed = static_cast<const char *>(memchr(bound, '\n', end - bound));
+        bounds.push_back((line_feed == nullptr) ? end : line_feed + 1);
+    }
+    bounds.push_back(end);
+
+    // Parse every chunk on its own thread.
+    vector<vector<BookRecord>> chunks(chunk_count);
+    vector<size_t> malformed(chunk_count, 0);
+    vector<thread> workers;
+    for(size_t i = 0; i < chunk_count; i++)
+    {
+        workers.emplace_back([&, i]()
+        {
+            // Guess the number of records from the size of the chunk.
+            chunks[i].reserve(static_cast<size_t>(bounds[i + 1] - bounds[i]) / 48 + 1);
+            malformed[i] = ParseChunk(bounds[i], bounds[i + 1], delimiter, chunks[i]);
+        });
+    }
+    for(thread &worker : workers)
+    {
+        worker.join();
+    }
+    munmap(mapping, size);
+
+    // Gather the records in file order and add them in one batch.
+    vector<BookRecord> records;
+    size_t total = 0;
+    for(const vector<BookRecord> &chunk : chunks)
+    {
+        total += chunk.size();
+    }
+    records.reserve(total);
+    for(size_t i = 0; i < chunk_count; i++)
+    {
+        for(BookRecord &record : chunks[i])
+        {
+            records.push_back(std::move(record));
+        }
+        report.rejected += malformed[i];
+        report.records += chunks[i].size() + malformed[i];
+        vector<BookRecord>().swap(chunks[i]);
+    }
+
+    bool durable = true;
+    report.imported = library.ImportBooks(records, &durable);
+    report.rejected += records.size() - report.imported;
+
+    // Report the throughput of the whole import.
+    report.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    report.records_per_second = (report.seconds > 0) ? report.records / report.seconds : 0;
+
+    return durable ? LOADED_SUCCESSFULLY : LOADED_NOT_DURABLE;
+}
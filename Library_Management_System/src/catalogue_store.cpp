@@ -0,0 +1,363 @@
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include "catalogue_store.hpp"
+#include "posting_index.hpp"
+#include "book.hpp"
+
+using namespace std;
+
+/**
+ * @brief Stores the string of a slot, growing the column if needed.
+ *
+ * @param slot The slot receiving the string.
+ * @param value The string to store.
+*/
+void StringPool::Store(book_handle_t slot, const string &value)
+{
+    // Grow the offset and length arrays up to the slot.
+    if(slot >= offsets.size())
+    {
+        offsets.resize(slot + 1, 0);
+        lengths.resize(slot + 1, 0);
+    }
+
+    // The previous string of the slot (if any) becomes garbage.
+    garbage_bytes += lengths[slot];
+
+    // Append the characters to the end of the pool.
+    offsets[slot] = pool.size();
+    lengths[slot] = static_cast<uint32_t>(value.size());
+    pool.append(value);
+}
+
+/**
+ * @brief Erases the string of a slot.
+ *
+ * @param slot The slot to erase.
+*/
+void StringPool::Erase(book_handle_t slot)
+{
+    if(slot < offsets.size())
+    {
+        // The characters stay in the pool as garbage until the next compaction.
+        garbage_bytes += lengths[slot];
+        offsets[slot] = 0;
+        lengths[slot] = 0;
+    }
+}
+
+/**
+ * @brief Gets the number of pool bytes no slot refers to anymore.
+ *
+ * @return The number of garbage bytes.
+*/
+size_t StringPool::GarbageBytes() const
+{
+    // Returns the number of bytes left behind by erased strings.
+    return garbage_bytes;
+}
+
+/**
+ * @brief Gets the total size of the pool in bytes.
+ *
+ * @return The number of bytes of the pool, garbage included.
+*/
+size_t StringPool::PoolBytes() const
+{
+    // Returns the size of the character buffer.
+    return pool.size();
+}
+
+/**
+ * @brief Rewrites the pool with the strings still referred to by a slot.
+*/
+void StringPool::Compact()
+{
+    // The new pool holding only the live strings.
+    string compacted;
+    compacted.reserve(pool.size() - garbage_bytes);
+
+    // Copy the string of every slot, in slot order, and point the slot to its new offset.
+    for(size_t slot = 0; slot < offsets.size(); slot++)
+    {
+        uint64_t offset = compacted.size();
+        compacted.append(pool, offsets[slot], lengths[slot]);
+        offsets[slot] = offset;
+    }
+
+    // Replace the pool, no garbage is left.
+    pool.swap(compacted);
+    garbage_bytes = 0;
+}
+
+/**
+ * @brief Reserves room for a number of slots and pool bytes.
+ *
+ * @param slots The number of slots.
+ * @param bytes The number of characters of the pool.
+*/
+void StringPool::Reserve(size_t slots, size_t bytes)
+{
+    // Reserve the per slot arrays and the character buffer.
+    offsets.reserve(slots);
+    lengths.reserve(slots);
+    pool.reserve(bytes);
+}
+
+/**
+ * @brief Removes all the strings from the column.
+*/
+void StringPool::Clear()
+{
+    // Clears the character buffer and the per slot arrays.
+    pool.clear();
+    offsets.clear();
+    lengths.clear();
+    garbage_bytes = 0;
+}
+
+/**
+ * @brief Stores the columns of a book in a slot.
+ *
+ * @param slot The slot of the book.
+ * @param book The book to store.
+*/
+void CatalogueStore::StoreBook(book_handle_t slot, const Book &book)
+{
+    // Grow the bitsets and the genre column so they cover the slot.
+    if(slot >= slot_count)
+    {
+        slot_count = static_cast<size_t>(slot) + 1;
+        live.Resize(slot_count);
+        available.Resize(slot_count);
+        slot_genres.Grow(slot_count);
+    }
+
+    // Append the fields of the book to their string pools.
+    titles.Store(slot, book.GetBookName());
+    authors.Store(slot, book.GetBookAuthor());
+    genres.Store(slot, book.GetBookGener());
+    isbns.Store(slot, book.GetBookNumber());
+
+    // Find (or create) the dense id of the genre of the book.
+    auto inserted = genre_ids.emplace(PostingIndex::NormalizeKey(book.GetBookGener()),
+                                      static_cast<uint32_t>(genre_names.size()));
+    if(inserted.second)
+    {
+        genre_names.push_back(book.GetBookGener());
+        genre_counts.Grow(genre_names.size());
+    }
+    uint32_t genre = inserted.first->second;
+    slot_genres[slot] = genre;
+
+    // Mark the slot as occupied and count the book in its genre.
+    live.Assign(slot, true);
+    genre_counts[genre].total++;
+
+    // Record the availability of the book, the genre counters follow.
+    available.Assign(slot, false);
+    SetAvailability(slot, book.GetBookAvailability());
+}
+
+/**
+ * @brief Erases the book of a slot.
+ *
+ * @param slot The slot of the book.
+*/
+void CatalogueStore::EraseBook(book_handle_t slot)
+{
+    if(!IsLive(slot))
+    {
+        // The slot holds no book.
+        return;
+    }
+
+    // Release the fields of the book.
+    titles.Erase(slot);
+    authors.Erase(slot);
+    genres.Erase(slot);
+    isbns.Erase(slot);
+
+    // Clear the availability bit first so the genre counters drop the book.
+    SetAvailability(slot, false);
+    genre_counts[slot_genres[slot]].total--;
+
+    // Clear the occupied bit of the slot.
+    live.Assign(slot, false);
+
+    // Reclaim the pools once they are mostly garbage.
+    CompactIfNeeded();
+}
+
+/**
+ * @brief Updates the availability bit of a book.
+ *
+ * The counters of the genre of the book are adjusted in O(1) when the bit changes.
+ *
+ * @param slot The slot of the book.
+ * @param is_available true if the book is available, false if it is borrowed.
+*/
+void CatalogueStore::SetAvailability(book_handle_t slot, bool is_available)
+{
+    // Update the bit and get its previous value.
+    bool was_available = available.Assign(slot, is_available);
+
+    // Adjust the genre counters only when the availability really changes, atomically since
+    // borrows and returns of books of the same genre may run in parallel.
+    if(was_available != is_available)
+    {
+        inventory_stats_t &counts = genre_counts[slot_genres[slot]];
+        if(is_available)
+        {
+            __atomic_fetch_add(&counts.available, 1, __ATOMIC_RELAXED);
+        }
+        else
+        {
+            __atomic_fetch_sub(&counts.available, 1, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+/**
+ * @brief Counts the books of the store with a popcount over the live bitset.
+ *
+ * @return The number of books stored.
+*/
+size_t CatalogueStore::CountBooks() const
+{
+    // Count the set bits of the live bitset.
+    return live.Count();
+}
+
+/**
+ * @brief Counts the available books with a popcount over the availability bitset.
+ *
+ * @return The number of books that can be borrowed.
+*/
+size_t CatalogueStore::CountAvailable() const
+{
+    // Count the set bits of the availability bitset.
+    return available.Count();
+}
+
+/**
+ * @brief Gets the inventory counters of a genre in O(1).
+ *
+ * @param genre The genre, compared case insensitively.
+ * @return The number of books and available books of the genre.
+*/
+inventory_stats_t CatalogueStore::GetGenreInventory(const string &genre) const
+{
+    // Look up the dense id of the genre.
+    auto found = genre_ids.find(PostingIndex::NormalizeKey(genre));
+
+    if(found == genre_ids.end())
+    {
+        // No book ever had this genre.
+        return inventory_stats_t{0, 0};
+    }
+
+    // Read the counters, the available one may be updated concurrently by a borrow or return.
+    const inventory_stats_t &counts = genre_counts[found->second];
+    return inventory_stats_t{counts.total, __atomic_load_n(&counts.available, __ATOMIC_RELAXED)};
+}
+
+/**
+ * @brief Gets the inventory counters of every genre holding at least one book.
+ *
+ * @return Pairs of genre name and counters, in order of first appearance of the genre.
+*/
+vector<pair<string, inventory_stats_t>> CatalogueStore::GetInventoryByGenre() const
+{
+    vector<pair<string, inventory_stats_t>> result;
+
+    // Report every genre still holding books.
+    for(size_t genre = 0; genre < genre_names.size(); genre++)
+    {
+        const inventory_stats_t &counts = genre_counts[genre];
+        if(counts.total != 0)
+        {
+            result.emplace_back(genre_names[genre],
+                                inventory_stats_t{counts.total, __atomic_load_n(&counts.available, __ATOMIC_RELAXED)});
+        }
+    }
+
+    return result;
+}
+
+/**
+ * @brief Reserves room for a number of books.
+ *
+ * @param slots The number of book slots.
+ * @param average_bytes The expected length of one field, used to size the pools.
+*/
+void CatalogueStore::Reserve(size_t slots, size_t average_bytes)
+{
+    // Reserve the string pools of every column.
+    titles.Reserve(slots, slots * average_bytes);
+    authors.Reserve(slots, slots * average_bytes);
+    genres.Reserve(slots, slots * average_bytes);
+    isbns.Reserve(slots, slots * average_bytes);
+
+    // Reserve the bitsets and the genre column.
+    live.Reserve(slots);
+    available.Reserve(slots);
+    slot_genres.Grow(slots);
+}
+
+/**
+ * @brief Removes all the books from the store.
+*/
+void CatalogueStore::Clear()
+{
+    // Clears every column and bitset of the store.
+    titles.Clear();
+    authors.Clear();
+    genres.Clear();
+    isbns.Clear();
+    live.Clear();
+    available.Clear();
+    genre_ids.clear();
+    genre_names.clear();
+    genre_counts.Clear();
+    slot_genres.Clear();
+    slot_count = 0;
+}
+
+/**
+ * @brief Exchanges the books of two stores, nobody may access either of them meanwhile.
+ *
+ * @param other The store to exchange the books with.
+*/
+void CatalogueStore::Swap(CatalogueStore &other)
+{
+    // Exchanges every column, bitset and genre table of the stores.
+    swap(titles, other.titles);
+    swap(authors, other.authors);
+    swap(genres, other.genres);
+    swap(isbns, other.isbns);
+    live.Swap(other.live);
+    available.Swap(other.available);
+    genre_ids.swap(other.genre_ids);
+    genre_names.swap(other.genre_names);
+    genre_counts.Swap(other.genre_counts);
+    slot_genres.Swap(other.slot_genres);
+    swap(slot_count, other.slot_count);
+}
+
+/**
+ * @brief Compacts the string pools once their garbage outweighs their live strings.
+*/
+void CatalogueStore::CompactIfNeeded()
+{
+    // Rewrite a pool only when more than half of it is garbage, so the cost is amortized.
+    for(StringPool *column : {&titles, &authors, &genres, &isbns})
+    {
+        if(column->GarbageBytes() > 4096 && column->GarbageBytes() * 2 > column->PoolBytes())
+        {
+            column->Compact();
+        }
+    }
+}
@@ -0,0 +1,322 @@
+#include <string_view>
+#include <memory>
+#include <charconv>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+#include <unistd.h>
+#include "export_format.hpp"
+
+using namespace std;
+
+/**
+ * @brief Constructs a buffer in front of a file descriptor.
+ *
+ * @param file The descriptor of the output, left open by the buffer.
+ * @param capacity The size of the buffer in bytes.
+*/
+ExportBuffer::ExportBuffer(int file, size_t capacity) : fd(file), buffer(capacity < 64 ? 64 : capacity)
+{
+}
+
+/**
+ * @brief Destructs the buffer, writing the bytes left in it.
+*/
+ExportBuffer::~ExportBuffer()
+{
+    Flush();
+}
+
+/**
+ * @brief Writes the buffered bytes to the output.
+ *
+ * @return true if every write so far succeeded.
+*/
+bool ExportBuffer::Flush()
+{
+    WriteAll(buffer.data(), used);
+    used = 0;
+    return healthy;
+}
+
+/**
+ * @brief Appends bytes that do not fit in the space left in the buffer.
+*/
+void ExportBuffer::AppendSlow(const char *data, size_t size)
+{
+    Flush();
+    if(size > buffer.size())
+    {
+        // A block larger than the whole buffer is written directly.
+        WriteAll(data, size);
+        return;
+    }
+    memcpy(buffer.data(), data, size);
+    used = size;
+}
+
+/**
+ * @brief Writes bytes to the output, retrying the writes interrupted by a signal.
+ *
+ * Any other failure marks the buffer unhealthy, and nothing more is written.
+*/
+void ExportBuffer::WriteAll(const char *data, size_t size)
+{
+    while(healthy && size > 0)
+    {
+        ssize_t written = write(fd, data, size);
+        if(written < 0 && errno == EINTR)
+        {
+            // Interrupted before writing anything, try again.
+            continue;
+        }
+        if(written <= 0)
+        {
+            healthy = false;
+            break;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+}
+
+/**
+ * @brief Appends the decimal digits of an integer to the output.
+*/
+void ExportBuffer::AppendNumber(int64_t value)
+{
+    char digits[24];
+    to_chars_result result = to_chars(digits, digits + sizeof(digits), value);
+    Append(digits, static_cast<size_t>(result.ptr - digits));
+}
+
+/**
+ * @brief The layout of the console: one block of "field: value" lines per record.
+ */
+class TextFormat : public ExportFormat
+{
+    public:
+        void WriteBook(ExportBuffer &out, const book_view_t &book) override
+        {
+            out.Append("==============================================\nbook_ISBN: ");
+            out.Append(book.ISBN);
+            out.Append("\nbook_name: ");
+            out.Append(book.title);
+            out.Append("\nbook_category: ");
+            out.Append(book.genre);
+            out.Append("\nbook_auther: ");
+            out.Append(book.author);
+            out.Append("\nbook_availability: ");
+            out.Append(book.available ? '1' : '0');
+            out.Append("\n==============================================\n");
+        }
+
+        void WriteUser(ExportBuffer &out, const user_view_t &user) override
+        {
+            out.Append("==============================================\nuser_id: ");
+            out.AppendNumber(user.id);
+            out.Append("\nuser_name: ");
+            out.Append(user.name);
+            out.Append("\nuser_loans: ");
+            out.AppendNumber(static_cast<int64_t>(user.loans));
+            out.Append("\n==============================================\n");
+        }
+};
+
+/**
+ * @brief Comma separated values, the books in the column order of the catalogue importer.
+ */
+class CsvFormat : public ExportFormat
+{
+    private:
+        /**
+         * @brief Appends a field, quoted only if it holds a delimiter, a quote or a line break.
+        */
+        static void AppendField(ExportBuffer &out, string_view field)
+        {
+            if(field.find_first_of(",\"\r\n") == string_view::npos)
+            {
+                out.Append(field);
+                return;
+            }
+
+            // Enclose the field in quotes and double the quotes it holds.
+            out.Append('"');
+            for(size_t quote = field.find('"'); quote != string_view::npos; quote = field.find('"'))
+            {
+                out.Append(field.substr(0, quote + 1));
+                out.Append('"');
+                field.remove_prefix(quote + 1);
+            }
+            out.Append(field);
+            out.Append('"');
+        }
+
+    public:
+        void BeginBooks(ExportBuffer &out) override
+        {
+            out.Append("title,author,genre,ISBN,available\n");
+        }
+
+        void WriteBook(ExportBuffer &out, const book_view_t &book) override
+        {
+            AppendField(out, book.title);
+            out.Append(',');
+            AppendField(out, book.author);
+            out.Append(',');
+            AppendField(out, book.genre);
+            out.Append(',');
+            AppendField(out, book.ISBN);
+            out.Append(book.available ? ",1\n" : ",0\n");
+        }
+
+        void BeginUsers(ExportBuffer &out) override
+        {
+            out.Append("id,name,loans\n");
+        }
+
+        void WriteUser(ExportBuffer &out, const user_view_t &user) override
+        {
+            out.AppendNumber(user.id);
+            out.Append(',');
+            AppendField(out, user.name);
+            out.Append(',');
+            out.AppendNumber(static_cast<int64_t>(user.loans));
+            out.Append('\n');
+        }
+};
+
+/**
+ * @brief One JSON object per line.
+ */
+class JsonLinesFormat : public ExportFormat
+{
+    private:
+        /**
+         * @brief Appends a JSON string, escaping the quotes, backslashes and control characters.
+        */
+        static void AppendString(ExportBuffer &out, string_view text)
+        {
+            static const char HEX[] = "0123456789abcdef";
+
+            out.Append('"');
+            size_t plain = 0;
+            for(size_t i = 0; i < text.size(); i++)
+            {
+                unsigned char c = static_cast<unsigned char>(text[i]);
+                if(c >= 0x20 && c != '"' && c != '\\')
+                {
+                    continue;
+                }
+
+                // Copy the run of plain characters, then escape this one.
+                out.Append(text.data() + plain, i - plain);
+                plain = i + 1;
+                if(c == '"' || c == '\\')
+                {
+                    out.Append('\\');
+                    out.Append(static_cast<char>(c));
+                }
+                else
+                {
+                    char escape[6] = {'\\', 'u', '0', '0', HEX[c >> 4], HEX[c & 0xF]};
+                    out.Append(escape, sizeof(escape));
+                }
+            }
+            out.Append(text.data() + plain, text.size() - plain);
+            out.Append('"');
+        }
+
+    public:
+        void WriteBook(ExportBuffer &out, const book_view_t &book) override
+        {
+            out.Append("{\"ISBN\":");
+            AppendString(out, book.ISBN);
+            out.Append(",\"title\":");
+            AppendString(out, book.title);
+            out.Append(",\"author\":");
+            AppendString(out, book.author);
+            out.Append(",\"genre\":");
+            AppendString(out, book.genre);
+            out.Append(book.available ? ",\"available\":true}\n" : ",\"available\":false}\n");
+        }
+
+        void WriteUser(ExportBuffer &out, const user_view_t &user) override
+        {
+            out.Append("{\"id\":");
+            out.AppendNumber(user.id);
+            out.Append(",\"name\":");
+            AppendString(out, user.name);
+            out.Append(",\"loans\":");
+            out.AppendNumber(static_cast<int64_t>(user.loans));
+            out.Append("}\n");
+        }
+};
+
+/**
+ * @brief Length-prefixed fields in host byte order, after an 8 byte magic.
+ *
+ * A book is four (u32 length, bytes) strings (ISBN, title, author, genre) followed by a u8
+ * availability; a user is an i32 ID, a (u32 length, bytes) name and a u32 number of loans.
+ */
+class BinaryFormat : public ExportFormat
+{
+    private:
+        /**
+         * @brief Appends a string prefixed by its length.
+        */
+        static void AppendString(ExportBuffer &out, string_view text)
+        {
+            out.AppendRaw(static_cast<uint32_t>(text.size()));
+            out.Append(text);
+        }
+
+    public:
+        void BeginBooks(ExportBuffer &out) override
+        {
+            out.Append("LMSBOOK1", 8);
+        }
+
+        void WriteBook(ExportBuffer &out, const book_view_t &book) override
+        {
+            AppendString(out, book.ISBN);
+            AppendString(out, book.title);
+            AppendString(out, book.author);
+            AppendString(out, book.genre);
+            out.AppendRaw(static_cast<uint8_t>(book.available));
+        }
+
+        void BeginUsers(ExportBuffer &out) override
+        {
+            out.Append("LMSUSER1", 8);
+        }
+
+        void WriteUser(ExportBuffer &out, const user_view_t &user) override
+        {
+            out.AppendRaw(static_cast<int32_t>(user.id));
+            AppendString(out, user.name);
+            out.AppendRaw(static_cast<uint32_t>(user.loans));
+        }
+};
+
+/**
+ * @brief Creates a built-in format.
+ *
+ * @param format The format to create.
+ * @return unique_ptr<ExportFormat> The format.
+*/
+unique_ptr<ExportFormat> ExportFormat::Create(export_format_t format)
+{
+    switch(format)
+    {
+        case EXPORT_CSV:
+            return unique_ptr<ExportFormat>(new CsvFormat());
+        case EXPORT_JSONL:
+            return unique_ptr<ExportFormat>(new JsonLinesFormat());
+        case EXPORT_BINARY:
+            return unique_ptr<ExportFormat>(new BinaryFormat());
+        case EXPORT_TEXT:
+        default:
+            return unique_ptr<ExportFormat>(new TextFormat());
+    }
+}
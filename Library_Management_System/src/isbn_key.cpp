@@ -0,0 +1,192 @@
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cctype>
+#include "isbn_key.hpp"
+
+using namespace std;
+
+/**
+ * @brief Packs a local serial byte for byte under the tag bit.
+ *
+ * @param text The serial, 1 to MAX_LOCAL_SERIAL printable characters.
+ * @param tag The tag bit of the first word.
+ * @param value Receives the first word: the tag and the first 7 characters, the first one in the highest byte.
+ * @param extra Receives the second word: the characters 8 to 15, the eighth one in the highest byte.
+*/
+static void PackLocalSerial(string_view text, uint64_t tag, uint64_t &value, uint64_t &extra)
+{
+    value = tag;
+    extra = 0;
+    for(size_t i = 0; i < text.size(); i++)
+    {
+        uint64_t byte = static_cast<uint64_t>(static_cast<unsigned char>(text[i]));
+        if(i < 7)
+        {
+            value |= byte << (48 - 8 * i);
+        }
+        else
+        {
+            extra |= byte << (56 - 8 * (i - 7));
+        }
+    }
+}
+
+/**
+ * @brief Parses and normalizes a serial number into a key.
+ *
+ * The parsing works on a fixed stack buffer and never allocates.
+ *
+ * @param text The ISBN-10 or ISBN-13 (hyphens and blanks allowed) or the local serial.
+ * @return The normalized key, invalid if the text is not a valid serial.
+*/
+IsbnKey IsbnKey::FromString(string_view text)
+{
+    // The characters of the serial once the hyphens and blanks are stripped.
+    char chars[13];
+    size_t length = 0;
+    // Whether every kept character is a digit.
+    bool all_digits = true;
+    // Whether the stripped text still fits an ISBN.
+    bool isbn_shaped = true;
+
+    for(char ch : text)
+    {
+        unsigned char c = static_cast<unsigned char>(ch);
+
+        if(ch == '-' || isspace(c))
+        {
+            // Separators carry no information in an ISBN.
+            continue;
+        }
+
+        if(length == sizeof(chars))
+        {
+            // Too long for an ISBN, maybe a local serial.
+            isbn_shaped = false;
+            break;
+        }
+
+        all_digits = all_digits && isdigit(c);
+        chars[length++] = ch;
+    }
+
+    if(isbn_shaped && length == 13 && all_digits)
+    {
+        // ISBN-13: the digits are weighted 1, 3, 1, 3, ... and must sum to a multiple of 10.
+        uint64_t number = 0;
+        unsigned sum = 0;
+        for(size_t i = 0; i < 13; i++)
+        {
+            unsigned digit = static_cast<unsigned>(chars[i] - '0');
+            sum += (i % 2 == 0) ? digit : 3 * digit;
+            number = number * 10 + digit;
+        }
+        if(sum % 10 != 0)
+        {
+            // Thirteen digits failing the checksum are a mistyped ISBN, not a local serial.
+            return IsbnKey();
+        }
+        return IsbnKey(number, 0);
+    }
+
+    if(isbn_shaped && length == 10)
+    {
+        // ISBN-10: nine digits and a check character (digit or X) weighted 10 down to 1,
+        // whose sum must be a multiple of 11.
+        unsigned sum = 0;
+        bool digits = true;
+        for(size_t i = 0; i < 10 && digits; i++)
+        {
+            unsigned digit = 0;
+            if(isdigit(static_cast<unsigned char>(chars[i])))
+            {
+                digit = static_cast<unsigned>(chars[i] - '0');
+            }
+            else if(i == 9 && (chars[i] == 'X' || chars[i] == 'x'))
+            {
+                digit = 10;
+            }
+            else
+            {
+                // A ten character serial that is not an ISBN-10.
+                digits = false;
+            }
+            sum += static_cast<unsigned>(10 - i) * digit;
+        }
+
+        if(digits && sum % 11 != 0)
+        {
+            // An ISBN-10 failing the checksum is a mistyped ISBN, not a local serial.
+            return IsbnKey();
+        }
+        if(digits)
+        {
+            // Convert to ISBN-13: prefix 978, keep the nine digits, recompute the check digit.
+            uint64_t number = 978;
+            unsigned sum13 = 9 + 3 * 7 + 8;
+            for(size_t i = 0; i < 9; i++)
+            {
+                unsigned digit = static_cast<unsigned>(chars[i] - '0');
+                sum13 += ((i + 3) % 2 == 0) ? digit : 3 * digit;
+                number = number * 10 + digit;
+            }
+            return IsbnKey(number * 10 + (10 - sum13 % 10) % 10, 0);
+        }
+    }
+
+    // Not an ISBN: a local serial, kept byte for byte so that separators still tell serials apart.
+    if(text.empty() || text.size() > MAX_LOCAL_SERIAL)
+    {
+        return IsbnKey();
+    }
+    for(char ch : text)
+    {
+        if(!isprint(static_cast<unsigned char>(ch)))
+        {
+            return IsbnKey();
+        }
+    }
+
+    uint64_t packed, packed_extra;
+    PackLocalSerial(text, LOCAL_SERIAL_TAG, packed, packed_extra);
+    return IsbnKey(packed, packed_extra);
+}
+
+/**
+ * @brief Formats the key back to its normalized text.
+ *
+ * @return The 13 digits of an ISBN, the characters of a local serial, or "" if invalid.
+*/
+string IsbnKey::ToString() const
+{
+    string text;
+
+    if(IsIsbn())
+    {
+        // Write the 13 digits, most significant first.
+        text.assign(13, '0');
+        uint64_t number = value;
+        for(size_t i = 13; i-- > 0;)
+        {
+            text[i] = static_cast<char>('0' + number % 10);
+            number /= 10;
+        }
+    }
+    else if(IsValid())
+    {
+        // Unpack the characters of the local serial until the first empty byte.
+        for(size_t i = 0; i < MAX_LOCAL_SERIAL; i++)
+        {
+            uint64_t word = (i < 7) ? value >> (48 - 8 * i) : extra >> (56 - 8 * (i - 7));
+            char c = static_cast<char>(word & 0xff);
+            if(c == '\0')
+            {
+                break;
+            }
+            text.push_back(c);
+        }
+    }
+
+    return text;
+}
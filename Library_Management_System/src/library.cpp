@@ -1,11 +1,148 @@
-#include <iostream>
 #include <unordered_map>
 #include <algorithm>
 #include <memory>
 #include <string>
+#include <vector>
+#include <mutex>
+#include <shared_mutex>
+#include <utility>
 #include "library.hpp"
+#include "isbn_key.hpp"
 #include "book.hpp"
 #include "user.hpp"
+#include "operation_stats.hpp"
+
+#if defined(LIBRARY_STATS)
+
+/**
+ * @brief Classifies the result of adding a book or registering a user for the statistics.
+*/
+static stat_outcome_t OutcomeOf(add_handling_t result)
+{
+    switch(result)
+    {
+        case ADDED_SUCCESSFULLY:
+            return STAT_HIT;
+        case ADDED_NOT_DURABLE:
+            return STAT_FAILED;
+        default:
+            return STAT_REJECTED;
+    }
+}
+
+/**
+ * @brief Classifies the result of removing a book or a user for the statistics.
+*/
+static stat_outcome_t OutcomeOf(remove_handling_t result)
+{
+    switch(result)
+    {
+        case REMOVED:
+            return STAT_HIT;
+        case NOT_EXCIST:
+            return STAT_MISS;
+        case REMOVED_NOT_DURABLE:
+            return STAT_FAILED;
+        default:
+            return STAT_REJECTED;
+    }
+}
+
+/**
+ * @brief Classifies the result of a loan or a return for the statistics.
+*/
+static stat_outcome_t OutcomeOf(loan_status_t result)
+{
+    switch(result)
+    {
+        case LOAN_SUCCEEDED:
+            return STAT_HIT;
+        case LOAN_UNKNOWN_USER:
+        case LOAN_UNKNOWN_BOOK:
+            return STAT_MISS;
+        case LOAN_NOT_DURABLE:
+            return STAT_FAILED;
+        default:
+            return STAT_REJECTED;
+    }
+}
+
+/**
+ * @brief Classifies the result of a search for one book for the statistics.
+*/
+static stat_outcome_t OutcomeOf(const shared_ptr<Book> &result)
+{
+    return (result != nullptr) ? STAT_HIT : STAT_MISS;
+}
+
+/**
+ * @brief Classifies the result of a search for the statistics.
+*/
+static stat_outcome_t OutcomeOf(const vector<shared_ptr<Book>> &result)
+{
+    return result.empty() ? STAT_MISS : STAT_HIT;
+}
+
+/**
+ * @brief Classifies a page of a listing for the statistics.
+*/
+static stat_outcome_t OutcomeOf(const BookPage &result)
+{
+    return result.books.empty() ? STAT_MISS : STAT_HIT;
+}
+
+#endif
+
+#if defined(LIBRARY_STATS)
+
+/**
+ * @brief Records a batch: its latency as one call and its requests by outcome.
+ *
+ * @param stats The statistics of the library.
+ * @param operation The operation the batch is counted as.
+ * @param counts The number of requests of the batch with every outcome.
+ * @param nanoseconds The latency of the batch.
+*/
+static void RecordBatchCounts(OperationStats &stats, stat_operation_t operation, const uint64_t (&counts)[STAT_OUTCOME_COUNT], uint64_t nanoseconds)
+{
+    // Add each count once, then the latency of the whole batch
+    for(int outcome = 0; outcome < STAT_OUTCOME_COUNT; outcome++)
+    {
+        if(counts[outcome] != 0)
+        {
+            stats.Count(operation, static_cast<stat_outcome_t>(outcome), counts[outcome]);
+        }
+    }
+    stats.RecordLatency(operation, nanoseconds);
+}
+
+#endif
+
+/**
+ * @brief Records a batch of loans or returns: its latency and its requests by outcome.
+ *
+ * @param stats The statistics of the library.
+ * @param operation STAT_BORROW_BATCH or STAT_RETURN_BATCH.
+ * @param results The results of the requests of the batch.
+ * @param nanoseconds The latency of the batch.
+*/
+static void RecordBatch(OperationStats &stats, stat_operation_t operation, const vector<loan_status_t> &results, uint64_t nanoseconds)
+{
+#if defined(LIBRARY_STATS)
+    // Count the outcomes first, then add each count once
+    uint64_t counts[STAT_OUTCOME_COUNT] = {};
+    for(loan_status_t result : results)
+    {
+        counts[OutcomeOf(result)]++;
+    }
+    RecordBatchCounts(stats, operation, counts, nanoseconds);
+#else
+    (void)stats;
+    (void)operation;
+    (void)results;
+    (void)nanoseconds;
+#endif
+}
 
 
 /**
@@ -14,27 +151,106 @@
  * Initializes an empty library.
 */
 Library::Library()
+    : title_order(catalogue, ORDER_BY_TITLE), isbn_order(catalogue, ORDER_BY_ISBN), fuzzy_index(title_index.GetTerms()), author_index(true)
 {
-
+    // The author index keeps its names ordered to answer the author prefix queries,
+    // the fuzzy index finds the books of the title terms in the title index.
 }
 
 /**
  * @brief Destructs a Library object.
  * 
- * Cleans up resources and destroys the library.
+ * Cleans up resources and destroys the library. The slabs of the emplaced books and users
+ * are released in one shot once every object is destroyed, which is later if a caller still
+ * holds a book.
 */
 Library::~Library()
 {   
-    // Clears the unordered_map containing books
-    users.clear();
-    // Clears the unordered_map containing users
-    books.clear();
+    // Releases every user and book before the arena they live in
+    ClearContents();
+}
+
+/**
+ * @brief Removes every user, book and index entry from the library.
+ * 
+ * The caller holds every lock of the library, or is its destructor.
+*/
+void Library::ClearContents()
+{
+    // Clears the shards of the users and books tables
+    for(size_t i = 0; i < SHARD_COUNT; i++)
+    {
+        user_shards[i].users.clear();
+        book_shards[i].books.clear();
+    }
+    // Clears the slots and the title index referring to the books
+    book_slots.clear();
+    free_book_slots.clear();
+    title_order.Clear();
+    isbn_order.Clear();
+    catalogue.Clear();
+    title_index.Clear();
+    fuzzy_index.Clear();
+    author_index.Clear();
+    genre_index.Clear();
+}
+
+/**
+ * @brief Exchanges every user, book and index entry with another library.
+ * 
+ * The caller holds every lock of both libraries, or owns the other one alone.
+ * 
+ * @param other The library to exchange the contents with.
+*/
+void Library::SwapContents(Library &other)
+{
+    // Exchanges the shards of the users and books tables
+    for(size_t i = 0; i < SHARD_COUNT; i++)
+    {
+        user_shards[i].users.swap(other.user_shards[i].users);
+        book_shards[i].books.swap(other.book_shards[i].books);
+    }
+    // Exchanges the slots, then the catalogue before the ordered indexes reading it
+    book_slots.swap(other.book_slots);
+    free_book_slots.swap(other.free_book_slots);
+    catalogue.Swap(other.catalogue);
+    title_order.Swap(other.title_order);
+    isbn_order.Swap(other.isbn_order);
+    swap(title_index.GetTerms(), other.title_index.GetTerms());
+    fuzzy_index.Swap(other.fuzzy_index);
+    swap(author_index, other.author_index);
+    swap(genre_index, other.genre_index);
+}
+
+/**
+ * @brief Gets the shard of the books table holding an ISBN key.
+ * 
+ * @param key The key of the book.
+ * @return BookShard& The shard owning the key.
+*/
+Library::BookShard &Library::ShardOf(IsbnKey key)
+{
+    // The low bits of the mixed key are uniform, SHARD_COUNT is a power of two
+    return book_shards[IsbnKeyHash()(key) & (SHARD_COUNT - 1)];
+}
+
+/**
+ * @brief Gets the shard of the users table holding a user ID.
+ * 
+ * @param id The ID of the user.
+ * @return UserShard& The shard owning the ID.
+*/
+Library::UserShard &Library::ShardOf(int id)
+{
+    // Fibonacci hashing spreads consecutive IDs over the shards, the top 6 bits pick one of the 64
+    return user_shards[(static_cast<uint32_t>(id) * 0x9E3779B1u) >> 26];
 }
 
 /**
  * @brief Adds a new book to the library.
  * 
- * This method attempts to add a book to the library's collection. If the book is already
+ * This method attempts to add a book to the library's collection. If the serial number of the
+ * book is neither a valid ISBN nor a local serial, it returns INVALID_ISBN. If the book is already
  * present in the library, it returns ALREADY_TAKEN. If the book is added successfully,
  * it returns ADDED_SUCCESSFULLY.
  * 
@@ -43,46 +259,358 @@ Library::~Library()
 */
 add_handling_t Library::AddNewBookToLibrary(Book *book)
 {
-    // Check if the book with the same ISBN is already in the library
-    if(books.count(book->GetBookNumber()))
+    // Time the call for the statistics of the library
+    OperationTimer timer(stats, STAT_ADD_BOOK);
+
+    // Normalize the serial number of the book into its binary key
+    IsbnKey key = IsbnKey::FromString(book->GetBookNumber());
+    if(!key.IsValid())
+    {
+        // The serial number can't be used as a key, return INVALID_ISBN
+        return timer.Finish(INVALID_ISBN);
+    }
+
+    // Lock the catalogue exclusively, then the shard of the key
+    unique_lock<shared_mutex> catalogue_guard(catalogue_lock);
+    BookShard &shard = ShardOf(key);
+    unique_lock<shared_mutex> shard_guard(shard.lock);
+
+    // Try to insert the key, a single hash lookup tells whether it is already taken
+    auto inserted = shard.books.emplace(key, nullptr);
+    if(!inserted.second)
     {
         // ISBN already exists in the library, return ALREADY_TAKEN
-        return ALREADY_TAKEN;
+        return timer.Finish(ALREADY_TAKEN);
     }
     else
     {   
-        // Insert the new book into the library's collection
-        books[book->GetBookNumber()] = shared_ptr<Book>(book);
+        // Insert the new book into the library's collection and index it
+        inserted.first->second = shared_ptr<Book>(book);
+        IndexNewBook(inserted.first->second);
+
+        // Log the book under the locks, then wait for the record once they are released
+        uint64_t sequence = (log != nullptr) ? log->LogAddBook(book->GetBookName(), book->GetBookAuthor(), book->GetBookGener(), book->GetBookNumber()) : 0;
+        shard_guard.unlock();
+        catalogue_guard.unlock();
+        if(log != nullptr && !log->Commit(sequence))
+        {
+            // The book is added but its record could not be made durable, return ADDED_NOT_DURABLE
+            return timer.Finish(ADDED_NOT_DURABLE);
+        }
 
         // Book added successfully, return ADDED_SUCCESSFULLY
-        return ADDED_SUCCESSFULLY;
+        return timer.Finish(ADDED_SUCCESSFULLY);
     }   
 }
 
+/**
+ * @brief Constructs a new book in place and adds it to the library.
+ * 
+ * The book and its shared_ptr control block are allocated together from the slab allocator
+ * of the library, and nothing is allocated if the ISBN is invalid or already taken.
+ * The memory is released with the library, or with the last shared_ptr held past it.
+ * 
+ * @param title The title of the book.
+ * @param author The author of the book.
+ * @param gener The genre of the book.
+ * @param ISBN The ISBN number of the book.
+ * @return add_handling_t Enumeration value indicating the result of the operation.
+*/
+add_handling_t Library::EmplaceBook(const string &title, const string &author, const string &gener, const string &ISBN)
+{
+    // Time the call for the statistics of the library
+    OperationTimer timer(stats, STAT_ADD_BOOK);
+
+    // Normalize the serial number of the book into its binary key
+    IsbnKey key = IsbnKey::FromString(ISBN);
+    if(!key.IsValid())
+    {
+        // The serial number can't be used as a key, return INVALID_ISBN
+        return timer.Finish(INVALID_ISBN);
+    }
+
+    // Lock the catalogue exclusively, then the shard of the key
+    unique_lock<shared_mutex> catalogue_guard(catalogue_lock);
+    BookShard &shard = ShardOf(key);
+    unique_lock<shared_mutex> shard_guard(shard.lock);
+
+    // Try to insert the key, a single hash lookup tells whether it is already taken
+    auto inserted = shard.books.emplace(key, nullptr);
+    if(!inserted.second)
+    {
+        // ISBN already exists in the library, return ALREADY_TAKEN
+        return timer.Finish(ALREADY_TAKEN);
+    }
+
+    // Construct the book and its control block in one arena block, then index it
+    inserted.first->second = allocate_shared<Book>(ArenaAllocator<Book>(arena), title, author, gener, ISBN);
+    IndexNewBook(inserted.first->second);
+
+    // Log the book under the locks, then wait for the record once they are released
+    uint64_t sequence = (log != nullptr) ? log->LogAddBook(title, author, gener, ISBN) : 0;
+    shard_guard.unlock();
+    catalogue_guard.unlock();
+    if(log != nullptr && !log->Commit(sequence))
+    {
+        // The book is added but its record could not be made durable, return ADDED_NOT_DURABLE
+        return timer.Finish(ADDED_NOT_DURABLE);
+    }
+
+    // Book added successfully, return ADDED_SUCCESSFULLY
+    return timer.Finish(ADDED_SUCCESSFULLY);
+}
+
+/**
+ * @brief Adds a batch of books to the library in one pass.
+ * 
+ * The tables, slots and catalogue are reserved for the whole batch up front and every
+ * lock is taken once, so importing millions of records never rehashes per record.
+ * Records whose serial number is invalid or already taken are skipped.
+ * 
+ * @param records The books to add, their strings are moved into the library.
+ * @param durable Receives false if the books were added but the write-ahead log could not make
+ * them durable, may be null.
+ * @return size_t The number of books added.
+*/
+size_t Library::ImportBooks(vector<BookRecord> &records, bool *durable)
+{
+    // Time the whole import, its records are counted as additions by outcome
+    OperationTimer timer(stats, STAT_ADD_BOOK);
+
+    // Lock the catalogue exclusively, then every book shard in order
+    unique_lock<shared_mutex> catalogue_guard(catalogue_lock);
+    vector<unique_lock<shared_mutex>> shard_guards;
+    shard_guards.reserve(SHARD_COUNT);
+    for(size_t i = 0; i < SHARD_COUNT; i++)
+    {
+        shard_guards.emplace_back(book_shards[i].lock);
+    }
+
+    // Reserve every table for the whole batch, the keys spread evenly over the shards
+    size_t expected = catalogue.CountBooks() + records.size();
+    for(size_t i = 0; i < SHARD_COUNT; i++)
+    {
+        book_shards[i].books.reserve(book_shards[i].books.size() + records.size() / SHARD_COUNT + records.size() / (4 * SHARD_COUNT) + 16);
+    }
+    book_slots.reserve(expected);
+    catalogue.Reserve(expected);
+
+    // The number of books added and skipped, the slots they were given and the sequence number of the last one logged
+    size_t imported = 0;
+    size_t invalid = 0;
+    size_t taken = 0;
+    vector<book_handle_t> new_slots;
+    new_slots.reserve(records.size());
+    uint64_t sequence = 0;
+
+    for(BookRecord &record : records)
+    {
+        // Skip the serial numbers that can't be used as a key
+        IsbnKey key = IsbnKey::FromString(record.ISBN);
+        if(!key.IsValid())
+        {
+            invalid++;
+            continue;
+        }
+
+        // Skip the serial numbers already taken
+        auto inserted = ShardOf(key).books.emplace(key, nullptr);
+        if(!inserted.second)
+        {
+            taken++;
+            continue;
+        }
+
+        // Construct the book from the moved fields in an arena block, then index it
+        inserted.first->second = allocate_shared<Book>(ArenaAllocator<Book>(arena), std::move(record.title),
+                                                       std::move(record.author), std::move(record.gener), std::move(record.ISBN));
+        IndexNewBook(inserted.first->second, false);
+        new_slots.push_back(inserted.first->second->GetBookSlot());
+        imported++;
+
+        // Log the book, the whole batch is committed at once
+        if(log != nullptr)
+        {
+            const shared_ptr<Book> &book = inserted.first->second;
+            sequence = log->LogAddBook(book->GetBookName(), book->GetBookAuthor(), book->GetBookGener(), book->GetBookNumber());
+        }
+    }
+
+    // Sort the whole batch into the ordered indexes at once
+    title_order.InsertBatch(new_slots);
+    isbn_order.InsertBatch(new_slots);
+
+    // Release the locks, then wait for the last record, which makes every record before it durable
+    shard_guards.clear();
+    catalogue_guard.unlock();
+    bool committed = (log == nullptr || sequence == 0 || log->Commit(sequence));
+    if(durable != nullptr)
+    {
+        *durable = committed;
+    }
+
+#if defined(LIBRARY_STATS)
+    // Record the import as one call, each record counted with the outcome of a single addition
+    uint64_t counts[STAT_OUTCOME_COUNT] = {};
+    counts[OutcomeOf(committed ? ADDED_SUCCESSFULLY : ADDED_NOT_DURABLE)] += imported;
+    counts[OutcomeOf(INVALID_ISBN)] += invalid;
+    counts[OutcomeOf(ALREADY_TAKEN)] += taken;
+    RecordBatchCounts(stats, STAT_ADD_BOOK, counts, timer.Elapsed());
+#else
+    (void)invalid;
+    (void)taken;
+#endif
+
+    return imported;
+}
+
+/**
+ * @brief Gives a slot to a book just inserted in the books table and indexes it.
+ * 
+ * @param book The book stored in the books table.
+ * @param ordered false if the caller adds the slot to the ordered indexes with its whole batch.
+*/
+void Library::IndexNewBook(const shared_ptr<Book> &book, bool ordered)
+{
+    // Assign the book a slot, reusing the one of a removed book if any
+    book_handle_t slot;
+    if(!free_book_slots.empty())
+    {
+        slot = free_book_slots.back();
+        free_book_slots.pop_back();
+        book_slots[slot] = book;
+    }
+    else
+    {
+        slot = static_cast<book_handle_t>(book_slots.size());
+        book_slots.push_back(book);
+    }
+    book->SetBookSlot(slot);
+
+    // Copy the fields of the book into the columnar catalogue
+    catalogue.StoreBook(slot, *book);
+
+    // Sort the book for the listings, reading its fields from the catalogue
+    if(ordered)
+    {
+        title_order.Insert(slot);
+        isbn_order.Insert(slot);
+    }
+
+    // Index the title, the author and the genre of the book for the searches
+    title_index.AddTitle(slot, book->GetBookName());
+    fuzzy_index.AddBook(slot, book->GetBookName(), book->GetBookAuthor());
+    author_index.AddPosting(PostingIndex::NormalizeKey(book->GetBookAuthor()), slot);
+    genre_index.AddPosting(PostingIndex::NormalizeKey(book->GetBookGener()), slot);
+}
+
 /**
  * @brief Removes a book from the library using its ISBN.
  * 
  * This method attempts to remove a book from the library's collection based on its ISBN.
  * If the book does not exist, it returns NOT_EXCIST. If the book exists but could not be removed,
- * it returns EXCIT. If the book is successfully removed, it returns REMOVED.
+ * it returns EXCIT. If the book is successfully removed, it returns REMOVED. A book on loan
+ * is first taken back from its borrower, found through the loan word of the book.
  * 
  * @param ISBN The ISBN of the book to be removed.
  * @return remove_handling_t Enumeration value indicating the result of the operation.
 */
 remove_handling_t Library::RemoveBookFromLibrary(const string &ISBN)
 {
+    // Time the call for the statistics of the library
+    OperationTimer timer(stats, STAT_REMOVE_BOOK);
+
+    // Lock the catalogue exclusively, no other book is added or removed until the book is gone
+    IsbnKey key = IsbnKey::FromString(ISBN);
+    unique_lock<shared_mutex> catalogue_guard(catalogue_lock);
+    BookShard &shard = ShardOf(key);
+
+    // Lock the shard of the borrower, then the shard of the book. Loans go on without the catalogue
+    // lock, so the borrower peeked at may have changed before the shard of the book is locked: it is
+    // read again under both locks, and the locks are taken again if it changed
+    int borrower_id = 0;
+    bool on_loan = false;
+    unique_lock<shared_mutex> user_guard;
+    unique_lock<shared_mutex> shard_guard;
+    while(true)
+    {
+        {
+            shared_lock<shared_mutex> peek_guard(shard.lock);
+            auto found = shard.books.find(key);
+            on_loan = (found != shard.books.end()) && found->second->GetBookBorrower(borrower_id);
+        }
+        if(on_loan)
+        {
+            user_guard = unique_lock<shared_mutex>(ShardOf(borrower_id).lock);
+        }
+        shard_guard = unique_lock<shared_mutex>(shard.lock);
+
+        // No loan or return of the book can happen while its shard is locked exclusively
+        int holder = 0;
+        auto found = shard.books.find(key);
+        bool held = (found != shard.books.end()) && found->second->GetBookBorrower(holder);
+        if(held == on_loan && (!held || holder == borrower_id))
+        {
+            break;
+        }
+        shard_guard.unlock();
+        if(user_guard.owns_lock())
+        {
+            user_guard.unlock();
+        }
+    }
+
     // Check if the book with the specified ISBN exists in the library
-    if(books.count(ISBN))
+    auto found = shard.books.find(key);
+    if(found != shard.books.end())
     {
+        // Take the book back from its borrower so no loan refers to it anymore
+        if(on_loan)
+        {
+            UserShard &user_shard = ShardOf(borrower_id);
+            auto user_it = user_shard.users.find(borrower_id);
+            if(user_it != user_shard.users.end())
+            {
+                user_it->second->UserReturnBook(found->second);
+            }
+        }
+
+        // Drop the book from the search indexes and release its slot
+        book_handle_t slot = found->second->GetBookSlot();
+        title_order.Erase(slot);
+        isbn_order.Erase(slot);
+        title_index.RemoveTitle(slot, found->second->GetBookName());
+        fuzzy_index.RemoveBook(slot, found->second->GetBookName(), found->second->GetBookAuthor());
+        author_index.RemovePosting(PostingIndex::NormalizeKey(found->second->GetBookAuthor()), slot);
+        genre_index.RemovePosting(PostingIndex::NormalizeKey(found->second->GetBookGener()), slot);
+        book_slots[slot].reset();
+        free_book_slots.push_back(slot);
+        catalogue.EraseBook(slot);
+
         // Remove the book from the library's collection
-        books.erase(ISBN);
+        shard.books.erase(found);
+
+        // Log the removal under the locks, then wait for the record once they are released
+        uint64_t sequence = (log != nullptr) ? log->LogRemoveBook(ISBN) : 0;
+        shard_guard.unlock();
+        if(user_guard.owns_lock())
+        {
+            user_guard.unlock();
+        }
+        catalogue_guard.unlock();
+        if(log != nullptr && !log->Commit(sequence))
+        {
+            // The book is removed but its record could not be made durable, return REMOVED_NOT_DURABLE
+            return timer.Finish(REMOVED_NOT_DURABLE);
+        }
+
         // Book removed successfully, return REMOVED
-        return REMOVED;       
+        return timer.Finish(REMOVED);
     }
     else
     {
         // Book with the specified ISBN does not exist, return NOT_EXCIST
-        return NOT_EXCIST;        
+        return timer.Finish(NOT_EXCIST);        
     }
 }
 
@@ -98,19 +626,85 @@ remove_handling_t Library::RemoveBookFromLibrary(const string &ISBN)
 */
 add_handling_t Library::RegisterNewUser(User *new_user)
 {
-    // Check if the user with the same ID is already registered
-    if(users.count(new_user->GetUserId()))
+    // Time the call for the statistics of the library
+    OperationTimer timer(stats, STAT_REGISTER_USER);
+
+    // Lock the shard of the user ID
+    UserShard &shard = ShardOf(new_user->GetUserId());
+    unique_lock<shared_mutex> shard_guard(shard.lock);
+
+    // Try to insert the user ID, a single hash lookup tells whether it is already registered
+    auto inserted = shard.users.emplace(new_user->GetUserId(), nullptr);
+    if(!inserted.second)
     {
         // User ID already exists in the library, return ALREADY_TAKEN
-        return ALREADY_TAKEN;
+        return timer.Finish(ALREADY_TAKEN);
     }
     else
     {
         // Register the new user in the library's records
-        users[new_user->GetUserId()] = unique_ptr<User> (new_user);
+        inserted.first->second = unique_ptr<User, ArenaDeleter<User>> (new_user);
+
+        // Log the user under the lock, then wait for the record once it is released
+        uint64_t sequence = (log != nullptr) ? log->LogRegisterUser(new_user->GetUserId(), new_user->GetUserName()) : 0;
+        shard_guard.unlock();
+        if(log != nullptr && !log->Commit(sequence))
+        {
+            // The user is registered but its record could not be made durable, return ADDED_NOT_DURABLE
+            return timer.Finish(ADDED_NOT_DURABLE);
+        }
+
         // User added successfully, return ADDED_SUCCESSFULLY
-        return ADDED_SUCCESSFULLY;
+        return timer.Finish(ADDED_SUCCESSFULLY);
+    }
+}
+
+/**
+ * @brief Constructs a new user in place and registers them in the library.
+ * 
+ * The user is allocated from the slab allocator of the library, and nothing is allocated
+ * if the ID is already taken. The memory is released with the library.
+ * 
+ * @param name The name of the user.
+ * @param id The ID of the user.
+ * @return add_handling_t Enumeration value indicating the result of the operation.
+*/
+add_handling_t Library::EmplaceUser(const string &name, int id)
+{
+    // Time the call for the statistics of the library
+    OperationTimer timer(stats, STAT_REGISTER_USER);
+
+    // Lock the shard of the user ID
+    UserShard &shard = ShardOf(id);
+    unique_lock<shared_mutex> shard_guard(shard.lock);
+
+    // Try to insert the user ID, a single hash lookup tells whether it is already registered
+    auto inserted = shard.users.emplace(id, nullptr);
+    if(!inserted.second)
+    {
+        // User ID already exists in the library, return ALREADY_TAKEN
+        return timer.Finish(ALREADY_TAKEN);
+    }
+
+    // Construct the user in an arena block
+    User *user = new (arena->Allocate(sizeof(User))) User(name, id);
+
+    // Register the user, the deleter gives the block back to the arena
+    ArenaDeleter<User> deleter;
+    deleter.arena = arena.get();
+    inserted.first->second = unique_ptr<User, ArenaDeleter<User>>(user, deleter);
+
+    // Log the user under the lock, then wait for the record once it is released
+    uint64_t sequence = (log != nullptr) ? log->LogRegisterUser(id, name) : 0;
+    shard_guard.unlock();
+    if(log != nullptr && !log->Commit(sequence))
+    {
+        // The user is registered but its record could not be made durable, return ADDED_NOT_DURABLE
+        return timer.Finish(ADDED_NOT_DURABLE);
     }
+
+    // User added successfully, return ADDED_SUCCESSFULLY
+    return timer.Finish(ADDED_SUCCESSFULLY);
 }
 
 /**
@@ -119,92 +713,145 @@ add_handling_t Library::RegisterNewUser(User *new_user)
  * This method attempts to remove a user from the library's records based on their ID.
  * If the user does not exist, it returns NOT_EXCIST. If the user exists but could not
  * be removed, it returns EXCIT. If the user is successfully removed, it returns REMOVED.
+ * The books still on loan to the user are made available again.
  * 
  * @param id The ID of the user to be removed.
  * @return remove_handling_t Enumeration value indicating the result of the operation.
 */
 remove_handling_t Library::RemoveUserFromLibrary(const int &id)
 {
+    // Time the call for the statistics of the library
+    OperationTimer timer(stats, STAT_REMOVE_USER);
+
+    // Lock the shard of the user ID, which also keeps the books on loan to the user in the library
+    UserShard &shard = ShardOf(id);
+    unique_lock<shared_mutex> shard_guard(shard.lock);
+
     // Check if the user with the specified ID exists in the library
-    if(users.count(id))
+    auto found = shard.users.find(id);
+    if(found != shard.users.end())
     {
+        // Give back every book still on loan to the user, mirroring it before the release
+        const vector<shared_ptr<Book>> &loans = found->second->GetBorrowedBooks();
+        while(!loans.empty())
+        {
+            // Hold the last loan, the return pops it off the list
+            shared_ptr<Book> book = loans.back();
+            catalogue.SetAvailability(book->GetBookSlot(), true);
+            if(found->second->UserReturnBook(book) == FALSE)
+            {
+                // The loan word no longer names the user, the remaining list dies with the user
+                break;
+            }
+        }
+
         // Remove the user from the library's records
-        users.erase(id);
+        shard.users.erase(found);
+
+        // Log the removal under the locks, then wait for the record once they are released
+        uint64_t sequence = (log != nullptr) ? log->LogRemoveUser(id) : 0;
+        shard_guard.unlock();
+        if(log != nullptr && !log->Commit(sequence))
+        {
+            // The user is removed but its record could not be made durable, return REMOVED_NOT_DURABLE
+            return timer.Finish(REMOVED_NOT_DURABLE);
+        }
 
         // User removed successfully, return REMOVED
-        return REMOVED;
+        return timer.Finish(REMOVED);
     }
     else
     {
         // User with the specified ID does not exist, return NOT_EXCIST
-        return NOT_EXCIST;
+        return timer.Finish(NOT_EXCIST);
     }
 }
 
 /**
- * @brief Displays all books currently in the library.
+ * @brief Gets every book of the library.
  * 
- * This method prints out details of all the books in the library's collection.
+ * @return vector<shared_ptr<Book>> The books, ordered by their slot in the library.
 */
-void Library::DisplayAllBooks()
+vector<shared_ptr<Book>> Library::GetAllBooks()
 {
-    // Iterator to traverse the unordered_map of books
-    auto it = books.begin();
-    
-    // Counter for displaying book numbers
-    int number = 1;
+    // Share the catalogue with the other readers while walking it
+    shared_lock<shared_mutex> catalogue_guard(catalogue_lock);
 
-    // Iterate through all books in the library
-    for(; it != books.end(); it++)
-    { 
-        // Display separator and book number
-        cout << "==============================================\n";
-        cout << "the book number "<< number<< " details\n";
-        cout << "==============================================\n";
-        
-        // Display book details
-        cout << "book_ISBN: " << it->first << "\n" << "book_name: " << it->second->GetBookName() 
-        << "\n" << "book_category: " << it->second->GetBookGener()<< "\n" << "book_auther: " << it->second->GetBookAuthor()
-        << "\n" << "book_availability: " << it->second->GetBookAvailability() << "\n"; 
-        
-        // Increment book counter
-        number++;
-        
-        // Display separator
-        cout << "==============================================\n";
+    // Collect the books of the live slots of the columnar catalogue
+    vector<shared_ptr<Book>> books;
+    books.reserve(catalogue.CountBooks());
+    for(book_handle_t slot = 0; slot < catalogue.SlotCount(); slot++)
+    {
+        if(catalogue.IsLive(slot))
+        {
+            books.push_back(book_slots[slot]);
+        }
     }
+
+    return books;
 }
 
 /**
- * @brief Displays all users currently registered in the library.
+ * @brief Gets every user registered in the library.
  * 
- * This method prints out details of all users registered in the library.
+ * @return vector<User *> The users, grouped by shard.
 */
-void Library::DisplayAllUsers()
+vector<User *> Library::GetAllUsers()
 {
-    // Iterator to traverse the unordered_map of users
-   auto it = users.begin();
-    
-    // Counter for displaying user numbers
-    int number = 1;
+    // The users collected from every shard
+    vector<User *> users;
 
-    // Iterate through all users in the library
-    for(; it != users.end(); it++)
-    { 
-        // Display separator and user number
-        cout << "==============================================\n";
-        cout << "the user number "<< number<< " details\n";
-        cout << "==============================================\n";
-        
-        // Display user details
-        cout << "user_id: "<< it->first << "\n" << "user_name: " << it->second->GetUserName() << "\n"; 
-        
-        // Increment user counter
-        number++;
+    // Visit the shards one at a time, sharing each with the other readers
+    for(size_t i = 0; i < SHARD_COUNT; i++)
+    {
+        shared_lock<shared_mutex> shard_guard(user_shards[i].lock);
+        for(auto it = user_shards[i].users.begin(); it != user_shards[i].users.end(); it++)
+        {
+            users.push_back(it->second.get());
+        }
+    }
 
-        // Display separator
-        cout << "==============================================\n";
-    } 
+    return users;
+}
+
+/**
+ * @brief Lists one page of the catalogue, sorted by title or by serial number.
+ * 
+ * @param order The order of the listing.
+ * @param after The cursor of the previous page, a default one for the first page.
+ * @param limit The largest number of books of the page.
+ * @return BookPage The books of the page, the cursor of the next page and whether it exists.
+*/
+BookPage Library::ListBooks(book_order_t order, const BookCursor &after, size_t limit)
+{
+    // Time the call for the statistics of the library
+    OperationTimer timer(stats, STAT_LIST);
+
+    // Share the catalogue, the ordered indexes only change under its exclusive lock
+    shared_lock<shared_mutex> catalogue_guard(catalogue_lock);
+
+    // Walk the ordered index from the cursor
+    const OrderedBookIndex &index = (order == ORDER_BY_TITLE) ? title_order : isbn_order;
+    BookPage page;
+    vector<book_handle_t> handles = index.Page(after, limit, page.has_more);
+
+    // Resolve the books and continue the next page after the last one
+    page.books.reserve(handles.size());
+    for(book_handle_t slot : handles)
+    {
+        page.books.push_back(book_slots[slot]);
+    }
+    if(!handles.empty())
+    {
+        page.next.title = catalogue.GetTitle(handles.back());
+        page.next.ISBN = catalogue.GetISBN(handles.back());
+    }
+    else
+    {
+        page.next = after;
+    }
+
+    return timer.Finish(std::move(page));
 }
 
 /**
@@ -215,44 +862,73 @@ void Library::DisplayAllUsers()
  * 
  * @param user_id The ID of the user borrowing the book.
  * @param temp_ISBN The ISBN of the book being borrowed.
+ * @return loan_status_t Enumeration value indicating the result of the operation.
 */
-void Library::UserBorrowBook(const int &user_id ,const string &temp_ISBN)
+loan_status_t Library::UserBorrowBook(const int &user_id ,const string &temp_ISBN)
 {
+    // Normalize the serial number once and borrow by key
+    return UserBorrowBook(user_id, IsbnKey::FromString(temp_ISBN));
+}
+
+/**
+ * @brief Allows a user to borrow a book identified by its binary key.
+ * 
+ * Every table is probed exactly once, with no string hashing or allocation.
+ * 
+ * @param user_id The ID of the user borrowing the book.
+ * @param key The normalized key of the book being borrowed.
+ * @return loan_status_t Enumeration value indicating the result of the operation.
+*/
+loan_status_t Library::UserBorrowBook(const int &user_id, IsbnKey key)
+{
+    // Time the call for the statistics of the library
+    OperationTimer timer(stats, STAT_BORROW);
+
+    // Lock the shard of the user, then share the shard of the book, the catalogue lock is not needed
+    UserShard &user_shard = ShardOf(user_id);
+    unique_lock<shared_mutex> user_guard(user_shard.lock);
+    BookShard &book_shard = ShardOf(key);
+    shared_lock<shared_mutex> book_guard(book_shard.lock);
+
     // Check if the user with the specified ID exists
-    if(users.count(user_id))
+    auto user_it = user_shard.users.find(user_id);
+    if(user_it == user_shard.users.end())
     {
-        // Check if the book with the specified ISBN exists
-        if(books.count(temp_ISBN))
-        {
-            // Get the book and user pointers
-            auto it = books[temp_ISBN];
-            auto& it_2 = users[user_id];
-
-            // Attempt to borrow the book
-            Ret_val_t ret = it_2->UserBorrowBook(it);
-            
-            // Check if the borrowing was successful
-            if(ret == TRUE)
-            {
-                cout << "the user "<<it_2->GetUserName()<<" borrowed the book "
-                <<it->GetBookName()<< " successuflly!\n";
-            } 
-            else
-            {
-                cout << "Fail!! This book is already borrowed and not available\n";
-            }
-        }
-        else
-        {
-            // Book with the specified ISBN does not exist
-            cout << "Failed!! There is no book with that serial in the library\n";
-        }
+        // User with the specified ID does not exist, return LOAN_UNKNOWN_USER
+        return timer.Finish(LOAN_UNKNOWN_USER);
     }
-    else
+
+    // Check if the book with the specified ISBN exists
+    auto book_it = book_shard.books.find(key);
+    if(book_it == book_shard.books.end())
     {
-        // User with the specified ID does not exist
-        cout << "invalid id!! this user isn't registed in the library\n";
+        // Book with the specified ISBN does not exist, return LOAN_UNKNOWN_BOOK
+        return timer.Finish(LOAN_UNKNOWN_BOOK);
     }
+
+    // Attempt to borrow the book
+    const shared_ptr<Book> &book = book_it->second;
+    if(user_it->second->UserBorrowBook(book) == FALSE)
+    {
+        // The book is already on loan, return LOAN_NOT_AVAILABLE
+        return timer.Finish(LOAN_NOT_AVAILABLE);
+    }
+
+    // Mirror the new availability in the columnar catalogue, its bits never move under the shard lock
+    catalogue.SetAvailability(book->GetBookSlot(), false);
+
+    // Log the loan under the locks, then wait for the record once they are released
+    uint64_t sequence = (log != nullptr) ? log->LogBorrowBook(user_id, key) : 0;
+    book_guard.unlock();
+    user_guard.unlock();
+    if(log != nullptr && !log->Commit(sequence))
+    {
+        // The book is borrowed but its record could not be made durable, return LOAN_NOT_DURABLE
+        return timer.Finish(LOAN_NOT_DURABLE);
+    }
+
+    // Book borrowed successfully, return LOAN_SUCCEEDED
+    return timer.Finish(LOAN_SUCCEEDED);
 }
 
 /**
@@ -263,46 +939,602 @@ void Library::UserBorrowBook(const int &user_id ,const string &temp_ISBN)
  * 
  * @param user_id The ID of the user returning the book.
  * @param temp_ISBN The ISBN of the book being returned.
+ * @return loan_status_t Enumeration value indicating the result of the operation.
+*/
+loan_status_t Library::UserReturnBook(const int &user_id ,const string &temp_ISBN)
+{
+    // Normalize the serial number once and return by key
+    return UserReturnBook(user_id, IsbnKey::FromString(temp_ISBN));
+}
+
+/**
+ * @brief Allows a user to return a book identified by its binary key.
+ * 
+ * Every table is probed exactly once, with no string hashing or allocation.
+ * 
+ * @param user_id The ID of the user returning the book.
+ * @param key The normalized key of the book being returned.
+ * @return loan_status_t Enumeration value indicating the result of the operation.
 */
-void Library::UserReturnBook(const int &user_id ,const string &temp_ISBN)
+loan_status_t Library::UserReturnBook(const int &user_id, IsbnKey key)
 {
+    // Time the call for the statistics of the library
+    OperationTimer timer(stats, STAT_RETURN);
+
+    // Lock the shard of the user, then share the shard of the book, the catalogue lock is not needed
+    UserShard &user_shard = ShardOf(user_id);
+    unique_lock<shared_mutex> user_guard(user_shard.lock);
+    BookShard &book_shard = ShardOf(key);
+    shared_lock<shared_mutex> book_guard(book_shard.lock);
+
     // Check if the user with the specified ID exists
-    if(users.count(user_id))
+    auto user_it = user_shard.users.find(user_id);
+    if(user_it == user_shard.users.end())
+    {
+        // User with the specified ID does not exist, return LOAN_UNKNOWN_USER
+        return timer.Finish(LOAN_UNKNOWN_USER);
+    }
+
+    // Check if the book with the specified ISBN exists
+    auto book_it = book_shard.books.find(key);
+    if(book_it == book_shard.books.end())
+    {
+        // Book with the specified ISBN does not exist, return LOAN_UNKNOWN_BOOK
+        return timer.Finish(LOAN_UNKNOWN_BOOK);
+    }
+
+    // Only the holder can release the book, and the user shard lock keeps the holder from
+    // racing itself, so the catalogue is mirrored before the release: a user claiming the book
+    // right after the release can never have its borrowed bit overwritten by this return
+    const shared_ptr<Book> &book = book_it->second;
+    if(!book->IsBorrowedBy(user_id))
+    {
+        // The book is not on loan to the user, return LOAN_NOT_BORROWED
+        return timer.Finish(LOAN_NOT_BORROWED);
+    }
+
+    // Log the return before the release, so a user claiming the book right after it always
+    // logs its loan after this return
+    uint64_t sequence = (log != nullptr) ? log->LogReturnBook(user_id, key) : 0;
+    catalogue.SetAvailability(book->GetBookSlot(), true);
+    user_it->second->UserReturnBook(book);
+
+    // Wait for the record once the locks are released
+    book_guard.unlock();
+    user_guard.unlock();
+    if(log != nullptr && !log->Commit(sequence))
+    {
+        // The book is returned but its record could not be made durable, return LOAN_NOT_DURABLE
+        return timer.Finish(LOAN_NOT_DURABLE);
+    }
+
+    // Book returned successfully, return LOAN_SUCCEEDED
+    return timer.Finish(LOAN_SUCCEEDED);
+}
+
+/**
+ * @brief Borrows a batch of books, such as a stack scanned at a self-checkout kiosk.
+ * 
+ * @param requests The loans, applied in order.
+ * @param count The number of loans.
+ * @return vector<loan_status_t> The result of every loan, in the same order.
+*/
+vector<loan_status_t> Library::BorrowBooks(const loan_request_t *requests, size_t count)
+{
+    // Time the whole batch, its requests are counted by outcome
+    OperationTimer timer(stats, STAT_BORROW_BATCH);
+    vector<loan_status_t> results = ApplyLoans(requests, count, true);
+    RecordBatch(stats, STAT_BORROW_BATCH, results, timer.Elapsed());
+    return results;
+}
+
+/**
+ * @brief Returns a batch of books, with the same locking and prefetching as BorrowBooks().
+ * 
+ * @param requests The returns, applied in order.
+ * @param count The number of returns.
+ * @return vector<loan_status_t> The result of every return, in the same order.
+*/
+vector<loan_status_t> Library::ReturnBooks(const loan_request_t *requests, size_t count)
+{
+    // Time the whole batch, its requests are counted by outcome
+    OperationTimer timer(stats, STAT_RETURN_BATCH);
+    vector<loan_status_t> results = ApplyLoans(requests, count, false);
+    RecordBatch(stats, STAT_RETURN_BATCH, results, timer.Elapsed());
+    return results;
+}
+
+/**
+ * @brief Applies a batch of loans or returns.
+ * 
+ * The probed group of every key and then every book are loaded up front, each under a brief
+ * share of its book shard, so the cache misses of the lookups overlap. The operations are then
+ * applied with the user shard locked across the runs of users sharing it, and the shard of each
+ * book shared while it is claimed or released; the catalogue lock is never taken.
+ * 
+ * @param requests The operations, applied in order.
+ * @param count The number of operations.
+ * @param borrow true to borrow the books, false to return them.
+ * @return vector<loan_status_t> The result of every operation, in the same order.
+*/
+vector<loan_status_t> Library::ApplyLoans(const loan_request_t *requests, size_t count, bool borrow)
+{
+    vector<loan_status_t> results(count, LOAN_SUCCEEDED);
+
+    // Start loading the probed group of every key before any lookup waits on memory
+    for(size_t i = 0; i < count; i++)
     {
-        // Check if the book with the specified ISBN exists
-        if(books.count(temp_ISBN))
+        BookShard &shard = ShardOf(requests[i].key);
+        shared_lock<shared_mutex> shard_guard(shard.lock);
+        shard.books.prefetch(requests[i].key);
+    }
+
+    // Find every book, then start loading the loan words the operations will claim
+    for(size_t i = 0; i < count; i++)
+    {
+        BookShard &shard = ShardOf(requests[i].key);
+        shared_lock<shared_mutex> shard_guard(shard.lock);
+        auto found = shard.books.find(requests[i].key);
+        if(found != shard.books.end())
         {
-            // Get the book and user pointers
-            auto it = books[temp_ISBN];
-            auto& it_2 = users[user_id];
+            __builtin_prefetch(found->second.get());
+        }
+    }
 
-            // Attempt to return the book
-            Ret_val_t ret = it_2->UserReturnBook(it); 
+    // The sequence number of the last logged operation, 0 if nothing changed
+    uint64_t sequence = 0;
 
-            // Check if the return was successful
-            if(ret == TRUE)
+    // Apply the operations in order, keeping a user shard locked while consecutive users share it
+    UserShard *locked_shard = nullptr;
+    unique_lock<shared_mutex> user_guard;
+    for(size_t i = 0; i < count; i++)
+    {
+        UserShard &user_shard = ShardOf(requests[i].user_id);
+        if(&user_shard != locked_shard)
+        {
+            // Release the previous shard first, so the shards are never held two at a time
+            if(user_guard.owns_lock())
             {
-                cout << "the user "<<it_2->GetUserName()<<" returned the borrowed book "<<it->GetBookName()<< " successuflly!\n";
+                user_guard.unlock();
             }
-            else
+            user_guard = unique_lock<shared_mutex>(user_shard.lock);
+            locked_shard = &user_shard;
+
+            // Start loading the users of the run of operations sharing this shard
+            for(size_t j = i; j < count && &ShardOf(requests[j].user_id) == locked_shard; j++)
             {
-                cout << "Sorry!! the user: "<<it_2->GetUserName()<< " doesn't even borrow the book "
-                << it->GetBookName() << "\n";
+                user_shard.users.prefetch(requests[j].user_id);
             }
+        }
+
+        // Check that the user and the book exist, the book staying in place while its shard is shared
+        auto user_it = user_shard.users.find(requests[i].user_id);
+        if(user_it == user_shard.users.end())
+        {
+            results[i] = LOAN_UNKNOWN_USER;
+            continue;
+        }
+        BookShard &book_shard = ShardOf(requests[i].key);
+        shared_lock<shared_mutex> book_guard(book_shard.lock);
+        auto book_it = book_shard.books.find(requests[i].key);
+        if(book_it == book_shard.books.end())
+        {
+            results[i] = LOAN_UNKNOWN_BOOK;
+            continue;
+        }
+        const shared_ptr<Book> &book = book_it->second;
 
+        // A loan is logged after its claim and a return before its release, so the log keeps
+        // the order in which the book changes hands
+        if(borrow)
+        {
+            // Claim the book and mirror the loan in the columnar catalogue
+            if(user_it->second->UserBorrowBook(book) == FALSE)
+            {
+                results[i] = LOAN_NOT_AVAILABLE;
+                continue;
+            }
+            catalogue.SetAvailability(book->GetBookSlot(), false);
+            if(log != nullptr)
+            {
+                sequence = log->LogBorrowBook(requests[i].user_id, requests[i].key);
+            }
         }
         else
         {
-            // Book with the specified ISBN does not exist
-            cout << "Failed!! There is no book with that serial in the library\n";
+            // Log the return, then mirror it before the release, as UserReturnBook() does
+            if(!book->IsBorrowedBy(requests[i].user_id))
+            {
+                results[i] = LOAN_NOT_BORROWED;
+                continue;
+            }
+            if(log != nullptr)
+            {
+                sequence = log->LogReturnBook(requests[i].user_id, requests[i].key);
+            }
+            catalogue.SetAvailability(book->GetBookSlot(), true);
+            user_it->second->UserReturnBook(book);
+        }
+    }
+
+    // Release the lock, then wait once for the last record, which makes the whole batch durable
+    if(user_guard.owns_lock())
+    {
+        user_guard.unlock();
+    }
+    if(sequence != 0 && !log->Commit(sequence))
+    {
+        // The operations applied could not be made durable, report them LOAN_NOT_DURABLE
+        replace(results.begin(), results.end(), LOAN_SUCCEEDED, LOAN_NOT_DURABLE);
+    }
+
+    return results;
+}
+
+/**
+ * @brief Resolves a list of book handles to the books they refer to.
+ * 
+ * @param handles The handles of the books.
+ * @return The books in the same order as the handles.
+*/
+vector<shared_ptr<Book>> Library::ResolveBookHandles(const vector<book_handle_t> &handles)
+{
+    // The books referred to by the handles
+    vector<shared_ptr<Book>> result;
+    result.reserve(handles.size());
+
+    // Translate every handle through the slot table
+    for(book_handle_t handle : handles)
+    {
+        result.push_back(book_slots[handle]);
+    }
+
+    return result;
+}
+
+/**
+ * @brief Finds the user currently holding a book.
+ * 
+ * The borrower is recorded in the loan word of the book, so the lookup costs one probe
+ * of the books table instead of a walk over the loans of every user.
+ * 
+ * @param ISBN The ISBN of the book.
+ * @param user_id Receives the ID of the borrower.
+ * @return true if the book exists and is on loan to a registered user.
+*/
+bool Library::FindBookBorrower(const string &ISBN, int &user_id)
+{
+    // Share the shard of the key, the loan word is read atomically
+    IsbnKey key = IsbnKey::FromString(ISBN);
+    BookShard &shard = ShardOf(key);
+    shared_lock<shared_mutex> shard_guard(shard.lock);
+
+    // Read the borrower from the loan word of the book
+    auto found = shard.books.find(key);
+    return (found != shard.books.end()) && found->second->GetBookBorrower(user_id);
+}
+
+/**
+ * @brief Attaches a write-ahead log recording every later mutation of the library.
+ * 
+ * @param wal The log, which must outlive the library, or nullptr to detach it.
+*/
+void Library::AttachLog(WriteAheadLog *wal)
+{
+    // Block every mutation so none is half logged while the log changes: the books are added and
+    // removed under the catalogue lock, every other mutation holds a user shard
+    unique_lock<shared_mutex> catalogue_guard(catalogue_lock);
+    vector<unique_lock<shared_mutex>> user_guards;
+    user_guards.reserve(SHARD_COUNT);
+    for(size_t i = 0; i < SHARD_COUNT; i++)
+    {
+        user_guards.emplace_back(user_shards[i].lock);
+    }
+    log = wal;
+}
+
+/**
+ * @brief Gets a copy of the counters and latency histograms of the operations of the library.
+ * 
+ * @return StatsSnapshot The statistics since the library was constructed, all zeros if they
+ *         are compiled out.
+*/
+StatsSnapshot Library::Stats() const
+{
+    return stats.Snapshot();
+}
+
+/**
+ * @brief Searches for a book by its title.
+ * 
+ * The title is looked up in the inverted title index, so the cost depends on the number
+ * of matching books rather than on the size of the catalogue. A book whose title has exactly
+ * the terms of the query is preferred, otherwise the first book containing all of them is returned.
+ * If no title holds every term, the best match of the fuzzy index is returned.
+ * 
+ * @param title The title of the book to search for.
+ * @return shared_ptr<Book> The found book, or nullptr if no title matches even approximately.
+*/
+shared_ptr<Book> Library::SearchForBook(string title)
+{
+    // Time the call for the statistics of the library
+    OperationTimer timer(stats, STAT_SEARCH_TITLE);
+
+    // Share the catalogue with the other readers
+    shared_lock<shared_mutex> catalogue_guard(catalogue_lock);
+
+    // Get the books containing every term of the title
+    vector<shared_ptr<Book>> matches = ResolveBookHandles(title_index.SearchTitle(title));
+
+    if(matches.empty())
+    {
+        // No title contains the terms of the query, fall back to the closest partial or misspelled match
+        vector<shared_ptr<Book>> closest = ResolveBookHandles(fuzzy_index.Search(title, 1));
+        return timer.Finish(closest.empty() ? shared_ptr<Book>() : closest.front());
+    }
+
+    // Prefer the book whose title has exactly the terms of the query
+    vector<string> wanted = TitleIndex::TokenizeTitle(title);
+    for(const shared_ptr<Book> &book : matches)
+    {
+        if(TitleIndex::TokenizeTitle(book->GetBookName()).size() == wanted.size())
+        {
+            return timer.Finish(book);
+        }
+    }
+
+    // Otherwise return the first book containing all the terms
+    return timer.Finish(matches.front());
+}
+
+/**
+ * @brief Searches for the books whose title or author approximately holds every term of a query.
+ * 
+ * Each term of the query matches the catalogue terms it equals, starts, lies inside, or is
+ * within a few edits of, found through the trigram index and verified by a bounded edit distance.
+ * 
+ * @param query The partial or misspelled title or author name.
+ * @param limit The largest number of books returned.
+ * @return vector<shared_ptr<Book>> The matching books, the closest first.
+*/
+vector<shared_ptr<Book>> Library::FuzzySearchBooks(const string &query, size_t limit)
+{
+    // Time the call for the statistics of the library
+    OperationTimer timer(stats, STAT_SEARCH_FUZZY);
+
+    // Share the catalogue with the other readers
+    shared_lock<shared_mutex> catalogue_guard(catalogue_lock);
+
+    // Rank the approximate matches in the trigram index and resolve the best handles
+    return timer.Finish(ResolveBookHandles(fuzzy_index.Search(query, limit)));
+}
+
+/**
+ * @brief Searches for all the books whose titles contain every term of a query.
+ * 
+ * Terms are matched case insensitively, in any order ("algebra linear" finds "LinearAlgebra").
+ * 
+ * @param title The title (or part of it) to search for.
+ * @return vector<shared_ptr<Book>> The matching books, ordered by their slot in the library.
+*/
+vector<shared_ptr<Book>> Library::SearchForBooks(const string &title)
+{
+    // Time the call for the statistics of the library
+    OperationTimer timer(stats, STAT_SEARCH_TITLE);
+
+    // Share the catalogue with the other readers
+    shared_lock<shared_mutex> catalogue_guard(catalogue_lock);
+
+    // Look up the terms in the title index and resolve the matching handles
+    return timer.Finish(ResolveBookHandles(title_index.SearchTitle(title)));
+}
+
+/**
+ * @brief Searches for all the books written by an author.
+ * 
+ * The author is looked up in the secondary author index, so the cost depends on the number
+ * of books of the author rather than on the size of the catalogue. Names are compared case
+ * insensitively and blank runs are ignored.
+ * 
+ * @param author The name of the author.
+ * @return vector<shared_ptr<Book>> The books of the author, ordered by their slot in the library.
+*/
+vector<shared_ptr<Book>> Library::SearchForBooksByAuthor(const string &author)
+{
+    // Time the call for the statistics of the library
+    OperationTimer timer(stats, STAT_SEARCH_AUTHOR);
+
+    // Share the catalogue with the other readers
+    shared_lock<shared_mutex> catalogue_guard(catalogue_lock);
+
+    // Look up the posting list of the normalized author name
+    const PostingList *handles = author_index.FindPostings(PostingIndex::NormalizeKey(author));
+
+    // Resolve the handles if the author has any book in the library
+    return timer.Finish((handles == nullptr) ? vector<shared_ptr<Book>>() : ResolveBookHandles(handles->ToVector()));
+}
+
+/**
+ * @brief Searches for all the books of a genre.
+ * 
+ * The genre is looked up in the secondary genre index, so the cost depends on the number
+ * of books of the genre rather than on the size of the catalogue. Genres are compared case
+ * insensitively and blank runs are ignored.
+ * 
+ * @param genre The genre of the books.
+ * @return vector<shared_ptr<Book>> The books of the genre, ordered by their slot in the library.
+*/
+vector<shared_ptr<Book>> Library::SearchForBooksByGenre(const string &genre)
+{
+    // Time the call for the statistics of the library
+    OperationTimer timer(stats, STAT_SEARCH_GENRE);
+
+    // Share the catalogue with the other readers
+    shared_lock<shared_mutex> catalogue_guard(catalogue_lock);
+
+    // Look up the posting list of the normalized genre
+    const PostingList *handles = genre_index.FindPostings(PostingIndex::NormalizeKey(genre));
+
+    // Resolve the handles if the genre has any book in the library
+    return timer.Finish((handles == nullptr) ? vector<shared_ptr<Book>>() : ResolveBookHandles(handles->ToVector()));
+}
+
+/**
+ * @brief Runs a compound query over the books of the library.
+ * 
+ * The indexed predicates of the query are planned against the title, author and genre
+ * indexes: their posting lists are intersected from the most selective one, and the Book
+ * objects are only touched to resolve the survivors, whose availability is read from the catalogue bitset.
+ * A query without indexed predicates falls back to a scan of the catalogue bitsets.
+ * 
+ * @param query The predicates the books must all satisfy.
+ * @return vector<shared_ptr<Book>> The matching books, ordered by their slot in the library.
+*/
+vector<shared_ptr<Book>> Library::QueryBooks(const BookQuery &query)
+{
+    // Time the call for the statistics of the library
+    OperationTimer timer(stats, STAT_QUERY);
+
+    // Share the catalogue with the other readers
+    shared_lock<shared_mutex> catalogue_guard(catalogue_lock);
+
+    // The posting lists of the indexed predicates of the query
+    vector<const PostingList *> lists;
+
+    // The union of the author names sharing the prefix, owned here since no index holds it
+    PostingList prefix_postings;
+
+    // Collect the posting lists of the title terms
+    if(!query.title.empty() && (!title_index.CollectPostings(query.title, lists) || lists.empty()))
+    {
+        // A title term is held by no book, or the title has no term at all ("!!!") and matches nothing
+        return timer.Finish(vector<shared_ptr<Book>>());
+    }
+
+    // Collect the posting list of the exact author
+    if(!query.author.empty())
+    {
+        const PostingList *list = author_index.FindPostings(PostingIndex::NormalizeKey(query.author));
+        if(list == nullptr)
+        {
+            return timer.Finish(vector<shared_ptr<Book>>());
+        }
+        lists.push_back(list);
+    }
+
+    // Collect the posting list of the exact genre
+    if(!query.genre.empty())
+    {
+        const PostingList *list = genre_index.FindPostings(PostingIndex::NormalizeKey(query.genre));
+        if(list == nullptr)
+        {
+            return timer.Finish(vector<shared_ptr<Book>>());
+        }
+        lists.push_back(list);
+    }
+
+    // Collect the books of all the authors sharing the prefix
+    if(!query.author_prefix.empty())
+    {
+        vector<book_handle_t> prefix_handles = author_index.FindPrefixPostings(PostingIndex::NormalizeKey(query.author_prefix));
+        if(prefix_handles.empty())
+        {
+            return timer.Finish(vector<shared_ptr<Book>>());
         }
+        prefix_postings.Assign(prefix_handles.data(), prefix_handles.size());
+        lists.push_back(&prefix_postings);
+    }
+
+    // The handles satisfying every indexed predicate
+    vector<book_handle_t> survivors;
+
+    if(!lists.empty())
+    {
+        // Intersect the posting lists starting from the most selective one
+        survivors = PostingIndex::IntersectPostings(lists);
     }
     else
     {
-        // User with the specified ID does not exist
-        cout << "invalid id!! this user isn't registed in the library\n";
+        // No indexed predicate, every book in the library is a candidate
+        survivors.reserve(catalogue.CountBooks());
+        for(book_handle_t slot = 0; slot < catalogue.SlotCount(); slot++)
+        {
+            if(catalogue.IsLive(slot))
+            {
+                survivors.push_back(slot);
+            }
+        }
     }
+
+    // Resolve the survivors, checking their availability in the catalogue bitset
+    vector<shared_ptr<Book>> result;
+    result.reserve(survivors.size());
+
+    for(book_handle_t handle : survivors)
+    {
+        if(query.availability == ONLY_AVAILABLE && !catalogue.IsAvailable(handle))
+        {
+            continue;
+        }
+        if(query.availability == ONLY_BORROWED && catalogue.IsAvailable(handle))
+        {
+            continue;
+        }
+        result.push_back(book_slots[handle]);
+    }
+
+    return timer.Finish(std::move(result));
 }
 
+/**
+ * @brief Counts the books currently available for borrowing.
+ * 
+ * The count is a popcount over the packed availability bitset of the catalogue.
+ * 
+ * @return size_t The number of available books.
+*/
+size_t Library::CountAvailableBooks()
+{
+    // Popcount the availability bitset of the catalogue
+    shared_lock<shared_mutex> catalogue_guard(catalogue_lock);
+    return catalogue.CountAvailable();
+}
 
+/**
+ * @brief Counts the books currently on loan.
+ * 
+ * @return size_t The number of borrowed books.
+*/
+size_t Library::CountBorrowedBooks()
+{
+    // Every book of the library that is not available is on loan
+    shared_lock<shared_mutex> catalogue_guard(catalogue_lock);
+    return catalogue.CountBooks() - catalogue.CountAvailable();
+}
 
+/**
+ * @brief Gets the inventory counters of a genre.
+ * 
+ * The counters are maintained on every add, remove, borrow and return, so reading them is O(1).
+ * 
+ * @param genre The genre, compared case insensitively.
+ * @return inventory_stats_t The number of books and available books of the genre.
+*/
+inventory_stats_t Library::GetGenreInventory(const string &genre)
+{
+    // Read the genre counters of the catalogue
+    shared_lock<shared_mutex> catalogue_guard(catalogue_lock);
+    return catalogue.GetGenreInventory(genre);
+}
+
+/**
+ * @brief Gets the inventory counters of every genre of the library.
+ * 
+ * @return vector<pair<string, inventory_stats_t>> Pairs of genre name and counters.
+*/
+vector<pair<string, inventory_stats_t>> Library::GetInventoryByGenre()
+{
+    // Read the counters of every genre of the catalogue
+    shared_lock<shared_mutex> catalogue_guard(catalogue_lock);
+    return catalogue.GetInventoryByGenre();
+}
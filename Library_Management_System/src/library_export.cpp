@@ -0,0 +1,140 @@
+#include <string>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <fcntl.h>
+#include <unistd.h>
+#include "library.hpp"
+#include "export_format.hpp"
+
+using namespace std;
+
+/**
+ * @brief Streams every book of the library through an export format.
+ * 
+ * @param format The layout of the records.
+ * @param out The buffer the records are appended to.
+ * @return size_t The number of books exported.
+*/
+size_t Library::ExportBooks(ExportFormat &format, ExportBuffer &out)
+{
+    // Share the catalogue with the other readers while walking it
+    shared_lock<shared_mutex> catalogue_guard(catalogue_lock);
+
+    // The number of books exported
+    size_t exported = 0;
+
+    format.BeginBooks(out);
+
+    // Read the fields in place from the columnar catalogue, in slot order
+    for(book_handle_t slot = 0; slot < catalogue.SlotCount(); slot++)
+    {
+        // Skip the slots released by removed books
+        if(!catalogue.IsLive(slot))
+        {
+            continue;
+        }
+
+        book_view_t book;
+        book.ISBN = catalogue.GetISBN(slot);
+        book.title = catalogue.GetTitle(slot);
+        book.author = catalogue.GetAuthor(slot);
+        book.genre = catalogue.GetGenre(slot);
+        book.available = catalogue.IsAvailable(slot);
+        format.WriteBook(out, book);
+        exported++;
+    }
+
+    return exported;
+}
+
+/**
+ * @brief Streams every user of the library through an export format.
+ * 
+ * @param format The layout of the records.
+ * @param out The buffer the records are appended to.
+ * @return size_t The number of users exported.
+*/
+size_t Library::ExportUsers(ExportFormat &format, ExportBuffer &out)
+{
+    // The number of users exported
+    size_t exported = 0;
+
+    format.BeginUsers(out);
+
+    // Visit the shards one at a time, sharing each with the other readers
+    for(size_t i = 0; i < SHARD_COUNT; i++)
+    {
+        shared_lock<shared_mutex> shard_guard(user_shards[i].lock);
+        for(auto it = user_shards[i].users.begin(); it != user_shards[i].users.end(); it++)
+        {
+            user_view_t user;
+            user.id = it->first;
+            user.name = it->second->GetUserName();
+            user.loans = it->second->GetBorrowedBooks().size();
+            format.WriteUser(out, user);
+            exported++;
+        }
+    }
+
+    return exported;
+}
+
+/**
+ * @brief Exports the books or the users of a library to a file in a built-in format.
+ * 
+ * @param library The library exported.
+ * @param path The path of the output file.
+ * @param format The format of the records.
+ * @param users true to export the users, false the books.
+ * @param exported Receives the number of records written.
+ * @return export_handling_t Enumeration value indicating the result of the operation.
+*/
+static export_handling_t ExportToFile(Library &library, const string &path, export_format_t format, bool users, size_t &exported)
+{
+    exported = 0;
+
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0)
+    {
+        return EXPORT_NOT_OPENED;
+    }
+
+    // Format every record into the buffer, which reaches the file a megabyte at a time
+    bool written;
+    {
+        unique_ptr<ExportFormat> layout = ExportFormat::Create(format);
+        ExportBuffer out(fd);
+        exported = users ? library.ExportUsers(*layout, out) : library.ExportBooks(*layout, out);
+        written = out.Flush();
+    }
+    written = (close(fd) == 0) && written;
+
+    return written ? EXPORTED_SUCCESSFULLY : EXPORT_NOT_WRITTEN;
+}
+
+/**
+ * @brief Exports every book of the library to a file.
+ * 
+ * @param path The path of the output file.
+ * @param format The format of the records.
+ * @param exported Receives the number of books written.
+ * @return export_handling_t Enumeration value indicating the result of the operation.
+*/
+export_handling_t Library::ExportBooks(const string &path, export_format_t format, size_t &exported)
+{
+    return ExportToFile(*this, path, format, false, exported);
+}
+
+/**
+ * @brief Exports every user of the library to a file.
+ * 
+ * @param path The path of the output file.
+ * @param format The format of the records.
+ * @param exported Receives the number of users written.
+ * @return export_handling_t Enumeration value indicating the result of the operation.
+*/
+export_handling_t Library::ExportUsers(const string &path, export_format_t format, size_t &exported)
+{
+    return ExportToFile(*this, path, format, true, exported);
+}
@@ -0,0 +1,829 @@
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <mutex>
+#include <shared_mutex>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "library.hpp"
+#include "isbn_key.hpp"
+#include "book.hpp"
+#include "user.hpp"
+
+using namespace std;
+
+/*
+ * Layout of a snapshot file (native byte order, every section aligned on 8 bytes):
+ *
+ *   SnapshotHeader
+ *   BOOKS         one SnapshotBook per book, in slot order
+ *   USERS         one SnapshotUser per user
+ *   LOANS         the slots of the books on loan, user after user, in loan index order (uint32)
+ *   TITLE_TERMS   \
+ *   AUTHOR_TERMS   > uint64 term count, one SnapshotTerm per term, then the handles (uint32)
+ *   GENRE_TERMS   /
+ *   TITLE_ORDER   the slots of every book sorted by title, then serial number (uint32)
+ *   ISBN_ORDER    the slots of every book sorted by serial number (uint32)
+ *   STRINGS       every title, author, genre, ISBN, user name and term, back to back
+ *
+ * Strings are referred to by their offset inside the STRINGS section and their length.
+ */
+
+/* The magic number opening every snapshot file. */
+static const char SNAPSHOT_MAGIC[8] = {'L', 'M', 'S', 'S', 'N', 'A', 'P', '\0'};
+
+/* The version of the layout, bumped on any incompatible change. */
+static const uint32_t SNAPSHOT_VERSION = 2;
+
+/**
+ * @brief The sections of a snapshot file.
+ */
+typedef enum
+{
+    SECTION_BOOKS,
+    SECTION_USERS,
+    SECTION_LOANS,
+    SECTION_TITLE_TERMS,
+    SECTION_AUTHOR_TERMS,
+    SECTION_GENRE_TERMS,
+    SECTION_TITLE_ORDER,
+    SECTION_ISBN_ORDER,
+    SECTION_STRINGS,
+    SECTION_COUNT
+}snapshot_section_t;
+
+/**
+ * @brief The header of a snapshot file.
+ */
+struct SnapshotHeader
+{
+    char magic[8];                          /* SNAPSHOT_MAGIC. */
+    uint32_t version;                       /* SNAPSHOT_VERSION. */
+    uint32_t header_size;                   /* sizeof(SnapshotHeader), guards against layout changes. */
+    uint64_t file_size;                     /* The size of the whole file, guards against truncation. */
+    uint64_t slot_count;                    /* One past the highest book slot. */
+    uint64_t book_count;                    /* The number of SnapshotBook records. */
+    uint64_t user_count;                    /* The number of SnapshotUser records. */
+    uint64_t loan_count;                    /* The number of slots of the LOANS section. */
+    uint64_t section_offsets[SECTION_COUNT];/* The offset of every section from the start of the file. */
+    uint64_t section_sizes[SECTION_COUNT];  /* The size of every section in bytes. */
+};
+
+/**
+ * @brief A book of a snapshot file.
+ */
+struct SnapshotBook
+{
+    uint64_t title_offset;
+    uint64_t author_offset;
+    uint64_t gener_offset;
+    uint64_t isbn_offset;
+    uint32_t title_length;
+    uint32_t author_length;
+    uint32_t gener_length;
+    uint32_t isbn_length;
+    uint32_t slot;          /* The slot of the book, kept so the search indexes stay valid. */
+    uint32_t available;     /* 1 if the book is available, 0 if it is on loan. */
+};
+
+/**
+ * @brief A user of a snapshot file.
+ */
+struct SnapshotUser
+{
+    int32_t id;
+    uint32_t name_length;
+    uint64_t name_offset;
+    uint64_t first_loan;    /* The index of the first loan of the user in the LOANS section. */
+    uint64_t loan_count;    /* The number of books on loan to the user. */
+};
+
+/**
+ * @brief A term of a saved posting index.
+ */
+struct SnapshotTerm
+{
+    uint64_t term_offset;
+    uint32_t term_length;
+    uint32_t posting_count;
+    uint64_t first_posting; /* The index of the first handle of the term in the handles of the section. */
+};
+
+/**
+ * @brief A buffered writer of a snapshot file keeping track of its offset.
+ */
+class SnapshotWriter
+{
+    private:
+        /* The descriptor of the file written. */
+        int fd;
+        /* The bytes not yet written to the file. */
+        vector<char> buffer;
+        /* The number of bytes handed to the writer so far. */
+        uint64_t offset = 0;
+        /* Whether every write succeeded. */
+        bool healthy = true;
+
+        /**
+         * @brief Writes the buffered bytes to the file.
+        */
+        void Flush()
+        {
+            const char *data = buffer.data();
+            size_t left = buffer.size();
+            while(healthy && left > 0)
+            {
+                ssize_t written = write(fd, data, left);
+                if(written <= 0)
+                {
+                    healthy = false;
+                    break;
+                }
+                data += written;
+                left -= static_cast<size_t>(written);
+            }
+            buffer.clear();
+        }
+
+    public:
+        /**
+         * @brief Constructs a writer appending to a file.
+         *
+         * @param file The descriptor of the file.
+        */
+        explicit SnapshotWriter(int file) : fd(file)
+        {
+            buffer.reserve(1 << 20);
+        }
+
+        /**
+         * @brief Appends bytes to the file.
+         *
+         * @param data The bytes to append.
+         * @param size The number of bytes.
+        */
+        void Write(const void *data, size_t size)
+        {
+            if(buffer.size() + size > buffer.capacity())
+            {
+                Flush();
+            }
+            if(size > buffer.capacity())
+            {
+                // A block larger than the buffer is written directly.
+                buffer.assign(static_cast<const char *>(data), static_cast<const char *>(data) + size);
+                Flush();
+            }
+            else
+            {
+                buffer.insert(buffer.end(), static_cast<const char *>(data), static_cast<const char *>(data) + size);
+            }
+            offset += size;
+        }
+
+        /**
+         * @brief Pads the file with zeros up to the next multiple of 8 bytes.
+        */
+        void Align()
+        {
+            static const char zeros[8] = {0};
+            Write(zeros, (8 - offset % 8) % 8);
+        }
+
+        /**
+         * @brief Gets the number of bytes handed to the writer so far.
+         *
+         * @return The offset of the next byte written.
+        */
+        uint64_t Offset() const { return offset; }
+
+        /**
+         * @brief Writes the remaining bytes to the file.
+         *
+         * @return true if every byte reached the file.
+        */
+        bool Finish()
+        {
+            Flush();
+            return healthy;
+        }
+};
+
+/**
+ * @brief Appends a string to the string section being built.
+ *
+ * @param strings The string section.
+ * @param value The string to append.
+ * @param offset Receives the offset of the string in the section.
+ * @param length Receives the length of the string.
+*/
+static void AppendString(string &strings, string_view value, uint64_t &offset, uint32_t &length)
+{
+    offset = strings.size();
+    length = static_cast<uint32_t>(value.size());
+    strings.append(value.data(), value.size());
+}
+
+/**
+ * @brief Writes a posting index as a section of a snapshot.
+ *
+ * @param writer The writer of the snapshot.
+ * @param index The index to write.
+ * @param strings The string section receiving the terms.
+*/
+static void WriteTerms(SnapshotWriter &writer, const PostingIndex &index, string &strings)
+{
+    const unordered_map<string, PostingList> &postings = index.GetAllPostings();
+
+    // The number of terms, then one record per term.
+    uint64_t term_count = postings.size();
+    writer.Write(&term_count, sizeof(term_count));
+
+    uint64_t first_posting = 0;
+    for(const auto &entry : postings)
+    {
+        SnapshotTerm term;
+        AppendString(strings, entry.first, term.term_offset, term.term_length);
+        term.posting_count = static_cast<uint32_t>(entry.second.Size());
+        term.first_posting = first_posting;
+        first_posting += entry.second.Size();
+        writer.Write(&term, sizeof(term));
+    }
+
+    // The handles of every term, in the same order as the records.
+    for(const auto &entry : postings)
+    {
+        for(const vector<book_handle_t> &block : entry.second.GetBlocks())
+        {
+            writer.Write(block.data(), block.size() * sizeof(book_handle_t));
+        }
+    }
+    writer.Align();
+}
+
+/**
+ * @brief Saves the whole state of the library (books, users, loans and search indexes).
+ *
+ * The snapshot is written to a temporary file next to the target, flushed to disk and
+ * renamed over the target, so a crash never leaves a half written snapshot behind.
+ *
+ * @param path The path of the snapshot file.
+ * @return snapshot_handling_t SNAPSHOT_SAVED, or SNAPSHOT_NOT_OPENED if the file can't be written.
+*/
+snapshot_handling_t Library::SaveSnapshot(const string &path)
+{
+    // Freeze the catalogue and every user shard while the state is written
+    unique_lock<shared_mutex> catalogue_guard(catalogue_lock);
+    vector<shared_lock<shared_mutex>> user_guards;
+    user_guards.reserve(SHARD_COUNT);
+    for(size_t i = 0; i < SHARD_COUNT; i++)
+    {
+        user_guards.emplace_back(user_shards[i].lock);
+    }
+
+    return WriteSnapshot(path);
+}
+
+/**
+ * @brief Saves the whole state of the library and empties its attached log.
+ *
+ * The log is truncated before the locks are released, so no mutation can be logged between
+ * the snapshot and the truncation and then be lost with it.
+ *
+ * @param path The path of the snapshot file.
+ * @return snapshot_handling_t SNAPSHOT_SAVED, or SNAPSHOT_NOT_OPENED if the file can't be written.
+*/
+snapshot_handling_t Library::Checkpoint(const string &path)
+{
+    // Freeze the catalogue and every user shard until the log is emptied
+    unique_lock<shared_mutex> catalogue_guard(catalogue_lock);
+    vector<shared_lock<shared_mutex>> user_guards;
+    user_guards.reserve(SHARD_COUNT);
+    for(size_t i = 0; i < SHARD_COUNT; i++)
+    {
+        user_guards.emplace_back(user_shards[i].lock);
+    }
+
+    snapshot_handling_t result = WriteSnapshot(path);
+    if(result == SNAPSHOT_SAVED && log != nullptr)
+    {
+        // The snapshot holds every logged mutation
+        log->Truncate();
+    }
+    return result;
+}
+
+/**
+ * @brief Writes the whole state of the library to a snapshot file.
+ *
+ * @param path The path of the snapshot file.
+ * @return snapshot_handling_t SNAPSHOT_SAVED, or SNAPSHOT_NOT_OPENED if the file can't be written.
+*/
+snapshot_handling_t Library::WriteSnapshot(const string &path)
+{
+    string temp_path = path + ".tmp";
+    int fd = open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0)
+    {
+        return SNAPSHOT_NOT_OPENED;
+    }
+
+    SnapshotWriter writer(fd);
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.header_size = sizeof(SnapshotHeader);
+    header.slot_count = book_slots.size();
+
+    // Reserve the room of the header, rewritten once the sections are known
+    writer.Write(&header, sizeof(header));
+
+    // The strings of every section, written last
+    string strings;
+
+    // Books, in slot order
+    header.section_offsets[SECTION_BOOKS] = writer.Offset();
+    for(book_handle_t slot = 0; slot < book_slots.size(); slot++)
+    {
+        const shared_ptr<Book> &book = book_slots[slot];
+        if(book == nullptr)
+        {
+            continue;
+        }
+        SnapshotBook record;
+        AppendString(strings, book->GetBookName(), record.title_offset, record.title_length);
+        AppendString(strings, book->GetBookAuthor(), record.author_offset, record.author_length);
+        AppendString(strings, book->GetBookGener(), record.gener_offset, record.gener_length);
+        AppendString(strings, book->GetBookNumber(), record.isbn_offset, record.isbn_length);
+        record.slot = slot;
+        record.available = book->GetBookAvailability() ? 1 : 0;
+        writer.Write(&record, sizeof(record));
+        header.book_count++;
+    }
+    header.section_sizes[SECTION_BOOKS] = writer.Offset() - header.section_offsets[SECTION_BOOKS];
+
+    // Users, with the range of their loans
+    header.section_offsets[SECTION_USERS] = writer.Offset();
+    for(size_t i = 0; i < SHARD_COUNT; i++)
+    {
+        for(const auto &entry : user_shards[i].users)
+        {
+            SnapshotUser record;
+            record.id = entry.first;
+            AppendString(strings, entry.second->GetUserName(), record.name_offset, record.name_length);
+            record.first_loan = header.loan_count;
+            record.loan_count = entry.second->GetBorrowedBooks().size();
+            header.loan_count += record.loan_count;
+            writer.Write(&record, sizeof(record));
+            header.user_count++;
+        }
+    }
+    header.section_sizes[SECTION_USERS] = writer.Offset() - header.section_offsets[SECTION_USERS];
+
+    // Loans, in the same user order
+    header.section_offsets[SECTION_LOANS] = writer.Offset();
+    for(size_t i = 0; i < SHARD_COUNT; i++)
+    {
+        for(const auto &entry : user_shards[i].users)
+        {
+            for(const shared_ptr<Book> &book : entry.second->GetBorrowedBooks())
+            {
+                book_handle_t slot = book->GetBookSlot();
+                writer.Write(&slot, sizeof(slot));
+            }
+        }
+    }
+    writer.Align();
+    header.section_sizes[SECTION_LOANS] = writer.Offset() - header.section_offsets[SECTION_LOANS];
+
+    // Search indexes
+    const PostingIndex *indexes[3] = {&title_index.GetTerms(), &author_index, &genre_index};
+    for(int i = 0; i < 3; i++)
+    {
+        header.section_offsets[SECTION_TITLE_TERMS + i] = writer.Offset();
+        WriteTerms(writer, *indexes[i], strings);
+        header.section_sizes[SECTION_TITLE_TERMS + i] = writer.Offset() - header.section_offsets[SECTION_TITLE_TERMS + i];
+    }
+
+    // Listing orders, saved so a load does not sort the catalogue again
+    const OrderedBookIndex *orders[2] = {&title_order, &isbn_order};
+    for(int i = 0; i < 2; i++)
+    {
+        header.section_offsets[SECTION_TITLE_ORDER + i] = writer.Offset();
+        vector<book_handle_t> handles = orders[i]->GetHandles();
+        writer.Write(handles.data(), handles.size() * sizeof(book_handle_t));
+        writer.Align();
+        header.section_sizes[SECTION_TITLE_ORDER + i] = writer.Offset() - header.section_offsets[SECTION_TITLE_ORDER + i];
+    }
+
+    // Strings
+    header.section_offsets[SECTION_STRINGS] = writer.Offset();
+    writer.Write(strings.data(), strings.size());
+    header.section_sizes[SECTION_STRINGS] = strings.size();
+    header.file_size = writer.Offset();
+
+    // Rewrite the header, flush the file to disk and move it over the target
+    bool written = writer.Finish() && pwrite(fd, &header, sizeof(header), 0) == static_cast<ssize_t>(sizeof(header));
+    written = written && fsync(fd) == 0;
+    written = (close(fd) == 0) && written;
+    if(!written || rename(temp_path.c_str(), path.c_str()) != 0)
+    {
+        unlink(temp_path.c_str());
+        return SNAPSHOT_NOT_OPENED;
+    }
+
+    // Make the rename itself durable
+    size_t slash = path.find_last_of('/');
+    string directory = (slash == string::npos) ? "." : (slash == 0 ? "/" : path.substr(0, slash));
+    int directory_fd = open(directory.c_str(), O_RDONLY);
+    if(directory_fd >= 0)
+    {
+        fsync(directory_fd);
+        close(directory_fd);
+    }
+
+    return SNAPSHOT_SAVED;
+}
+
+/**
+ * @brief Checks that a section lies inside the file and holds a whole number of records.
+ *
+ * @param header The header of the snapshot.
+ * @param section The section to check.
+ * @param minimum The minimum size of the section.
+ * @return true if the section can be read.
+*/
+static bool SectionFits(const SnapshotHeader &header, int section, uint64_t minimum)
+{
+    uint64_t offset = header.section_offsets[section];
+    uint64_t size = header.section_sizes[section];
+    return offset % 8 == 0 && size >= minimum && offset <= header.file_size && size <= header.file_size - offset;
+}
+
+/**
+ * @brief Restores a posting index from a section of a snapshot.
+ *
+ * @param data The start of the mapped file.
+ * @param header The header of the snapshot.
+ * @param section The section holding the index.
+ * @param strings The string section.
+ * @param slot_count The number of slots, every handle must lie below it.
+ * @param index The index to fill.
+ * @return false if the section is corrupted.
+*/
+static bool ReadTerms(const char *data, const SnapshotHeader &header, int section, string_view strings,
+                      uint64_t slot_count, PostingIndex &index)
+{
+    if(!SectionFits(header, section, sizeof(uint64_t)))
+    {
+        return false;
+    }
+    const char *base = data + header.section_offsets[section];
+    uint64_t size = header.section_sizes[section];
+
+    uint64_t term_count;
+    memcpy(&term_count, base, sizeof(term_count));
+    if(term_count > (size - sizeof(uint64_t)) / sizeof(SnapshotTerm))
+    {
+        return false;
+    }
+    const char *terms = base + sizeof(uint64_t);
+    const char *handles = terms + term_count * sizeof(SnapshotTerm);
+    uint64_t handle_count = (base + size - handles) / sizeof(book_handle_t);
+
+    index.Reserve(term_count);
+    vector<book_handle_t> list;
+    for(uint64_t i = 0; i < term_count; i++)
+    {
+        SnapshotTerm term;
+        memcpy(&term, terms + i * sizeof(SnapshotTerm), sizeof(term));
+        if(term.term_offset > strings.size() || term.term_length > strings.size() - term.term_offset ||
+           term.first_posting > handle_count || term.posting_count > handle_count - term.first_posting)
+        {
+            return false;
+        }
+
+        // Copy the handles out of the mapping, which needs not be aligned for them
+        list.resize(term.posting_count);
+        memcpy(list.data(), handles + term.first_posting * sizeof(book_handle_t), term.posting_count * sizeof(book_handle_t));
+        for(book_handle_t handle : list)
+        {
+            if(handle >= slot_count)
+            {
+                return false;
+            }
+        }
+        index.LoadPostings(string(strings.substr(term.term_offset, term.term_length)), list.data(), list.size());
+    }
+
+    return true;
+}
+
+/**
+ * @brief Replaces the state of the library with a snapshot.
+ *
+ * The file is memory-mapped and its fixed-size records are read in place: the strings are
+ * copied straight from the mapping and the search indexes are restored list by list, so no
+ * title is tokenized again. The snapshot is restored into a scratch library first, and swapped
+ * in under the locks only once it is whole, so a rejected snapshot leaves the library as it was.
+ * The attached log, if any, is emptied along with the swap.
+ *
+ * @param path The path of the snapshot file.
+ * @return snapshot_handling_t Enumeration value indicating the result of the operation.
+*/
+snapshot_handling_t Library::LoadSnapshot(const string &path)
+{
+    // Map the whole file
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+    {
+        return SNAPSHOT_NOT_OPENED;
+    }
+    struct stat info;
+    if(fstat(fd, &info) != 0)
+    {
+        close(fd);
+        return SNAPSHOT_NOT_OPENED;
+    }
+    size_t size = static_cast<size_t>(info.st_size);
+    if(size < sizeof(SnapshotHeader))
+    {
+        close(fd);
+        return SNAPSHOT_CORRUPTED;
+    }
+    void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(mapping == MAP_FAILED)
+    {
+        return SNAPSHOT_NOT_OPENED;
+    }
+    madvise(mapping, size, MADV_WILLNEED);
+
+    // Restore the snapshot aside, its books and users are constructed in the arena of this library
+    Library staged;
+    staged.arena = arena;
+    snapshot_handling_t result = staged.RestoreSnapshot(static_cast<const char *>(mapping), size);
+    munmap(mapping, size);
+    if(result != SNAPSHOT_LOADED)
+    {
+        return result;
+    }
+
+    // Take every lock of the library, in the usual order, and swap the restored state in
+    {
+        unique_lock<shared_mutex> catalogue_guard(catalogue_lock);
+        vector<unique_lock<shared_mutex>> guards;
+        guards.reserve(2 * SHARD_COUNT);
+        for(size_t i = 0; i < SHARD_COUNT; i++)
+        {
+            guards.emplace_back(user_shards[i].lock);
+        }
+        for(size_t i = 0; i < SHARD_COUNT; i++)
+        {
+            guards.emplace_back(book_shards[i].lock);
+        }
+        SwapContents(staged);
+
+        // The records of the log describe the replaced state, replaying them over this one would be wrong
+        if(log != nullptr)
+        {
+            log->Truncate();
+        }
+    }
+
+    // The previous state is destroyed with the scratch library, once the locks are released
+    return result;
+}
+
+/**
+ * @brief Restores a mapped snapshot into this library, which is empty and not shared yet.
+ *
+ * @param data The content of the snapshot file.
+ * @param size The size of the snapshot file.
+ * @return snapshot_handling_t SNAPSHOT_LOADED, or the reason the snapshot is rejected.
+*/
+snapshot_handling_t Library::RestoreSnapshot(const char *data, size_t size)
+{
+
+    // Check the header before reading any section
+    SnapshotHeader header;
+    memcpy(&header, data, sizeof(header));
+    snapshot_handling_t result = SNAPSHOT_LOADED;
+    if(memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 || header.file_size != size)
+    {
+        result = SNAPSHOT_CORRUPTED;
+    }
+    else if(header.version != SNAPSHOT_VERSION || header.header_size != sizeof(SnapshotHeader))
+    {
+        result = SNAPSHOT_OLD_VERSION;
+    }
+    else if(header.book_count > size / sizeof(SnapshotBook) || header.user_count > size / sizeof(SnapshotUser) ||
+            header.loan_count > size / sizeof(book_handle_t) || !SectionFits(header, SECTION_STRINGS, 0) ||
+            !SectionFits(header, SECTION_BOOKS, header.book_count * sizeof(SnapshotBook)) ||
+            !SectionFits(header, SECTION_USERS, header.user_count * sizeof(SnapshotUser)) ||
+            !SectionFits(header, SECTION_LOANS, header.loan_count * sizeof(book_handle_t)) ||
+            !SectionFits(header, SECTION_TITLE_ORDER, header.book_count * sizeof(book_handle_t)) ||
+            !SectionFits(header, SECTION_ISBN_ORDER, header.book_count * sizeof(book_handle_t)) ||
+            header.book_count > header.slot_count || header.slot_count > UINT32_MAX)
+    {
+        result = SNAPSHOT_CORRUPTED;
+    }
+    if(result != SNAPSHOT_LOADED)
+    {
+        return result;
+    }
+
+    // Nobody else sees this library yet, so it is filled without taking its locks.
+    // The tables are sized by the highest slot of a book rather than by the header, which a damaged
+    // file could make huge: the empty slots above every book are simply never allocated.
+    const char *books = data + header.section_offsets[SECTION_BOOKS];
+    uint64_t slot_count = 0;
+    for(uint64_t i = 0; i < header.book_count; i++)
+    {
+        uint32_t slot;
+        memcpy(&slot, books + i * sizeof(SnapshotBook) + offsetof(SnapshotBook, slot), sizeof(slot));
+        if(slot >= header.slot_count)
+        {
+            return SNAPSHOT_CORRUPTED;
+        }
+        slot_count = max(slot_count, static_cast<uint64_t>(slot) + 1);
+    }
+
+    string_view strings(data + header.section_offsets[SECTION_STRINGS], header.section_sizes[SECTION_STRINGS]);
+    auto fits = [&strings](uint64_t offset, uint32_t length)
+    {
+        return offset <= strings.size() && length <= strings.size() - offset;
+    };
+
+    // Reserve every table for the whole snapshot
+    book_slots.resize(slot_count);
+    catalogue.Reserve(slot_count);
+    for(size_t i = 0; i < SHARD_COUNT; i++)
+    {
+        book_shards[i].books.reserve(header.book_count / SHARD_COUNT + header.book_count / (4 * SHARD_COUNT) + 16);
+        user_shards[i].users.reserve(header.user_count / SHARD_COUNT + header.user_count / (4 * SHARD_COUNT) + 16);
+    }
+
+    // The books saved as on loan, each must be claimed by exactly one loan of a user below
+    vector<bool> saved_on_loan(slot_count, false);
+    uint64_t on_loan_count = 0;
+
+    // Books, constructed from the strings of the mapping
+    for(uint64_t i = 0; i < header.book_count && result == SNAPSHOT_LOADED; i++)
+    {
+        SnapshotBook record;
+        memcpy(&record, books + i * sizeof(SnapshotBook), sizeof(record));
+        if(record.slot >= slot_count || book_slots[record.slot] != nullptr ||
+           !fits(record.title_offset, record.title_length) || !fits(record.author_offset, record.author_length) ||
+           !fits(record.gener_offset, record.gener_length) || !fits(record.isbn_offset, record.isbn_length))
+        {
+            result = SNAPSHOT_CORRUPTED;
+            break;
+        }
+
+        string isbn(strings.substr(record.isbn_offset, record.isbn_length));
+        IsbnKey key = IsbnKey::FromString(isbn);
+        auto inserted = ShardOf(key).books.emplace(key, nullptr);
+        if(!key.IsValid() || !inserted.second)
+        {
+            result = SNAPSHOT_CORRUPTED;
+            break;
+        }
+
+        inserted.first->second = allocate_shared<Book>(ArenaAllocator<Book>(arena),
+                                                       string(strings.substr(record.title_offset, record.title_length)),
+                                                       string(strings.substr(record.author_offset, record.author_length)),
+                                                       string(strings.substr(record.gener_offset, record.gener_length)),
+                                                       std::move(isbn));
+        const shared_ptr<Book> &book = inserted.first->second;
+        book->SetBookSlot(record.slot);
+        book_slots[record.slot] = book;
+        catalogue.StoreBook(record.slot, *book);
+        if(record.available == 0)
+        {
+            // Left available until the loan below claims it for its borrower
+            saved_on_loan[record.slot] = true;
+            on_loan_count++;
+        }
+    }
+
+    // Listing orders, every saved slot must hold a book and every book must be listed once
+    OrderedBookIndex *orders[2] = {&title_order, &isbn_order};
+    for(int i = 0; i < 2 && result == SNAPSHOT_LOADED; i++)
+    {
+        vector<book_handle_t> handles(header.book_count);
+        memcpy(handles.data(), data + header.section_offsets[SECTION_TITLE_ORDER + i], handles.size() * sizeof(book_handle_t));
+        for(book_handle_t slot : handles)
+        {
+            if(slot >= slot_count || book_slots[slot] == nullptr)
+            {
+                result = SNAPSHOT_CORRUPTED;
+                break;
+            }
+        }
+        if(result == SNAPSHOT_LOADED)
+        {
+            orders[i]->Load(handles.data(), handles.size());
+            if(orders[i]->Size() != header.book_count)
+            {
+                result = SNAPSHOT_CORRUPTED;
+            }
+        }
+    }
+
+    // The slots left empty by removed books are reused first
+    for(book_handle_t slot = static_cast<book_handle_t>(slot_count); slot-- > 0 && result == SNAPSHOT_LOADED;)
+    {
+        if(book_slots[slot] == nullptr)
+        {
+            free_book_slots.push_back(slot);
+        }
+    }
+
+    // Users and their loans
+    const char *users = data + header.section_offsets[SECTION_USERS];
+    const char *loans = data + header.section_offsets[SECTION_LOANS];
+    for(uint64_t i = 0; i < header.user_count && result == SNAPSHOT_LOADED; i++)
+    {
+        SnapshotUser record;
+        memcpy(&record, users + i * sizeof(SnapshotUser), sizeof(record));
+        UserShard &shard = ShardOf(static_cast<int>(record.id));
+        if(!fits(record.name_offset, record.name_length) || record.first_loan > header.loan_count ||
+           record.loan_count > header.loan_count - record.first_loan)
+        {
+            result = SNAPSHOT_CORRUPTED;
+            break;
+        }
+        auto inserted = shard.users.emplace(record.id, nullptr);
+        if(!inserted.second)
+        {
+            result = SNAPSHOT_CORRUPTED;
+            break;
+        }
+
+        User *user = new (arena->Allocate(sizeof(User))) User(string(strings.substr(record.name_offset, record.name_length)), record.id);
+        ArenaDeleter<User> deleter;
+        deleter.arena = arena.get();
+        inserted.first->second = unique_ptr<User, ArenaDeleter<User>>(user, deleter);
+
+        for(uint64_t j = 0; j < record.loan_count; j++)
+        {
+            book_handle_t slot;
+            memcpy(&slot, loans + (record.first_loan + j) * sizeof(book_handle_t), sizeof(slot));
+            if(slot >= slot_count || book_slots[slot] == nullptr)
+            {
+                result = SNAPSHOT_CORRUPTED;
+                break;
+            }
+
+            // Only a book saved as on loan can be lent, and the claim fails if another user has it
+            const shared_ptr<Book> &book = book_slots[slot];
+            if(!saved_on_loan[slot] || user->UserBorrowBook(book) == FALSE)
+            {
+                result = SNAPSHOT_CORRUPTED;
+                break;
+            }
+
+            // Claimed for the saved borrower, in the saved order, mirror it in the catalogue
+            catalogue.SetAvailability(slot, false);
+            on_loan_count--;
+        }
+    }
+
+    // A book saved as on loan that no user holds could never be returned
+    if(result == SNAPSHOT_LOADED && on_loan_count != 0)
+    {
+        result = SNAPSHOT_CORRUPTED;
+    }
+
+    // Search indexes
+    if(result == SNAPSHOT_LOADED &&
+       (!ReadTerms(data, header, SECTION_TITLE_TERMS, strings, slot_count, title_index.GetTerms()) ||
+        !ReadTerms(data, header, SECTION_AUTHOR_TERMS, strings, slot_count, author_index) ||
+        !ReadTerms(data, header, SECTION_GENRE_TERMS, strings, slot_count, genre_index)))
+    {
+        result = SNAPSHOT_CORRUPTED;
+    }
+
+    // The trigram index is not saved, its vocabulary is rebuilt from the titles and authors
+    if(result == SNAPSHOT_LOADED)
+    {
+        for(book_handle_t slot = 0; slot < book_slots.size(); slot++)
+        {
+            if(book_slots[slot] != nullptr)
+            {
+                fuzzy_index.AddBook(slot, book_slots[slot]->GetBookName(), book_slots[slot]->GetBookAuthor());
+            }
+        }
+    }
+
+    return result;
+}
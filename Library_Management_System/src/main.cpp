@@ -1,9 +1,14 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <fstream>
+#include <cerrno>
+#include <unistd.h>
 #include "library.hpp"
 #include "user.hpp"
 #include "book.hpp"
+#include "catalogue_loader.hpp"
+#include "write_ahead_log.hpp"
 
 
 using namespace std;
@@ -15,31 +20,79 @@ using namespace std;
  * interface for interacting with the library system. Users can add, remove, register, display, 
  * borrow, and return books and users through this interface.
  * 
+ * When a snapshot path is given, the library is restored from it at startup (instead of the
+ * sample books) and saved back to it on exit. Every change made in between is also recorded
+ * in a write-ahead log next to the snapshot, replayed at startup if the application stopped
+ * before saving. A snapshot that exists but can't be loaded is never written over, nor is its
+ * log replayed or truncated, so it can still be recovered by hand.
+ * 
+ * @param argc The number of command-line arguments.
+ * @param argv The command-line arguments, optionally the path of the snapshot file.
  * @return int Exit status of the application (0 for success).
  */
 
-int main(void)
+int main(int argc, char **argv)
 {
+    // The log of the changes since the last snapshot, it outlives the library it is attached to.
+    WriteAheadLog wal;
+
     // Creates an instance of the Library class to manage the books and users.
     Library library;
 
-    // Creating instances of Book with sample data.
-    Book *b_1 = new Book("LinearAlgebra", "Dr. yasser", "Mathematics", "123qwe");
-    // Book *b_2 = new Book("Calculus", "Dr. Mohamed", "Mathematics", "asd123");
-    Book *b_3 = new Book("Geometry", "Dr. bryan", "Mathematics", "173-813");
-    Book *b_4 = new Book("Electromagnetism", "Dr. Ahmed", "Physics", "482-423");
-    Book *b_5 = new Book("Anatomy", "Dr. magdy", "Medicine", "213-83");
-    // Book *b_6 = new Book("The law ", "Dr. Peter", "Law", "222-33");
-    // Book *b_7 = new Book("Football", "Dr. naser", "Sports", "11-255");
-
-    // Adding books to the library.
-    library.AddNewBookToLibrary(b_1);
-    // library.AddNewBookToLibrary(b_2);
-    library.AddNewBookToLibrary(b_3);
-    library.AddNewBookToLibrary(b_4);
-    library.AddNewBookToLibrary(b_5);
-    // library.AddNewBookToLibrary(b_6);
-    // library.AddNewBookToLibrary(b_7);
+    // The snapshot the library is restored from and saved to, if any.
+    string snapshot_path = (argc > 1) ? argv[1] : "";
+
+    // The snapshot left untouched because it exists but can't be loaded, if any.
+    string kept_snapshot;
+
+    snapshot_handling_t loaded = snapshot_path.empty() ? SNAPSHOT_NOT_OPENED : library.LoadSnapshot(snapshot_path);
+    if(loaded != SNAPSHOT_LOADED && !snapshot_path.empty() && (access(snapshot_path.c_str(), F_OK) == 0 || errno != ENOENT))
+    {
+        // Only a missing snapshot starts afresh, a damaged one and its log are kept for recovery.
+        cout << "the snapshot " << snapshot_path << " can't be loaded, it and its log are left untouched\n";
+        kept_snapshot = snapshot_path;
+        snapshot_path.clear();
+    }
+
+    if(loaded != SNAPSHOT_LOADED)
+    {
+        // Constructing the sample books in place inside the library.
+        library.EmplaceBook("LinearAlgebra", "Dr. yasser", "Mathematics", "123qwe");
+        // library.EmplaceBook("Calculus", "Dr. Mohamed", "Mathematics", "asd123");
+        library.EmplaceBook("Geometry", "Dr. bryan", "Mathematics", "173-813");
+        library.EmplaceBook("Electromagnetism", "Dr. Ahmed", "Physics", "482-423");
+        library.EmplaceBook("Anatomy", "Dr. magdy", "Medicine", "213-83");
+        // library.EmplaceBook("The law ", "Dr. Peter", "Law", "222-33");
+        // library.EmplaceBook("Football", "Dr. naser", "Sports", "11-255");
+    }
+
+    // Replay the changes made after the snapshot was saved, then record the next ones.
+    if(!snapshot_path.empty())
+    {
+        if(wal.Open(snapshot_path + ".wal"))
+        {
+            size_t replayed = wal.Replay(library);
+            if(replayed != 0)
+            {
+                cout << replayed << " changes recovered from the log\n";
+            }
+            if(wal.IsHealthy())
+            {
+                library.AttachLog(&wal);
+            }
+            else
+            {
+                // A log this version can't read is kept for recovery, along with its snapshot.
+                cout << "the log of " << snapshot_path << " can't be read, it and the snapshot are left untouched\n";
+                kept_snapshot = snapshot_path;
+                snapshot_path.clear();
+            }
+        }
+        else
+        {
+            cout << "the log can't be opened, changes won't survive a crash\n";
+        }
+    }
 
     
     bool run = true; // Flag to control the main loop of the application.
@@ -69,6 +122,14 @@ int main(void)
         cout << "7. Borrow a book\n";
         cout << "8. Return a book\n";
         cout << "9. Search for a book\n";
+        cout << "10. Display inventory statistics\n";
+        cout << "11. Find the borrower of a book\n";
+        cout << "12. Import books from a CSV/TSV file\n";
+        cout << "13. Save a snapshot of the library\n";
+        cout << "14. Load a snapshot of the library\n";
+        cout << "15. Export the books or users to a file\n";
+        cout << "16. List the books page by page\n";
+        cout << "17. Display the operation statistics\n";
         cout << "0. Exit\n";
         cout << "------------------------------------------\n";
         cout << "Enter your choice: ";
@@ -89,14 +150,20 @@ int main(void)
                 cout << "enter the book ISBN: ";
                 cin  >> b_ISBN; 
 
-                Book *b_ptr = new Book(b_name, b_author, b_gener, b_ISBN); 
-
-                add_handling_t ret_val = library.AddNewBookToLibrary(b_ptr);
+                add_handling_t ret_val = library.EmplaceBook(b_name, b_author, b_gener, b_ISBN);
 
                 if(ret_val == ADDED_SUCCESSFULLY)
                 {
                     cout << "The book is added successfully to the library!\n";
                 }
+                else if(ret_val == ADDED_NOT_DURABLE)
+                {
+                    cout << "The book is added, but it could not be saved to the log\n";
+                }
+                else if(ret_val == INVALID_ISBN)
+                {
+                    cout << "The serial number is not a valid ISBN-10/ISBN-13 nor a local serial (up to 15 characters)\n";
+                }
                 else
                 {
                     cout << "The book is already exist with the same serial number\n";
@@ -112,6 +179,10 @@ int main(void)
                 {
                     cout << "The book is removed successfully!\n";
                 }
+                else if(ret_val == REMOVED_NOT_DURABLE)
+                {
+                    cout << "The book is removed, but the removal could not be saved to the log\n";
+                }
                 else
                 {
                     cout << "the serial number of the book is not even exist\n";
@@ -125,13 +196,15 @@ int main(void)
                 cout << "enter the user id: ";
                 cin >> u_id;
 
-                User *u_ptr = new User(u_name, u_id);
-                
-                add_handling_t ret_val = library.RegisterNewUser(u_ptr);
+                add_handling_t ret_val = library.EmplaceUser(u_name, u_id);
                 if(ret_val == ADDED_SUCCESSFULLY)
                 {
                     cout << "The user is registered successfully!\n";
                 }
+                else if(ret_val == ADDED_NOT_DURABLE)
+                {
+                    cout << "The user is registered, but it could not be saved to the log\n";
+                }
                 else
                 {
                     cout << "Sorry this id is already taken please choose another one \n";
@@ -147,6 +220,10 @@ int main(void)
                 {
                     cout << "The user is removed successfully!\n";
                 }
+                else if(ret_val == REMOVED_NOT_DURABLE)
+                {
+                    cout << "The user is removed, but the removal could not be saved to the log\n";
+                }
                 else
                 {
                     cout << "this user id is not registered\n";
@@ -155,12 +232,34 @@ int main(void)
             }
            case 5: // Display all books in the library.
             {
-                library.DisplayAllBooks();
+                // Counter for displaying book numbers.
+                int number = 1;
+
+                for(const shared_ptr<Book> &book : library.GetAllBooks())
+                {
+                    cout << "==============================================\n";
+                    cout << "the book number "<< number++ << " details\n";
+                    cout << "==============================================\n";
+                    cout << "book_ISBN: " << book->GetBookNumber() << "\n" << "book_name: " << book->GetBookName()
+                    << "\n" << "book_category: " << book->GetBookGener() << "\n" << "book_auther: " << book->GetBookAuthor()
+                    << "\n" << "book_availability: " << book->GetBookAvailability() << "\n";
+                    cout << "==============================================\n";
+                }
                 break;
             } 
             case 6: // Display all users registered in the library.
             {
-                library.DisplayAllUsers();
+                // Counter for displaying user numbers.
+                int number = 1;
+
+                for(User *user : library.GetAllUsers())
+                {
+                    cout << "==============================================\n";
+                    cout << "the user number "<< number++ << " details\n";
+                    cout << "==============================================\n";
+                    cout << "user_id: "<< user->GetUserId() << "\n" << "user_name: " << user->GetUserName() << "\n";
+                    cout << "==============================================\n";
+                }
                 break;
             }
             case 7: // Borrow a book from the library.
@@ -170,7 +269,28 @@ int main(void)
                 cout << "enter the book serial number: ";
                 cin  >> b_ISBN;
 
-                library.UserBorrowBook(u_id, b_ISBN);                 
+                loan_status_t ret_val = library.UserBorrowBook(u_id, b_ISBN);
+
+                if(ret_val == LOAN_SUCCEEDED)
+                {
+                    cout << "The book is borrowed successfully!\n";
+                }
+                else if(ret_val == LOAN_NOT_DURABLE)
+                {
+                    cout << "The book is borrowed, but the loan could not be saved to the log\n";
+                }
+                else if(ret_val == LOAN_NOT_AVAILABLE)
+                {
+                    cout << "Fail!! This book is already borrowed and not available\n";
+                }
+                else if(ret_val == LOAN_UNKNOWN_BOOK)
+                {
+                    cout << "Failed!! There is no book with that serial in the library\n";
+                }
+                else
+                {
+                    cout << "invalid id!! this user isn't registed in the library\n";
+                }
                 break;
             }
             case 8: // Return a book to the library.
@@ -180,15 +300,288 @@ int main(void)
                 cout << "enter the book serial number: ";
                 cin  >> b_ISBN;
 
-                library.UserReturnBook(u_id, b_ISBN);
+                loan_status_t ret_val = library.UserReturnBook(u_id, b_ISBN);
+
+                if(ret_val == LOAN_SUCCEEDED)
+                {
+                    cout << "The book is returned successfully!\n";
+                }
+                else if(ret_val == LOAN_NOT_DURABLE)
+                {
+                    cout << "The book is returned, but the return could not be saved to the log\n";
+                }
+                else if(ret_val == LOAN_NOT_BORROWED)
+                {
+                    cout << "Sorry!! this user doesn't even borrow this book\n";
+                }
+                else if(ret_val == LOAN_UNKNOWN_BOOK)
+                {
+                    cout << "Failed!! There is no book with that serial in the library\n";
+                }
+                else
+                {
+                    cout << "invalid id!! this user isn't registed in the library\n";
+                }
                 break;
             }
-            case 9:
+            case 9: // Search for books by title, author or genre.
             {
+                int search_by = 0;
+                cout << "search by 1. title 2. author 3. category 4. category and author initials 5. partial or misspelled title or author: ";
+                cin  >> search_by;
+
+                vector<shared_ptr<Book>> found;
+                if(search_by == 1)
+                {
+                    cout << "enter the book title: ";
+                    cin  >> b_name;
+                    found = library.SearchForBooks(b_name);
+                }
+                else if(search_by == 2)
+                {
+                    cout << "enter the book author: ";
+                    getline(cin >> ws, b_author);
+                    found = library.SearchForBooksByAuthor(b_author);
+                }
+                else if(search_by == 3)
+                {
+                    cout << "enter the book category: ";
+                    cin  >> b_gener;
+                    found = library.SearchForBooksByGenre(b_gener);
+                }
+                else if(search_by == 4)
+                {
+                    BookQuery query;
+                    int only_available = 0;
+
+                    cout << "enter the book category: ";
+                    cin  >> query.genre;
+                    cout << "enter the beginning of the author name: ";
+                    getline(cin >> ws, query.author_prefix);
+                    cout << "only the available books? (1 yes / 0 no): ";
+                    cin  >> only_available;
+
+                    query.availability = only_available ? ONLY_AVAILABLE : ANY_AVAILABILITY;
+                    found = library.QueryBooks(query);
+                }
+                else if(search_by == 5)
+                {
+                    string words;
+                    cout << "enter a part of the title or author: ";
+                    getline(cin >> ws, words);
+                    found = library.FuzzySearchBooks(words);
+                }
+
+                if(found.empty())
+                {
+                    cout << "There is no book matching your search in the library\n";
+                }
+
+                // Display the details of every matching book.
+                for(const shared_ptr<Book> &book : found)
+                {
+                    cout << "==============================================\n";
+                    cout << "book_ISBN: " << book->GetBookNumber() << "\n" << "book_name: " << book->GetBookName()
+                    << "\n" << "book_category: " << book->GetBookGener() << "\n" << "book_auther: " << book->GetBookAuthor()
+                    << "\n" << "book_availability: " << book->GetBookAvailability() << "\n";
+                    cout << "==============================================\n";
+                }
                 break;
             } 
+            case 10: // Display the inventory counters of the library.
+            {
+                cout << "books available: " << library.CountAvailableBooks() << "\n";
+                cout << "books on loan: " << library.CountBorrowedBooks() << "\n";
+
+                // Display the counters of every genre.
+                for(const auto &genre : library.GetInventoryByGenre())
+                {
+                    cout << genre.first << ": " << genre.second.available << " available out of "
+                    << genre.second.total << "\n";
+                }
+                break;
+            }
+            case 11: // Find the user holding a book.
+            {
+                cout << "enter the serial number of the book: ";
+                cin >> b_ISBN;
+
+                if(library.FindBookBorrower(b_ISBN, u_id))
+                {
+                    cout << "the book is on loan to the user with id " << u_id << "\n";
+                }
+                else
+                {
+                    cout << "the book is not on loan or doesn't exist\n";
+                }
+                break;
+            }
+            case 12: // Import the books of a catalogue file.
+            {
+                string path;
+                cout << "enter the path of the file: ";
+                getline(cin >> ws, path);
+
+                CatalogueLoader loader;
+                load_report_t report;
+                load_handling_t ret_val = loader.LoadFile(path, library, report);
+                if(ret_val == LOADED_SUCCESSFULLY || ret_val == LOADED_NOT_DURABLE)
+                {
+                    cout << report.imported << " books imported out of " << report.records << " records ("
+                    << report.rejected << " rejected) in " << report.seconds << " s, "
+                    << static_cast<size_t>(report.records_per_second) << " records/sec\n";
+                    if(ret_val == LOADED_NOT_DURABLE)
+                    {
+                        cout << "the imported books could not be saved to the log\n";
+                    }
+                }
+                else
+                {
+                    cout << "the file can't be read\n";
+                }
+                break;
+            }
+            case 13: // Save the state of the library.
+            {
+                string path;
+                cout << "enter the path of the snapshot: ";
+                getline(cin >> ws, path);
+
+                if(!kept_snapshot.empty() && path == kept_snapshot)
+                {
+                    // The snapshot that failed to load may still be recovered, never write over it.
+                    cout << "the snapshot couldn't be loaded at startup, it is left untouched\n";
+                }
+                else
+                {
+                    // The startup snapshot is checkpointed, so the log is emptied with it.
+                    snapshot_handling_t ret_val = (path == snapshot_path) ? library.Checkpoint(path) : library.SaveSnapshot(path);
+                    cout << ((ret_val == SNAPSHOT_SAVED) ? "The snapshot is saved successfully!\n" : "the snapshot can't be written\n");
+                }
+                break;
+            }
+            case 14: // Restore the state of the library.
+            {
+                string path;
+                cout << "enter the path of the snapshot: ";
+                getline(cin >> ws, path);
+
+                snapshot_handling_t ret_val = library.LoadSnapshot(path);
+                if(ret_val == SNAPSHOT_LOADED)
+                {
+                    // The log was emptied with the load, the startup snapshot must hold the new state.
+                    if(!snapshot_path.empty() && library.Checkpoint(snapshot_path) != SNAPSHOT_SAVED)
+                    {
+                        cout << "the snapshot " << snapshot_path << " can't be written\n";
+                    }
+                    cout << "The snapshot is loaded successfully!\n";
+                }
+                else if(ret_val == SNAPSHOT_NOT_OPENED)
+                {
+                    cout << "the snapshot can't be read\n";
+                }
+                else if(ret_val == SNAPSHOT_OLD_VERSION)
+                {
+                    cout << "the snapshot was written by an incompatible version\n";
+                }
+                else
+                {
+                    cout << "the snapshot is corrupted, the library is left unchanged\n";
+                }
+                break;
+            }
+            case 15: // Export the books or users of the library.
+            {
+                int what = 0, format = 0;
+                string path;
+                cout << "export 1. books 2. users: ";
+                cin  >> what;
+                cout << "format 1. text 2. CSV 3. JSON lines 4. binary: ";
+                cin  >> format;
+                cout << "enter the path of the file: ";
+                getline(cin >> ws, path);
+
+                const export_format_t formats[] = {EXPORT_TEXT, EXPORT_CSV, EXPORT_JSONL, EXPORT_BINARY};
+                export_format_t chosen = (format >= 1 && format <= 4) ? formats[format - 1] : EXPORT_TEXT;
+
+                size_t exported = 0;
+                export_handling_t ret_val = (what == 2) ? library.ExportUsers(path, chosen, exported)
+                                                        : library.ExportBooks(path, chosen, exported);
+                if(ret_val == EXPORTED_SUCCESSFULLY)
+                {
+                    cout << exported << ((what == 2) ? " users" : " books") << " exported successfully!\n";
+                }
+                else if(ret_val == EXPORT_NOT_OPENED)
+                {
+                    cout << "the file can't be created\n";
+                }
+                else
+                {
+                    cout << "the file can't be written\n";
+                }
+                break;
+            }
+            case 16: // List the books sorted by title or serial number, one page at a time.
+            {
+                int order = 0, more = 1;
+                size_t page_size = 0;
+                cout << "sort by 1. title 2. serial number: ";
+                cin  >> order;
+                cout << "enter the number of books per page: ";
+                cin  >> page_size;
+
+                BookCursor cursor;
+                while(more == 1)
+                {
+                    BookPage page = library.ListBooks((order == 2) ? ORDER_BY_ISBN : ORDER_BY_TITLE, cursor, page_size);
+                    for(const shared_ptr<Book> &book : page.books)
+                    {
+                        cout << book->GetBookNumber() << "  " << book->GetBookName() << "  (" << book->GetBookAuthor()
+                        << ", " << book->GetBookGener() << ")" << (book->GetBookAvailability() ? "" : "  [borrowed]") << "\n";
+                    }
+                    if(!page.has_more)
+                    {
+                        break;
+                    }
+
+                    cursor = page.next;
+                    cout << "next page? (1 yes / 0 no): ";
+                    cin  >> more;
+                }
+                break;
+            }
+            case 17: // Display the counters and latencies of the operations, or write them for Prometheus.
+            {
+                int format = 0;
+                cout << "format 1. table 2. Prometheus file: ";
+                cin  >> format;
+
+                StatsSnapshot stats = library.Stats();
+                if(format != 2)
+                {
+                    stats.WriteText(cout);
+                    break;
+                }
+
+                string path;
+                cout << "enter the path of the file: ";
+                getline(cin >> ws, path);
+                ofstream out(path);
+                stats.WritePrometheus(out);
+                cout << (out ? "statistics written successfully!\n" : "the file can't be written\n");
+                break;
+            }
             case 0: // Exit the application.
             {
+                // Save the library back to its snapshot.
+                if(!snapshot_path.empty())
+                {
+                    // The snapshot now holds every logged change, the log is emptied with it.
+                    if(library.Checkpoint(snapshot_path) != SNAPSHOT_SAVED)
+                    {
+                        cout << "the snapshot can't be written\n";
+                    }
+                }
                 cout << "The system is turened off!\n";
                 run = false; // Set the flag to false to exit the main loop.
                 break;
@@ -199,14 +592,7 @@ int main(void)
         }
     }
 
-    // Clean up dynamically allocated Book objects.
-    delete b_1;
-    // delete b_2;
-    delete b_3;
-    delete b_4;
-    delete b_5;
-    // delete b_6;
-    // delete b_7;
+    // The books and users are owned by the library and released with it.
 
     // Return 0 to indicate successful completion of the application.
     return 0;
@@ -0,0 +1,114 @@
+#include <cstddef>
+#include <vector>
+#include <new>
+#include <mutex>
+#include "object_arena.hpp"
+
+using namespace std;
+
+/**
+ * @brief Releases every slab in one shot.
+*/
+ObjectArena::~ObjectArena()
+{
+    // Give every slab back to the system.
+    for(void *slab : slabs)
+    {
+        ::operator delete(slab);
+    }
+}
+
+/**
+ * @brief Allocates a block of memory.
+ *
+ * @param bytes The size of the block.
+ * @return Pointer to a block aligned for any fundamental type.
+*/
+void *ObjectArena::Allocate(size_t bytes)
+{
+    // Work with whole aligned blocks.
+    size_t size = RoundUp(bytes == 0 ? 1 : bytes);
+
+    lock_guard<mutex> guard(lock);
+
+    if(size > MAX_SMALL_BYTES)
+    {
+        // Large block: give it a dedicated slab.
+        void *block = ::operator new(size);
+        slabs.push_back(block);
+        reserved_bytes += size;
+        return block;
+    }
+
+    // Reuse a released block of the same size class if any.
+    FreeBlock *&free_list = free_lists[size / BLOCK_ALIGN];
+    if(free_list != nullptr)
+    {
+        FreeBlock *block = free_list;
+        free_list = block->next;
+        return block;
+    }
+
+    // Start a new slab when the current one is exhausted.
+    if(remaining < size)
+    {
+        cursor = static_cast<char *>(::operator new(SLAB_BYTES));
+        slabs.push_back(cursor);
+        remaining = SLAB_BYTES;
+        reserved_bytes += SLAB_BYTES;
+    }
+
+    // Bump allocate from the current slab.
+    void *block = cursor;
+    cursor += size;
+    remaining -= size;
+    return block;
+}
+
+/**
+ * @brief Gives a block back to the arena for reuse.
+ *
+ * @param block The block returned by Allocate().
+ * @param bytes The size the block was allocated with.
+*/
+void ObjectArena::Deallocate(void *block, size_t bytes)
+{
+    size_t size = RoundUp(bytes == 0 ? 1 : bytes);
+
+    if(block == nullptr || size > MAX_SMALL_BYTES)
+    {
+        // Large blocks keep their dedicated slab until the arena is destroyed.
+        return;
+    }
+
+    lock_guard<mutex> guard(lock);
+
+    // Push the block on the free list of its size class.
+    FreeBlock *node = static_cast<FreeBlock *>(block);
+    node->next = free_lists[size / BLOCK_ALIGN];
+    free_lists[size / BLOCK_ALIGN] = node;
+}
+
+/**
+ * @brief Gets the number of slabs obtained from the system.
+ *
+ * @return The number of slabs.
+*/
+size_t ObjectArena::SlabCount() const
+{
+    // Returns the number of slabs allocated so far.
+    lock_guard<mutex> guard(lock);
+    return slabs.size();
+}
+
+/**
+ * @brief Gets the number of bytes obtained from the system.
+ *
+ * @return The total size of the slabs.
+*/
+size_t ObjectArena::ReservedBytes() const
+{
+    // Returns the total size of the slabs.
+    lock_guard<mutex> guard(lock);
+    return reserved_bytes;
+}
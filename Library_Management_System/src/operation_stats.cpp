@@ -0,0 +1,296 @@
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <ostream>
+#include <iomanip>
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include "operation_stats.hpp"
+
+using namespace std;
+
+/* The names of the operations, as printed in the dumps. */
+static const char *const OPERATION_NAMES[STAT_OPERATION_COUNT] = {
+    "add_book", "remove_book", "register_user", "remove_user", "borrow", "return", "borrow_batch",
+    "return_batch", "search_title", "search_author", "search_genre", "search_fuzzy", "query", "list"};
+
+/* The names of the outcomes, as printed in the dumps. */
+static const char *const OUTCOME_NAMES[STAT_OUTCOME_COUNT] = {"hit", "miss", "rejected", "failed"};
+
+/* The percentiles of the dumps. */
+static const double DUMP_PERCENTILES[] = {0.5, 0.99, 0.999};
+
+/**
+ * @brief Gets the largest latency of a histogram bucket.
+*/
+uint64_t StatsSnapshot::BucketCeiling(size_t bucket)
+{
+    if(bucket < 32)
+    {
+        return bucket;
+    }
+
+    // The bucket covers a 32nd of the power of two it lies in
+    unsigned exponent = static_cast<unsigned>(bucket / 32) + 4;
+    uint64_t floor = (32 + bucket % 32) << (exponent - 5);
+    return floor + (uint64_t(1) << (exponent - 5)) - 1;
+}
+
+/**
+ * @brief Gets the name of an operation, as printed in the dumps.
+*/
+const char *StatsSnapshot::OperationName(stat_operation_t operation)
+{
+    return OPERATION_NAMES[operation];
+}
+
+/**
+ * @brief Gets the name of an outcome, as printed in the dumps.
+*/
+const char *StatsSnapshot::OutcomeName(stat_outcome_t outcome)
+{
+    return OUTCOME_NAMES[outcome];
+}
+
+/**
+ * @brief Gets the number of calls of an operation.
+*/
+uint64_t StatsSnapshot::GetCalls(stat_operation_t operation) const
+{
+    // Every call lands in one bucket, the outcomes of a batch count its requests
+    uint64_t calls = 0;
+    for(size_t bucket = 0; bucket < BUCKET_COUNT; bucket++)
+    {
+        calls += buckets[operation * BUCKET_COUNT + bucket];
+    }
+    return calls;
+}
+
+/**
+ * @brief Gets the mean latency of an operation in nanoseconds, 0 if never called.
+*/
+double StatsSnapshot::GetMeanLatency(stat_operation_t operation) const
+{
+    uint64_t calls = GetCalls(operation);
+    return (calls == 0) ? 0.0 : static_cast<double>(latency_sum[operation]) / static_cast<double>(calls);
+}
+
+/**
+ * @brief Gets a percentile of the latency of an operation.
+ *
+ * @param operation The operation.
+ * @param fraction The percentile as a fraction (0.99 for p99).
+ * @return uint64_t The latency in nanoseconds, rounded up to the end of its bucket; 0 if never called.
+*/
+uint64_t StatsSnapshot::GetLatencyPercentile(stat_operation_t operation, double fraction) const
+{
+    uint64_t calls = GetCalls(operation);
+    if(calls == 0)
+    {
+        return 0;
+    }
+
+    // The first bucket reaching the nearest rank of the percentile
+    uint64_t rank = static_cast<uint64_t>(ceil(fraction * static_cast<double>(calls)));
+    rank = min(max<uint64_t>(rank, 1), calls);
+    uint64_t seen = 0;
+    for(size_t bucket = 0; bucket < BUCKET_COUNT; bucket++)
+    {
+        seen += buckets[operation * BUCKET_COUNT + bucket];
+        if(seen >= rank)
+        {
+            return BucketCeiling(bucket);
+        }
+    }
+    return BucketCeiling(BUCKET_COUNT - 1);
+}
+
+/**
+ * @brief Writes a table of the operations called: counts by outcome, mean and percentiles.
+*/
+void StatsSnapshot::WriteText(ostream &out) const
+{
+    if(!enabled)
+    {
+        out << "The statistics are not compiled in (LIBRARY_STATS is off).\n";
+        return;
+    }
+
+    out << left << setw(15) << "operation" << right << setw(10) << "calls" << setw(10) << "hit" << setw(10) << "miss"
+        << setw(10) << "rejected" << setw(10) << "failed" << setw(10) << "mean" << setw(10) << "p50" << setw(10) << "p99" << setw(10) << "p999" << "  (ns)\n";
+    for(int i = 0; i < STAT_OPERATION_COUNT; i++)
+    {
+        stat_operation_t operation = static_cast<stat_operation_t>(i);
+        uint64_t calls = GetCalls(operation);
+        if(calls == 0)
+        {
+            continue;
+        }
+
+        out << left << setw(15) << OPERATION_NAMES[i] << right << setw(10) << calls;
+        for(int outcome = 0; outcome < STAT_OUTCOME_COUNT; outcome++)
+        {
+            out << setw(10) << outcomes[i][outcome];
+        }
+        out << setw(10) << static_cast<uint64_t>(GetMeanLatency(operation));
+        for(double fraction : DUMP_PERCENTILES)
+        {
+            out << setw(10) << GetLatencyPercentile(operation, fraction);
+        }
+        out << '\n';
+    }
+}
+
+/**
+ * @brief Writes the statistics in the Prometheus text exposition format.
+*/
+void StatsSnapshot::WritePrometheus(ostream &out) const
+{
+    out << "# HELP library_operations_total Library operations by outcome (requests for the batches).\n";
+    out << "# TYPE library_operations_total counter\n";
+    for(int i = 0; i < STAT_OPERATION_COUNT; i++)
+    {
+        for(int outcome = 0; outcome < STAT_OUTCOME_COUNT; outcome++)
+        {
+            out << "library_operations_total{operation=\"" << OPERATION_NAMES[i] << "\",outcome=\"" << OUTCOME_NAMES[outcome]
+                << "\"} " << outcomes[i][outcome] << '\n';
+        }
+    }
+
+    out << "# HELP library_operation_latency_seconds Latency of the library operations.\n";
+    out << "# TYPE library_operation_latency_seconds summary\n";
+    for(int i = 0; i < STAT_OPERATION_COUNT; i++)
+    {
+        stat_operation_t operation = static_cast<stat_operation_t>(i);
+        for(double fraction : DUMP_PERCENTILES)
+        {
+            out << "library_operation_latency_seconds{operation=\"" << OPERATION_NAMES[i] << "\",quantile=\"" << fraction
+                << "\"} " << GetLatencyPercentile(operation, fraction) * 1e-9 << '\n';
+        }
+        out << "library_operation_latency_seconds_sum{operation=\"" << OPERATION_NAMES[i] << "\"} " << latency_sum[i] * 1e-9 << '\n';
+        out << "library_operation_latency_seconds_count{operation=\"" << OPERATION_NAMES[i] << "\"} " << GetCalls(operation) << '\n';
+    }
+}
+
+#if defined(LIBRARY_STATS)
+
+/* The source of the serial numbers of the statistics. */
+static atomic<uint64_t> next_serial(1);
+
+/**
+ * @brief The block of the calling thread in the statistics it last recorded into.
+ */
+struct LocalStatsCache
+{
+    /* The serial number of the statistics, 0 for none. */
+    uint64_t serial = 0;
+    /* The block of the thread in them. */
+    void *block = nullptr;
+};
+
+/* The cache of the calling thread. */
+static thread_local LocalStatsCache local_cache;
+
+/**
+ * @brief Gets the length of a tick in nanoseconds, measured on the first call.
+*/
+double OperationClock::NanosecondsPerTick()
+{
+#if defined(__x86_64__)
+    // Count the ticks of a millisecond of steady_clock, once per process
+    static const double measured = []()
+    {
+        chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+        uint64_t first = Now();
+        chrono::steady_clock::time_point end = begin;
+        while(end - begin < chrono::milliseconds(1))
+        {
+            end = chrono::steady_clock::now();
+        }
+        uint64_t ticks = Now() - first;
+        double nanoseconds = static_cast<double>(chrono::duration_cast<chrono::nanoseconds>(end - begin).count());
+        return (ticks == 0) ? 1.0 : nanoseconds / static_cast<double>(ticks);
+    }();
+    return measured;
+#else
+    // The ticks are the periods of steady_clock
+    return 1e9 * chrono::steady_clock::period::num / chrono::steady_clock::period::den;
+#endif
+}
+
+/**
+ * @brief Constructs statistics with every count at zero.
+*/
+OperationStats::OperationStats() : serial(next_serial.fetch_add(1)), nanoseconds_per_tick(OperationClock::NanosecondsPerTick())
+{
+}
+
+/**
+ * @brief Gets the block of the calling thread, creating it on its first operation.
+*/
+OperationStats::ThreadStats &OperationStats::Local()
+{
+    if(local_cache.serial == serial)
+    {
+        return *static_cast<ThreadStats *>(local_cache.block);
+    }
+
+    // The first operation of the thread here, or since it used another library: a block per visit
+    // would grow without bound, so the blocks are looked up by thread
+    static thread_local vector<pair<uint64_t, ThreadStats *>> owned;
+    ThreadStats *block = nullptr;
+    for(const pair<uint64_t, ThreadStats *> &entry : owned)
+    {
+        if(entry.first == serial)
+        {
+            block = entry.second;
+        }
+    }
+    if(block == nullptr)
+    {
+        // Value-initialized, every counter starts at zero
+        unique_ptr<ThreadStats> created(new ThreadStats());
+        block = created.get();
+        lock_guard<mutex> guard(registry_lock);
+        threads.push_back(std::move(created));
+        owned.emplace_back(serial, block);
+    }
+
+    local_cache.serial = serial;
+    local_cache.block = block;
+    return *block;
+}
+
+/**
+ * @brief Sums the blocks of every thread.
+ *
+ * @return StatsSnapshot The counts, consistent per counter though not across counters
+ *         while operations run.
+*/
+StatsSnapshot OperationStats::Snapshot() const
+{
+    StatsSnapshot snapshot;
+    snapshot.enabled = true;
+
+    lock_guard<mutex> guard(registry_lock);
+    for(const unique_ptr<ThreadStats> &block : threads)
+    {
+        for(int i = 0; i < STAT_OPERATION_COUNT; i++)
+        {
+            for(int outcome = 0; outcome < STAT_OUTCOME_COUNT; outcome++)
+            {
+                snapshot.outcomes[i][outcome] += block->outcomes[i][outcome].load(memory_order_relaxed);
+            }
+            snapshot.latency_sum[i] += block->latency_sum[i].load(memory_order_relaxed);
+            for(size_t bucket = 0; bucket < StatsSnapshot::BUCKET_COUNT; bucket++)
+            {
+                snapshot.buckets[i * StatsSnapshot::BUCKET_COUNT + bucket] += block->buckets[i][bucket].load(memory_order_relaxed);
+            }
+        }
+    }
+    return snapshot;
+}
+
+#endif
@@ -0,0 +1,251 @@
+#include <string_view>
+#include <vector>
+#include <set>
+#include <algorithm>
+#include "ordered_book_index.hpp"
+
+using namespace std;
+
+/**
+ * @brief Compares two sort keys: negative, zero or positive as left sorts before, with or after right.
+*/
+int OrderedBookIndex::SlotOrder::Compare(string_view left_title, string_view left_isbn, string_view right_title, string_view right_isbn) const
+{
+    if(order == ORDER_BY_TITLE)
+    {
+        int by_title = left_title.compare(right_title);
+        if(by_title != 0)
+        {
+            return by_title;
+        }
+    }
+
+    // The serial numbers are unique, they break every tie
+    return left_isbn.compare(right_isbn);
+}
+
+bool OrderedBookIndex::SlotOrder::operator()(const OrderedSlot &left, const OrderedSlot &right) const
+{
+    // The prefixes settle the order unless the keys share their first 8 bytes
+    if(left.prefix != right.prefix)
+    {
+        return left.prefix < right.prefix;
+    }
+    return Compare(catalogue->GetTitle(left.slot), catalogue->GetISBN(left.slot),
+                   catalogue->GetTitle(right.slot), catalogue->GetISBN(right.slot)) < 0;
+}
+
+bool OrderedBookIndex::SlotOrder::operator()(const OrderedSlot &left, const CursorProbe &right) const
+{
+    if(left.prefix != right.prefix)
+    {
+        return left.prefix < right.prefix;
+    }
+    return Compare(catalogue->GetTitle(left.slot), catalogue->GetISBN(left.slot), right.cursor->title, right.cursor->ISBN) < 0;
+}
+
+bool OrderedBookIndex::SlotOrder::operator()(const CursorProbe &left, const OrderedSlot &right) const
+{
+    if(left.prefix != right.prefix)
+    {
+        return left.prefix < right.prefix;
+    }
+    return Compare(left.cursor->title, left.cursor->ISBN, catalogue->GetTitle(right.slot), catalogue->GetISBN(right.slot)) < 0;
+}
+
+/**
+ * @brief Gets the first 8 bytes of a sort key as a big endian integer, zero padded.
+*/
+uint64_t OrderedBookIndex::PrefixOf(string_view key)
+{
+    // Zero is the smallest byte, so the padded prefixes order like the keys they start
+    uint64_t prefix = 0;
+    for(size_t i = 0; i < 8; i++)
+    {
+        prefix = (prefix << 8) | (i < key.size() ? static_cast<unsigned char>(key[i]) : 0);
+    }
+    return prefix;
+}
+
+/**
+ * @brief Pairs a handle with the prefix of its sort key.
+*/
+OrderedBookIndex::OrderedSlot OrderedBookIndex::EntryOf(book_handle_t slot) const
+{
+    OrderedSlot entry;
+    entry.prefix = PrefixOf((order == ORDER_BY_TITLE) ? catalogue->GetTitle(slot) : catalogue->GetISBN(slot));
+    entry.slot = slot;
+    return entry;
+}
+
+/**
+ * @brief Pairs handles with their prefixes and sorts them.
+*/
+vector<OrderedBookIndex::OrderedSlot> OrderedBookIndex::SortedEntries(const vector<book_handle_t> &handles) const
+{
+    vector<OrderedSlot> entries;
+    entries.reserve(handles.size());
+    for(book_handle_t slot : handles)
+    {
+        entries.push_back(EntryOf(slot));
+    }
+
+    // Sorting the compact entries reads the catalogue only for the keys sharing a prefix
+    sort(entries.begin(), entries.end(), slots.key_comp());
+    return entries;
+}
+
+/**
+ * @brief Constructs an empty index.
+ *
+ * @param catalogue The catalogue holding the fields of the books, which must outlive the index.
+ * @param order The order of the index.
+*/
+OrderedBookIndex::OrderedBookIndex(const CatalogueStore &catalogue, book_order_t order)
+    : catalogue(&catalogue), order(order), slots(SlotOrder{&catalogue, order})
+{
+}
+
+/**
+ * @brief Adds a book, whose fields are already stored in the catalogue.
+ *
+ * @param slot The handle of the book.
+*/
+void OrderedBookIndex::Insert(book_handle_t slot)
+{
+    slots.insert(EntryOf(slot));
+}
+
+/**
+ * @brief Adds a batch of books, whose fields are already stored in the catalogue.
+ *
+ * @param handles The handles of the books.
+*/
+void OrderedBookIndex::InsertBatch(const vector<book_handle_t> &handles)
+{
+    // A few books are cheaper to insert than the whole tree is to rebuild
+    if(handles.size() * 16 < slots.size())
+    {
+        for(book_handle_t slot : handles)
+        {
+            Insert(slot);
+        }
+        return;
+    }
+
+    // Merge the sorted batch with the tree, every entry is appended at the end of the new tree
+    vector<OrderedSlot> entries = SortedEntries(handles);
+    set<OrderedSlot, SlotOrder> merged(slots.key_comp());
+    auto old_it = slots.begin();
+    auto new_it = entries.begin();
+    while(old_it != slots.end() || new_it != entries.end())
+    {
+        if(new_it == entries.end() || (old_it != slots.end() && slots.key_comp()(*old_it, *new_it)))
+        {
+            merged.insert(merged.end(), *old_it++);
+        }
+        else
+        {
+            merged.insert(merged.end(), *new_it++);
+        }
+    }
+    slots.swap(merged);
+}
+
+/**
+ * @brief Removes a book, whose fields are still stored in the catalogue.
+ *
+ * @param slot The handle of the book.
+*/
+void OrderedBookIndex::Erase(book_handle_t slot)
+{
+    slots.erase(EntryOf(slot));
+}
+
+/**
+ * @brief Replaces the content of the index with handles already in order.
+ *
+ * @param handles The handles of every book, as returned by GetHandles().
+ * @param count The number of handles.
+*/
+void OrderedBookIndex::Load(const book_handle_t *handles, size_t count)
+{
+    slots.clear();
+
+    // Every entry goes right before end(), the hint makes each insertion constant time
+    for(size_t i = 0; i < count; i++)
+    {
+        slots.insert(slots.end(), EntryOf(handles[i]));
+    }
+}
+
+/**
+ * @brief Gets every handle of the index, in order.
+ *
+ * @return vector<book_handle_t> The handles.
+*/
+vector<book_handle_t> OrderedBookIndex::GetHandles() const
+{
+    vector<book_handle_t> handles;
+    handles.reserve(slots.size());
+    for(const OrderedSlot &entry : slots)
+    {
+        handles.push_back(entry.slot);
+    }
+    return handles;
+}
+
+/**
+ * @brief Gets the handles of the books following a cursor.
+ *
+ * @param after The cursor, a default one to start from the first book.
+ * @param limit The largest number of handles returned.
+ * @param has_more Set to whether more books follow the returned ones.
+ * @return vector<book_handle_t> The handles, in order.
+*/
+vector<book_handle_t> OrderedBookIndex::Page(const BookCursor &after, size_t limit, bool &has_more) const
+{
+    // Descend once to the first book sorting after the cursor
+    CursorProbe probe;
+    probe.prefix = PrefixOf((order == ORDER_BY_TITLE) ? after.title : after.ISBN);
+    probe.cursor = &after;
+    auto it = after.ISBN.empty() ? slots.begin() : slots.upper_bound(probe);
+
+    vector<book_handle_t> page;
+    page.reserve(min(limit, slots.size()));
+    for(; it != slots.end() && page.size() < limit; it++)
+    {
+        page.push_back(it->slot);
+    }
+    has_more = (it != slots.end());
+
+    return page;
+}
+
+/**
+ * @brief Removes every book from the index.
+*/
+void OrderedBookIndex::Clear()
+{
+    slots.clear();
+}
+
+/**
+ * @brief Exchanges the books of two indexes of the same order.
+ *
+ * @param other The index to exchange the books with.
+*/
+void OrderedBookIndex::Swap(OrderedBookIndex &other)
+{
+    // Each tree compares through its own catalogue, so the nodes move rather than the trees
+    set<OrderedSlot, SlotOrder> incoming(slots.key_comp());
+    while(!other.slots.empty())
+    {
+        incoming.insert(incoming.end(), other.slots.extract(other.slots.begin()));
+    }
+    while(!slots.empty())
+    {
+        other.slots.insert(other.slots.end(), slots.extract(slots.begin()));
+    }
+    slots.swap(incoming);
+}
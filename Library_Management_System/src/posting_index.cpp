@@ -0,0 +1,458 @@
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <cctype>
+#include "posting_index.hpp"
+
+using namespace std;
+
+/**
+ * @brief Gets the block a handle belongs to: the first one whose last handle is not smaller.
+ *
+ * @param handle The handle.
+ * @return size_t The index of the block, blocks.size() if every handle is smaller.
+*/
+size_t PostingList::BlockOf(book_handle_t handle) const
+{
+    // Binary search on the last handle of the blocks.
+    auto it = lower_bound(blocks.begin(), blocks.end(), handle,
+                          [](const vector<book_handle_t> &block, book_handle_t value) { return block.back() < value; });
+    return static_cast<size_t>(it - blocks.begin());
+}
+
+/**
+ * @brief Adds a handle at its sorted position, duplicates are ignored.
+ *
+ * @param handle The handle to add.
+ * @return true if the handle was added.
+*/
+bool PostingList::Insert(book_handle_t handle)
+{
+    if(blocks.empty())
+    {
+        // The first handle starts the first block.
+        blocks.emplace_back(1, handle);
+        count = 1;
+        return true;
+    }
+
+    // A handle above every other one goes to the last block.
+    size_t index = min(BlockOf(handle), blocks.size() - 1);
+    vector<book_handle_t> &block = blocks[index];
+
+    // Insert the handle in its block only if it is not already there.
+    auto it = lower_bound(block.begin(), block.end(), handle);
+    if(it != block.end() && *it == handle)
+    {
+        return false;
+    }
+    block.insert(it, handle);
+    count++;
+
+    // Split a full block in two halves, only the block headers after it move.
+    if(block.size() > 2 * BLOCK_SIZE)
+    {
+        vector<book_handle_t> upper(block.begin() + BLOCK_SIZE, block.end());
+        block.resize(BLOCK_SIZE);
+        blocks.insert(blocks.begin() + index + 1, std::move(upper));
+    }
+    return true;
+}
+
+/**
+ * @brief Removes a handle, merging a block grown too small with the next one.
+ *
+ * @param handle The handle to remove.
+ * @return true if the handle was present.
+*/
+bool PostingList::Erase(book_handle_t handle)
+{
+    // Find the handle in its block.
+    size_t index = BlockOf(handle);
+    if(index == blocks.size())
+    {
+        return false;
+    }
+    vector<book_handle_t> &block = blocks[index];
+    auto it = lower_bound(block.begin(), block.end(), handle);
+    if(it == block.end() || *it != handle)
+    {
+        return false;
+    }
+    block.erase(it);
+    count--;
+
+    if(block.empty())
+    {
+        // Drop an emptied block.
+        blocks.erase(blocks.begin() + index);
+    }
+    else if(block.size() < BLOCK_SIZE / 4 && index + 1 < blocks.size() && block.size() + blocks[index + 1].size() <= BLOCK_SIZE)
+    {
+        // Fold a sparse block into the next one, so removals never leave a trail of tiny blocks.
+        vector<book_handle_t> &next = blocks[index + 1];
+        next.insert(next.begin(), block.begin(), block.end());
+        blocks.erase(blocks.begin() + index);
+    }
+    return true;
+}
+
+/**
+ * @brief Checks whether the list holds a handle.
+*/
+bool PostingList::Contains(book_handle_t handle) const
+{
+    size_t index = BlockOf(handle);
+    return index < blocks.size() && binary_search(blocks[index].begin(), blocks[index].end(), handle);
+}
+
+/**
+ * @brief Replaces the handles of the list with an already sorted array.
+ *
+ * @param handles The handles, in ascending order.
+ * @param handle_count The number of handles.
+*/
+void PostingList::Assign(const book_handle_t *handles, size_t handle_count)
+{
+    // Cut the array into full blocks.
+    blocks.clear();
+    blocks.reserve((handle_count + BLOCK_SIZE - 1) / BLOCK_SIZE);
+    for(size_t first = 0; first < handle_count; first += BLOCK_SIZE)
+    {
+        blocks.emplace_back(handles + first, handles + min(handle_count, first + BLOCK_SIZE));
+    }
+    count = handle_count;
+}
+
+/**
+ * @brief Copies the handles into a flat vector, in ascending order.
+*/
+vector<book_handle_t> PostingList::ToVector() const
+{
+    vector<book_handle_t> handles;
+    handles.reserve(count);
+    for(const vector<book_handle_t> &block : blocks)
+    {
+        handles.insert(handles.end(), block.begin(), block.end());
+    }
+    return handles;
+}
+
+/**
+ * @brief Moves the cursor to the first handle not smaller than a handle.
+ *
+ * @param handle The handle sought, not smaller than the one at the cursor.
+ * @return false if every remaining handle is smaller.
+*/
+bool PostingList::Cursor::SeekTo(book_handle_t handle)
+{
+    const vector<vector<book_handle_t>> &blocks = list->blocks;
+
+    // Gallop over the blocks ending before the handle, then binary search the last step.
+    if(block < blocks.size() && blocks[block].back() < handle)
+    {
+        size_t low = block + 1;
+        size_t high = low;
+        size_t step = 1;
+        while(high < blocks.size() && blocks[high].back() < handle)
+        {
+            low = high + 1;
+            high += step;
+            step <<= 1;
+        }
+        auto it = lower_bound(blocks.begin() + low, blocks.begin() + min(high, blocks.size()), handle,
+                              [](const vector<book_handle_t> &candidate, book_handle_t value) { return candidate.back() < value; });
+        block = static_cast<size_t>(it - blocks.begin());
+        offset = 0;
+    }
+    if(block >= blocks.size())
+    {
+        return false;
+    }
+
+    // The block holds a handle not smaller than the one sought.
+    const vector<book_handle_t> &current = blocks[block];
+    offset = static_cast<size_t>(lower_bound(current.begin() + offset, current.end(), handle) - current.begin());
+    return true;
+}
+
+/**
+ * @brief Constructs an empty posting index.
+ *
+ * @param ordered Whether the terms are also kept sorted so FindPrefixPostings can be used.
+*/
+PostingIndex::PostingIndex(bool ordered)
+{
+    // Remember whether the terms must be kept in order for the prefix lookups.
+    keep_ordered_terms = ordered;
+}
+
+/**
+ * @brief Normalizes a whole field value into an index key.
+ *
+ * The value is lowercased, leading and trailing blanks are dropped and inner runs of
+ * blanks are collapsed to a single space, so "Dr.  Yasser " and "dr. yasser" share a key.
+ *
+ * @param value The field value to normalize.
+ * @return The normalized key.
+*/
+string PostingIndex::NormalizeKey(const string &value)
+{
+    // The normalized key being built.
+    string key;
+    key.reserve(value.size());
+
+    // Whether a blank was skipped since the last kept character.
+    bool pending_blank = false;
+
+    for(char ch : value)
+    {
+        unsigned char c = static_cast<unsigned char>(ch);
+
+        if(isspace(c))
+        {
+            // Remember the blank, it is emitted only before the next kept character.
+            pending_blank = !key.empty();
+            continue;
+        }
+
+        if(pending_blank)
+        {
+            // Collapse the run of blanks to a single space.
+            key.push_back(' ');
+            pending_blank = false;
+        }
+
+        // Append the lowercased character to the key.
+        key.push_back(static_cast<char>(tolower(c)));
+    }
+
+    return key;
+}
+
+/**
+ * @brief Adds a book handle to the posting list of a term.
+ *
+ * The handle is inserted at its sorted position, duplicates are ignored.
+ *
+ * @param term The term the book is indexed under.
+ * @param handle The handle of the book.
+*/
+void PostingIndex::AddPosting(const string &term, book_handle_t handle)
+{
+    // Get (or create) the posting list of the term.
+    PostingList &list = postings[term];
+
+    // Record a new term in the ordered terms if prefix lookups are enabled.
+    if(keep_ordered_terms && list.IsEmpty())
+    {
+        ordered_terms.insert(term);
+    }
+
+    // Insert the handle in its block, duplicates are ignored.
+    list.Insert(handle);
+}
+
+/**
+ * @brief Removes a book handle from the posting list of a term.
+ *
+ * The posting list is dropped once it becomes empty.
+ *
+ * @param term The term the book is indexed under.
+ * @param handle The handle of the book.
+*/
+void PostingIndex::RemovePosting(const string &term, book_handle_t handle)
+{
+    // Look up the posting list of the term.
+    auto found = postings.find(term);
+    if(found == postings.end())
+    {
+        // The term is not indexed, nothing to remove.
+        return;
+    }
+
+    // Remove the handle from its block if it is indexed under the term.
+    PostingList &list = found->second;
+    list.Erase(handle);
+
+    // Drop the term once no book holds it anymore.
+    if(list.IsEmpty())
+    {
+        if(keep_ordered_terms)
+        {
+            ordered_terms.erase(term);
+        }
+        postings.erase(found);
+    }
+}
+
+/**
+ * @brief Gets the posting list of a term.
+ *
+ * @param term The term to look up.
+ * @return Pointer to the sorted posting list, or nullptr if no book holds the term.
+*/
+const PostingList *PostingIndex::FindPostings(const string &term) const
+{
+    // Look up the posting list of the term.
+    auto found = postings.find(term);
+
+    // Return the posting list if the term is indexed.
+    return (found == postings.end()) ? nullptr : &found->second;
+}
+
+/**
+ * @brief Gets every term of the index with its posting list.
+ *
+ * @return The map from the terms to their sorted posting lists.
+*/
+const unordered_map<string, PostingList> &PostingIndex::GetAllPostings() const
+{
+    // Returns the posting lists of every term.
+    return postings;
+}
+
+/**
+ * @brief Replaces the posting list of a term with an already sorted list.
+ *
+ * @param term The term the books are indexed under.
+ * @param handles The handles of the books, in ascending order.
+ * @param count The number of handles.
+*/
+void PostingIndex::LoadPostings(const string &term, const book_handle_t *handles, size_t count)
+{
+    if(count == 0)
+    {
+        // An empty posting list is never kept.
+        return;
+    }
+
+    // Record a new term in the ordered terms if prefix lookups are enabled.
+    PostingList &list = postings[term];
+    if(keep_ordered_terms && list.IsEmpty())
+    {
+        ordered_terms.insert(term);
+    }
+
+    // Copy the sorted handles in one go, cut into blocks.
+    list.Assign(handles, count);
+}
+
+/**
+ * @brief Reserves room for a number of terms.
+ *
+ * @param terms The number of terms.
+*/
+void PostingIndex::Reserve(size_t terms)
+{
+    // Reserves the buckets of the posting lists.
+    postings.reserve(terms);
+}
+
+/**
+ * @brief Removes all the terms and posting lists from the index.
+*/
+void PostingIndex::Clear()
+{
+    // Clears the unordered_map containing the posting lists
+    postings.clear();
+    // Clears the ordered terms used by the prefix lookups
+    ordered_terms.clear();
+}
+
+/**
+ * @brief Gets the handles of the books indexed under any term starting with a prefix.
+ *
+ * The matching terms are found with a range lookup over the ordered terms, so only the
+ * terms sharing the prefix are visited. The index must have been built as ordered.
+ *
+ * @param prefix The prefix of the terms.
+ * @return The sorted union of the posting lists of the matching terms.
+*/
+vector<book_handle_t> PostingIndex::FindPrefixPostings(const string &prefix) const
+{
+    // The union of the posting lists of the matching terms.
+    vector<book_handle_t> result;
+
+    // Visit the terms from the first one not smaller than the prefix while they share it.
+    for(auto it = ordered_terms.lower_bound(prefix);
+        it != ordered_terms.end() && it->compare(0, prefix.size(), prefix) == 0; it++)
+    {
+        for(const vector<book_handle_t> &block : postings.at(*it).GetBlocks())
+        {
+            result.insert(result.end(), block.begin(), block.end());
+        }
+    }
+
+    // A book holds a single value per field, but keep the union sorted and unique anyway.
+    sort(result.begin(), result.end());
+    result.erase(unique(result.begin(), result.end()), result.end());
+
+    return result;
+}
+
+/**
+ * @brief Intersects several sorted posting lists.
+ *
+ * The lists are visited from the shortest one, and every candidate is searched in the
+ * longer lists with a galloping (exponential then binary) search resuming from the last
+ * position, so the cost is about |shortest| * log(|longest| / |shortest|) comparisons.
+ *
+ * @param lists The posting lists to intersect, reordered by size.
+ * @return The handles present in every list, in ascending order.
+*/
+vector<book_handle_t> PostingIndex::IntersectPostings(vector<const PostingList *> &lists)
+{
+    // The handles present in every posting list.
+    vector<book_handle_t> result;
+
+    if(lists.empty())
+    {
+        // Nothing to intersect.
+        return result;
+    }
+
+    // Drive the intersection from the shortest posting list.
+    sort(lists.begin(), lists.end(), [](const PostingList *a, const PostingList *b) { return a->Size() < b->Size(); });
+
+    // The position reached so far in every longer list, candidates only move forward.
+    vector<PostingList::Cursor> cursors;
+    cursors.reserve(lists.size());
+    for(const PostingList *list : lists)
+    {
+        cursors.emplace_back(*list);
+    }
+
+    for(const vector<book_handle_t> &block : lists[0]->GetBlocks())
+    {
+        for(book_handle_t handle : block)
+        {
+            // Keep the candidate only if every longer list holds it too.
+            bool in_all = true;
+
+            for(size_t i = 1; i < cursors.size(); i++)
+            {
+                // Gallop to the candidate, over the blocks then inside its block.
+                if(!cursors[i].SeekTo(handle))
+                {
+                    // This list is exhausted, no later candidate can match either.
+                    return result;
+                }
+
+                if(cursors[i].Get() != handle)
+                {
+                    in_all = false;
+                    break;
+                }
+            }
+
+            if(in_all)
+            {
+                result.push_back(handle);
+            }
+        }
+    }
+
+    return result;
+}
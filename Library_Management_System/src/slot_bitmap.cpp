@@ -0,0 +1,96 @@
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include "slot_bitmap.hpp"
+
+using namespace std;
+
+/**
+ * @brief Grows the bitmap so it covers a number of slots, new bits are cleared.
+ *
+ * @param slots The number of slots to cover.
+*/
+void SlotBitmap::Resize(size_t slots)
+{
+    // Round the number of slots up to whole words.
+    size_t needed = (slots + 63) / 64;
+
+    if(needed > word_count)
+    {
+        // The new words come zeroed and the existing ones stay in place
+        words.Grow(needed);
+        word_count = needed;
+    }
+}
+
+/**
+ * @brief Reserves room for a number of slots.
+ *
+ * @param slots The number of slots.
+*/
+void SlotBitmap::Reserve(size_t slots)
+{
+    // Allocate the words covering the slots, the bitmap itself is not resized.
+    words.Grow((slots + 63) / 64);
+}
+
+/**
+ * @brief Counts the set bits with a popcount per word.
+ *
+ * @return The number of slots whose bit is set.
+*/
+size_t SlotBitmap::Count() const
+{
+    size_t count = 0;
+
+    // Count the set bits of every word.
+    for(size_t i = 0; i < word_count; i++)
+    {
+        count += static_cast<size_t>(__builtin_popcountll(Word(i)));
+    }
+
+    return count;
+}
+
+/**
+ * @brief Counts the slots set in both this bitmap and another one.
+ *
+ * @param other The bitmap to combine with.
+ * @return The popcount of the bitwise AND of the two bitmaps.
+*/
+size_t SlotBitmap::CountAnd(const SlotBitmap &other) const
+{
+    size_t count = 0;
+
+    // Only the words present in both bitmaps can have common bits.
+    size_t common = min(word_count, other.word_count);
+
+    for(size_t i = 0; i < common; i++)
+    {
+        count += static_cast<size_t>(__builtin_popcountll(Word(i) & other.Word(i)));
+    }
+
+    return count;
+}
+
+/**
+ * @brief Clears the bitmap.
+*/
+void SlotBitmap::Clear()
+{
+    // Drops every word of the bitmap.
+    words.Clear();
+    word_count = 0;
+}
+
+/**
+ * @brief Exchanges the bits of two bitmaps, nobody may access either of them meanwhile.
+ *
+ * @param other The bitmap to exchange the bits with.
+*/
+void SlotBitmap::Swap(SlotBitmap &other)
+{
+    // Exchanges the words and their count.
+    words.Swap(other.words);
+    swap(word_count, other.word_count);
+}
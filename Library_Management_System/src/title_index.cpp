@@ -0,0 +1,149 @@
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cctype>
+#include "title_index.hpp"
+
+using namespace std;
+
+/**
+ * @brief Splits a title into normalized search terms.
+ *
+ * Terms are separated by any non alphanumeric character and by lower to upper case
+ * transitions (so "LinearAlgebra" yields "linear" and "algebra"), then lowercased.
+ * Repeated terms are kept only once.
+ *
+ * @param title The title to split.
+ * @return The terms of the title in order of first appearance.
+*/
+vector<string> TitleIndex::TokenizeTitle(const string &title)
+{
+    // The list of terms found in the title.
+    vector<string> tokens;
+    // The term currently being built.
+    string current;
+
+    // Helper flushing the current term into the list of terms.
+    auto flush = [&tokens, &current]()
+    {
+        // Keep the term only if it is not empty and not already seen.
+        if(!current.empty() && find(tokens.begin(), tokens.end(), current) == tokens.end())
+        {
+            tokens.push_back(current);
+        }
+        current.clear();
+    };
+
+    // Walk the title character by character.
+    for(size_t i = 0; i < title.size(); i++)
+    {
+        unsigned char c = static_cast<unsigned char>(title[i]);
+
+        if(!isalnum(c))
+        {
+            // Any separator ends the current term.
+            flush();
+            continue;
+        }
+
+        // A lower to upper case transition starts a new term ("LinearAlgebra").
+        if(isupper(c) && i > 0 && islower(static_cast<unsigned char>(title[i - 1])))
+        {
+            flush();
+        }
+
+        // Append the lowercased character to the current term.
+        current.push_back(static_cast<char>(tolower(c)));
+    }
+
+    // Flush the last term of the title.
+    flush();
+
+    return tokens;
+}
+
+/**
+ * @brief Indexes the title of a book.
+ *
+ * @param handle The handle of the book.
+ * @param title The title of the book.
+*/
+void TitleIndex::AddTitle(book_handle_t handle, const string &title)
+{
+    // Add the book to the posting list of every term of its title.
+    for(const string &term : TokenizeTitle(title))
+    {
+        terms.AddPosting(term, handle);
+    }
+}
+
+/**
+ * @brief Removes the title of a book from the index.
+ *
+ * @param handle The handle of the book.
+ * @param title The title the book was indexed with.
+*/
+void TitleIndex::RemoveTitle(book_handle_t handle, const string &title)
+{
+    // Remove the book from the posting list of every term of its title.
+    for(const string &term : TokenizeTitle(title))
+    {
+        terms.RemovePosting(term, handle);
+    }
+}
+
+/**
+ * @brief Collects the posting lists of every term of a query.
+ *
+ * @param query The title (or part of it) to search for.
+ * @param lists The list receiving one posting list per term of the query.
+ * @return false if a term of the query is held by no book, true otherwise.
+*/
+bool TitleIndex::CollectPostings(const string &query, vector<const PostingList *> &lists) const
+{
+    for(const string &term : TokenizeTitle(query))
+    {
+        const PostingList *list = terms.FindPostings(term);
+        if(list == nullptr)
+        {
+            // A term held by no book means no title can match the query.
+            return false;
+        }
+        lists.push_back(list);
+    }
+
+    return true;
+}
+
+/**
+ * @brief Finds the books whose titles contain every term of a query.
+ *
+ * The posting lists of the terms are intersected from the shortest one, so the cost
+ * follows the number of candidates rather than the size of the catalogue.
+ *
+ * @param query The title (or part of it) to search for.
+ * @return The sorted handles of the matching books.
+*/
+vector<book_handle_t> TitleIndex::SearchTitle(const string &query) const
+{
+    // The posting lists of every term of the query.
+    vector<const PostingList *> lists;
+
+    if(!CollectPostings(query, lists))
+    {
+        // Some term is held by no book.
+        return {};
+    }
+
+    // Keep only the books holding every term, an empty query matches nothing.
+    return PostingIndex::IntersectPostings(lists);
+}
+
+/**
+ * @brief Removes all the titles from the index.
+*/
+void TitleIndex::Clear()
+{
+    // Clears the inverted index of the title terms
+    terms.Clear();
+}
@@ -0,0 +1,610 @@
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+#include "trigram_index.hpp"
+#include "title_index.hpp"
+
+using namespace std;
+
+/* The character padding the terms, never part of a term since the terms are alphanumeric. */
+static const char TRIGRAM_PAD = ' ';
+
+/* The number of trigrams a single edit of a term can change, a swap of neighbours touching four. */
+static const unsigned TRIGRAMS_PER_EDIT = 4;
+
+/* The longest term whose edit distance is computed without allocating. */
+static const size_t EDIT_STACK_COLUMNS = 64;
+
+/**
+ * @brief Packs three characters into a trigram.
+*/
+static uint32_t PackTrigram(char first, char second, char third)
+{
+    return (uint32_t(static_cast<unsigned char>(first)) << 16) | (uint32_t(static_cast<unsigned char>(second)) << 8) |
+           uint32_t(static_cast<unsigned char>(third));
+}
+
+/**
+ * @brief Constructs an empty index.
+ *
+ * @param title_terms The posting lists of the title terms, which must outlive the index.
+*/
+TrigramIndex::TrigramIndex(const PostingIndex &title_terms) : title_terms(&title_terms)
+{
+}
+
+/**
+ * @brief Gets the number of edits allowed between a query term and a catalogue term.
+ *
+ * @param length The length of the query term.
+*/
+unsigned TrigramIndex::MaxDistance(size_t length)
+{
+    // A single edit of a short term matches too many unrelated terms
+    if(length <= 3)
+    {
+        return 0;
+    }
+    return (length <= 7) ? 1 : 2;
+}
+
+/**
+ * @brief Computes the edit distance of two terms, stopping once it exceeds a bound.
+ *
+ * @param left The first term.
+ * @param right The second term.
+ * @param bound The largest distance of interest.
+ * @return unsigned The distance, or bound + 1 if it is larger than bound.
+*/
+unsigned TrigramIndex::EditDistance(string_view left, string_view right, unsigned bound)
+{
+    // The distance is at least the difference of the lengths
+    size_t columns = right.size() + 1;
+    unsigned beyond = bound + 1;
+    if((left.size() > right.size() ? left.size() - right.size() : right.size() - left.size()) > bound)
+    {
+        return beyond;
+    }
+
+    // Three rows, the two previous ones for the swaps of neighbours, on the stack for the usual terms
+    unsigned stack_rows[3][EDIT_STACK_COLUMNS];
+    vector<unsigned> heap_rows;
+    unsigned *before = stack_rows[0], *previous = stack_rows[1], *current = stack_rows[2];
+    if(columns > EDIT_STACK_COLUMNS)
+    {
+        heap_rows.resize(3 * columns);
+        before = heap_rows.data();
+        previous = before + columns;
+        current = previous + columns;
+    }
+    for(size_t j = 0; j < columns; j++)
+    {
+        previous[j] = min(static_cast<unsigned>(j), beyond);
+    }
+
+    for(size_t i = 1; i <= left.size(); i++)
+    {
+        // Only the cells within bound of the diagonal can stay within bound, the others read as beyond
+        size_t low = (i > bound) ? i - bound : 1;
+        size_t high = min(columns - 1, i + bound);
+        current[0] = min(static_cast<unsigned>(i), beyond);
+        current[low - 1] = (low > 1) ? beyond : current[0];
+        unsigned row_minimum = current[low - 1];
+
+        for(size_t j = low; j <= high; j++)
+        {
+            // Deletion, insertion or substitution
+            unsigned substitution = previous[j - 1] + (left[i - 1] == right[j - 1] ? 0 : 1);
+            unsigned best = min(min(previous[j] + 1, current[j - 1] + 1), substitution);
+
+            // Swap of two neighbouring characters
+            if(i > 1 && j > 1 && left[i - 1] == right[j - 2] && left[i - 2] == right[j - 1])
+            {
+                best = min(best, before[j - 2] + 1);
+            }
+            current[j] = min(best, beyond);
+            row_minimum = min(row_minimum, current[j]);
+        }
+        if(high + 1 < columns)
+        {
+            current[high + 1] = beyond;
+        }
+
+        // No later row can fall back under the bound
+        if(row_minimum > bound)
+        {
+            return beyond;
+        }
+        unsigned *oldest = before;
+        before = previous;
+        previous = current;
+        current = oldest;
+    }
+
+    return previous[columns - 1];
+}
+
+/**
+ * @brief Gets the distinct trigrams of a term.
+ *
+ * @param term The term.
+ * @param padded Whether the term is padded with two blanks in front and one behind.
+ * @return vector<uint32_t> The trigrams packed into integers, sorted.
+*/
+vector<uint32_t> TrigramIndex::TrigramsOf(string_view term, bool padded)
+{
+    // The padding gives every term at least one trigram
+    string text;
+    if(padded)
+    {
+        text.reserve(term.size() + 3);
+        text.append(2, TRIGRAM_PAD);
+        text.append(term);
+        text.push_back(TRIGRAM_PAD);
+    }
+    else
+    {
+        text.assign(term);
+    }
+
+    vector<uint32_t> trigrams_found;
+    for(size_t i = 0; i + 3 <= text.size(); i++)
+    {
+        trigrams_found.push_back(PackTrigram(text[i], text[i + 1], text[i + 2]));
+    }
+
+    // A term repeating a trigram is listed once under it
+    sort(trigrams_found.begin(), trigrams_found.end());
+    trigrams_found.erase(unique(trigrams_found.begin(), trigrams_found.end()), trigrams_found.end());
+    return trigrams_found;
+}
+
+/**
+ * @brief Adds a reference to a term, inserting it in the vocabulary if new.
+*/
+void TrigramIndex::AddTerm(const string &term)
+{
+    // Most terms are already known, only count the new reference
+    auto found = vocabulary.find(term);
+    if(found != vocabulary.end())
+    {
+        found->second.references++;
+        return;
+    }
+    TermEntry &entry = vocabulary.emplace(term, TermEntry{0, 1}).first->second;
+
+    // A new term takes a released ID if any
+    if(free_ids.empty())
+    {
+        entry.id = static_cast<uint32_t>(terms.size());
+        terms.push_back(term);
+    }
+    else
+    {
+        entry.id = free_ids.back();
+        free_ids.pop_back();
+        terms[entry.id] = term;
+    }
+
+    // List the term under each of its trigrams
+    for(uint32_t trigram : TrigramsOf(term, true))
+    {
+        trigrams[trigram].push_back(entry.id);
+    }
+}
+
+/**
+ * @brief Drops a reference to a term, removing it from the vocabulary if it was the last.
+*/
+void TrigramIndex::RemoveTerm(const string &term)
+{
+    auto found = vocabulary.find(term);
+    if(found == vocabulary.end() || --found->second.references > 0)
+    {
+        // Unknown, or still held by another title or author
+        return;
+    }
+
+    // Unlist the term from its trigrams, the lists are unordered so the last ID fills the hole
+    uint32_t id = found->second.id;
+    for(uint32_t trigram : TrigramsOf(term, true))
+    {
+        auto list = trigrams.find(trigram);
+        if(list == trigrams.end())
+        {
+            continue;
+        }
+        vector<uint32_t> &ids = list->second;
+        auto position = find(ids.begin(), ids.end(), id);
+        if(position != ids.end())
+        {
+            *position = ids.back();
+            ids.pop_back();
+        }
+        if(ids.empty())
+        {
+            trigrams.erase(list);
+        }
+    }
+
+    // Release the ID for the next new term
+    terms[id].clear();
+    free_ids.push_back(id);
+    vocabulary.erase(found);
+}
+
+/**
+ * @brief Finds the terms of the vocabulary approximately matching a term of a query.
+ *
+ * The candidates come from the shortest trigram lists of the query term only:
+ *  - edit distance: an edit changes at most four padded trigrams, so a term within k edits
+ *    shares all but 4k of the distinct trigrams of the query term, hence at least one of
+ *    any 4k + 1 of them, which are taken from the rarest;
+ *  - substring: a term containing the query term holds each of its inner trigrams (for a
+ *    query term under three characters, its leading padded trigrams, which make it a prefix),
+ *    hence the rarest one.
+ * The common trigrams, "  s" or "ing", are never walked, and every candidate is verified.
+ *
+ * @param term The normalized query term.
+ * @return vector<term_match_t> The matching terms, cheapest first.
+*/
+vector<term_match_t> TrigramIndex::MatchTerm(const string &term) const
+{
+    unsigned max_distance = MaxDistance(term.size());
+
+    // The trigrams of the query term: all of them for the edit distance, the required ones for the substring
+    vector<uint32_t> padded = TrigramsOf(term, true);
+    vector<uint32_t> required;
+    if(term.size() >= 3)
+    {
+        required = TrigramsOf(term, false);
+    }
+    else
+    {
+        // The trigrams ending before the trailing pad: "  a" for "a", "  a" and " ab" for "ab"
+        required.push_back(PackTrigram(TRIGRAM_PAD, TRIGRAM_PAD, term[0]));
+        if(term.size() == 2)
+        {
+            required.push_back(PackTrigram(TRIGRAM_PAD, term[0], term[1]));
+        }
+    }
+
+    // The list of terms of a trigram, nullptr for a trigram no term holds
+    auto list_of = [this](uint32_t trigram) -> const vector<uint32_t> *
+    {
+        auto found = trigrams.find(trigram);
+        return (found == trigrams.end()) ? nullptr : &found->second;
+    };
+    auto length_of = [](const vector<uint32_t> *list) { return (list == nullptr) ? size_t(0) : list->size(); };
+
+    // The candidates of the substring check: the terms of the rarest required trigram
+    vector<uint32_t> candidates;
+    const vector<uint32_t> *rarest = nullptr;
+    for(size_t i = 0; i < required.size(); i++)
+    {
+        const vector<uint32_t> *list = list_of(required[i]);
+        if(i == 0 || length_of(list) < length_of(rarest))
+        {
+            rarest = list;
+        }
+    }
+    if(rarest != nullptr)
+    {
+        candidates.assign(rarest->begin(), rarest->end());
+    }
+
+    // The candidates of the edit distance: the terms of the 4k + 1 rarest trigrams
+    if(max_distance > 0)
+    {
+        vector<const vector<uint32_t> *> lists;
+        for(uint32_t trigram : padded)
+        {
+            lists.push_back(list_of(trigram));
+        }
+        size_t needed = min(lists.size(), size_t(TRIGRAMS_PER_EDIT * max_distance + 1));
+        partial_sort(lists.begin(), lists.begin() + needed, lists.end(),
+                     [&length_of](const vector<uint32_t> *left, const vector<uint32_t> *right)
+                     { return length_of(left) < length_of(right); });
+        for(size_t i = 0; i < needed; i++)
+        {
+            if(lists[i] != nullptr)
+            {
+                candidates.insert(candidates.end(), lists[i]->begin(), lists[i]->end());
+            }
+        }
+    }
+
+    // A term may be found under several trigrams, sorting the candidates keeps the cost to their number
+    sort(candidates.begin(), candidates.end());
+    candidates.erase(unique(candidates.begin(), candidates.end()), candidates.end());
+
+    vector<term_match_t> matches;
+    for(uint32_t id : candidates)
+    {
+        const string &candidate = terms[id];
+        unsigned cost = UINT32_MAX;
+
+        // Substring: the position of the query term
+        size_t position = candidate.find(term);
+        if(position == 0)
+        {
+            cost = (candidate.size() == term.size()) ? 0 : 1;
+        }
+        else if(position != string::npos)
+        {
+            cost = 2;
+        }
+
+        // Edit distance, bounded so a hopeless candidate stops after a few rows
+        if(cost > 2 && max_distance > 0)
+        {
+            unsigned distance = EditDistance(term, candidate, max_distance);
+            if(distance <= max_distance)
+            {
+                cost = 2 * distance;
+            }
+        }
+
+        if(cost != UINT32_MAX)
+        {
+            matches.push_back({id, cost});
+        }
+    }
+
+    // Keep the cheapest matches, the shortest terms first among equals
+    auto cheaper = [this](const term_match_t &left, const term_match_t &right)
+    {
+        if(left.cost != right.cost)
+        {
+            return left.cost < right.cost;
+        }
+        if(terms[left.term].size() != terms[right.term].size())
+        {
+            return terms[left.term].size() < terms[right.term].size();
+        }
+        return left.term < right.term;
+    };
+    if(matches.size() > MAX_TERM_MATCHES)
+    {
+        partial_sort(matches.begin(), matches.begin() + MAX_TERM_MATCHES, matches.end(), cheaper);
+        matches.resize(MAX_TERM_MATCHES);
+    }
+    else
+    {
+        sort(matches.begin(), matches.end(), cheaper);
+    }
+    return matches;
+}
+
+/**
+ * @brief Adds the terms of the title and author of a book.
+ *
+ * @param handle The handle of the book.
+ * @param title The title of the book.
+ * @param author The author of the book.
+*/
+void TrigramIndex::AddBook(book_handle_t handle, const string &title, const string &author)
+{
+    // The title postings are kept by the title index, only the vocabulary is added here
+    for(const string &term : TitleIndex::TokenizeTitle(title))
+    {
+        AddTerm(term);
+    }
+
+    for(const string &term : TitleIndex::TokenizeTitle(author))
+    {
+        author_terms.AddPosting(term, handle);
+        AddTerm(term);
+    }
+}
+
+/**
+ * @brief Removes the terms of the title and author of a book.
+ *
+ * @param handle The handle of the book.
+ * @param title The title the book was indexed with.
+ * @param author The author the book was indexed with.
+*/
+void TrigramIndex::RemoveBook(book_handle_t handle, const string &title, const string &author)
+{
+    for(const string &term : TitleIndex::TokenizeTitle(title))
+    {
+        RemoveTerm(term);
+    }
+
+    for(const string &term : TitleIndex::TokenizeTitle(author))
+    {
+        author_terms.RemovePosting(term, handle);
+        RemoveTerm(term);
+    }
+}
+
+/**
+ * @brief Finds the books whose title or author approximately holds every term of a query.
+ *
+ * The candidates are the books of the query term with the fewest books, which are then probed
+ * by binary search in the posting lists of the other query terms, or merged with their books
+ * when there are too many candidates to probe.
+ *
+ * @param query The partial or misspelled title or author name.
+ * @param limit The largest number of books returned.
+ * @return vector<book_handle_t> The handles of the best books, best first.
+*/
+vector<book_handle_t> TrigramIndex::Search(const string &query, size_t limit) const
+{
+    /**
+     * @brief A posting list matching a query term, with the cost of the match.
+     */
+    struct CostedList
+    {
+        const PostingList *handles;
+        unsigned cost;
+    };
+
+    vector<string> query_terms = TitleIndex::TokenizeTitle(query);
+    if(query_terms.empty() || limit == 0)
+    {
+        return {};
+    }
+
+    // The posting lists of the matches of every query term, cheapest first, and their total length
+    vector<vector<CostedList>> lists(query_terms.size());
+    vector<size_t> sizes(query_terms.size(), 0);
+    for(size_t i = 0; i < query_terms.size(); i++)
+    {
+        for(const term_match_t &match : MatchTerm(query_terms[i]))
+        {
+            for(const PostingIndex *index : {title_terms, &author_terms})
+            {
+                const PostingList *handles = index->FindPostings(terms[match.term]);
+                if(handles != nullptr)
+                {
+                    lists[i].push_back({handles, match.cost});
+                    sizes[i] += handles->Size();
+                }
+            }
+        }
+
+        if(lists[i].empty())
+        {
+            // A query term matching no book means no book holds every term
+            return {};
+        }
+    }
+
+    // Visit the query terms from the fewest books, the first one giving the candidates
+    vector<size_t> order(query_terms.size());
+    for(size_t i = 0; i < order.size(); i++)
+    {
+        order[i] = i;
+    }
+    sort(order.begin(), order.end(), [&sizes](size_t left, size_t right) { return sizes[left] < sizes[right]; });
+
+    // The books of the matches of a query term sorted by handle, each with its cheapest match; the
+    // lists are sorted by cost, so once enough books are found the dearer lists cannot rank
+    auto gather = [&lists](size_t term, size_t enough)
+    {
+        vector<pair<book_handle_t, unsigned>> books;
+        const vector<CostedList> &term_lists = lists[term];
+        size_t found = 0;
+        for(size_t i = 0; i < term_lists.size(); i++)
+        {
+            // Within a cost the lowest handles rank first, and a book past the first enough + found of
+            // its list is preceded there by that many books, so it cannot rank
+            const PostingList &handles = *term_lists[i].handles;
+            size_t taken = (enough == SIZE_MAX) ? handles.Size() : min(handles.Size(), enough + found);
+            for(const vector<book_handle_t> &block : handles.GetBlocks())
+            {
+                for(size_t j = 0; j < block.size() && taken > 0; j++, taken--)
+                {
+                    books.emplace_back(block[j], term_lists[i].cost);
+                }
+            }
+
+            // At the end of the lists of one cost, keep the cheapest match of every book
+            if(i + 1 == term_lists.size() || term_lists[i + 1].cost != term_lists[i].cost)
+            {
+                sort(books.begin(), books.end());
+                books.erase(unique(books.begin(), books.end(),
+                                   [](const pair<book_handle_t, unsigned> &left, const pair<book_handle_t, unsigned> &right)
+                                   { return left.first == right.first; }),
+                            books.end());
+                found = books.size();
+                if(found >= enough)
+                {
+                    break;
+                }
+            }
+        }
+        return books;
+    };
+
+    // The candidates with their cheapest match of the first term, a lone term may stop at the limit
+    vector<pair<book_handle_t, unsigned>> candidates = gather(order[0], (order.size() == 1) ? limit : SIZE_MAX);
+
+    // Add the cheapest match of every other term, dropping the candidates matching none
+    for(size_t k = 1; k < order.size() && !candidates.empty(); k++)
+    {
+        const vector<CostedList> &term_lists = lists[order[k]];
+        size_t kept = 0;
+
+        if(candidates.size() * term_lists.size() <= sizes[order[k]])
+        {
+            // Few candidates: probe the lists by binary search, the first one holding the book is its cheapest match
+            for(const pair<book_handle_t, unsigned> &candidate : candidates)
+            {
+                for(const CostedList &list : term_lists)
+                {
+                    if(list.handles->Contains(candidate.first))
+                    {
+                        candidates[kept++] = {candidate.first, candidate.second + list.cost};
+                        break;
+                    }
+                }
+            }
+        }
+        else
+        {
+            // Many candidates: merge them with the books of the term, both sorted by handle
+            vector<pair<book_handle_t, unsigned>> books = gather(order[k], SIZE_MAX);
+            size_t next = 0;
+            for(const pair<book_handle_t, unsigned> &candidate : candidates)
+            {
+                while(next < books.size() && books[next].first < candidate.first)
+                {
+                    next++;
+                }
+                if(next < books.size() && books[next].first == candidate.first)
+                {
+                    candidates[kept++] = {candidate.first, candidate.second + books[next].second};
+                }
+            }
+        }
+        candidates.resize(kept);
+    }
+
+    // Rank by total cost then handle
+    auto better = [](const pair<book_handle_t, unsigned> &left, const pair<book_handle_t, unsigned> &right)
+    {
+        return (left.second != right.second) ? left.second < right.second : left.first < right.first;
+    };
+    size_t count = min(limit, candidates.size());
+    partial_sort(candidates.begin(), candidates.begin() + count, candidates.end(), better);
+
+    vector<book_handle_t> handles;
+    handles.reserve(count);
+    for(size_t i = 0; i < count; i++)
+    {
+        handles.push_back(candidates[i].first);
+    }
+    return handles;
+}
+
+/**
+ * @brief Removes every term from the index.
+*/
+void TrigramIndex::Clear()
+{
+    author_terms.Clear();
+    vocabulary.clear();
+    terms.clear();
+    free_ids.clear();
+    trigrams.clear();
+}
+
+/**
+ * @brief Exchanges the terms of two indexes, each one keeps reading its own title terms.
+ *
+ * @param other The index to exchange the terms with.
+*/
+void TrigramIndex::Swap(TrigramIndex &other)
+{
+    swap(author_terms, other.author_terms);
+    vocabulary.swap(other.vocabulary);
+    terms.swap(other.terms);
+    free_ids.swap(other.free_ids);
+    trigrams.swap(other.trigrams);
+}
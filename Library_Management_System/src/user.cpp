@@ -3,6 +3,7 @@
 #include "user.hpp"
 #include <vector> 
 #include <memory>
+#include <utility>
 #include "book.hpp"
 
 using namespace std;
@@ -20,17 +21,15 @@ User::User()
 /**
  * @brief Parameterized constructor for the User class.
  * 
- * Initializes a User object with the provided name and ID.
+ * Initializes a User object with the provided name and ID. The name is taken by value
+ * and moved in, so a temporary is never copied.
  * 
- * @param name Reference to the user's name.
- * @param id Reference to the user's ID.
+ * @param name The user's name.
+ * @param id The user's ID.
 */
-User::User(string &name, int &id)
+User::User(string name, int id) : user_name(std::move(name)), user_id(id)
 {
-    // Set the user's name to the provided name.
-    user_name = name;
-    // Set the user's ID to the provided ID.
-    user_id = id;
+    // The name is moved in from the parameter.
 }
 
 /**
@@ -49,10 +48,10 @@ User::~User()
  * 
  * @param name The new name of the user.
 */
-void User::SetUserName(const string &name)
+void User::SetUserName(string name)
 {
     // Assign the new name to the user_name member variable.
-    user_name = name;
+    user_name = std::move(name);
 }
 
 /**
@@ -71,7 +70,7 @@ void User::SetUserId(const int &id)
  * 
  * @return The name of the user.
 */
-string User::GetUserName()
+const string &User::GetUserName() const
 {
     // Return the current value of the user_name member variable.
     return user_name;
@@ -82,7 +81,7 @@ string User::GetUserName()
  * 
  * @return The ID of the user.
 */
-int User::GetUserId()
+int User::GetUserId() const
 {
     // Return the current value of the user_id member variable.
     return user_id;
@@ -97,17 +96,14 @@ int User::GetUserId()
  * @param book Shared pointer to the book to be borrowed.
  * @return Ret_val_t Enumeration indicating the result of the operation.
 */
-Ret_val_t User::UserBorrowBook(shared_ptr<Book> book)
+Ret_val_t User::UserBorrowBook(const shared_ptr<Book> &book)
 {
-    // Check if the book is available for borrowing.
-    if(book->GetBookAvailability())
+    // Atomically claim the book, only one of several concurrent borrowers can win it.
+    if(book->TryClaim(user_id))
     {
-        // Set availability to false since the book will be borrowed.
-        bool avail = false;
-        // Add the book to the list of borrowed books.
+        // Add the book to the list of borrowed books, remembering its position.
+        book->SetLoanIndex(static_cast<uint32_t>(books_borrowed.size()));
         books_borrowed.push_back(book);
-        // Update the book's availability status.
-        book->SetBookAvailability(avail);
         // Return TRUE to indicate successful borrowing.
         return TRUE;
     }
@@ -123,47 +119,47 @@ Ret_val_t User::UserBorrowBook(shared_ptr<Book> book)
  * @brief Allows the user to return a book.
  * 
  * Removes the specified book from the list of borrowed books if the book is currently
- * borrowed by the user.
+ * borrowed by the user. The book is found through its loan index and the last book of the
+ * list takes its place, so the return is O(1) whatever the number of loans.
  * 
  * @param book Shared pointer to the book to be returned.
  * @return Ret_val_t Enumeration indicating the result of the operation.
 */
-Ret_val_t User::UserReturnBook(shared_ptr<Book> book)
+Ret_val_t User::UserReturnBook(const shared_ptr<Book> &book)
 {
-    // Initialize the result to FALSE, indicating failure by default.
-    Ret_val_t temp = FALSE;
+    ///< The position the book was stored at when it was borrowed.
+    uint32_t index = book->GetLoanIndex();
+
+    ///< Check if the book is in the list of borrowed books at that position.
+    if(index >= books_borrowed.size() || books_borrowed[index] != book)
+    {
+        return FALSE;
+    }
 
-    //< Iterator to traverse the list of borrowed books.
-    vector<shared_ptr<Book>>::iterator it = books_borrowed.begin();
-     // Check if the book is in the list of borrowed books.
-    for(; it!= books_borrowed.end(); it++)
-    {   
-       
-        ///< Check if the book is in the list of borrowed books  
-        if(*it == book)
-        {
-             // Set availability to true since the book will be returned.
-            bool avail = true;
-            //< Remove the book from the list of borrowed books.
-            books_borrowed.erase(it);
-            ///< Update the book's availability status.
-            book->SetBookAvailability(avail);
-            ///< Set the result to TRUE, indicating successful return.
-            temp = TRUE;
-            ///< Exit the loop as the book has been found and removed.
-            break;    
-        }
+    ///< Atomically release the book, it must still be on loan to this user.
+    if(!book->Release(user_id))
+    {
+        return FALSE;
+    }
+
+    ///< Move the last book of the list into the freed position and drop the tail.
+    if(index + 1 != books_borrowed.size())
+    {
+        books_borrowed[index] = std::move(books_borrowed.back());
+        books_borrowed[index]->SetLoanIndex(index);
     }
-     ///< Return the result of the operation (TRUE or FALSE).
-    return temp;
+    books_borrowed.pop_back();
+
+    ///< Return TRUE, indicating successful return.
+    return TRUE;
 }
 
 /**
  * @brief Gets the list of books borrowed by the user.
  * 
- * @return A vector of shared pointers to the books borrowed by the user.
+ * @return A read-only view of the books borrowed by the user, valid until the next borrow or return.
 */
-vector<shared_ptr<Book>> User::GetBorrowedBooks()
+const vector<shared_ptr<Book>> &User::GetBorrowedBooks() const
 {
      ///< Return the list of borrowed books.
     return books_borrowed;
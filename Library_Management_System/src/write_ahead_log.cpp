@@ -0,0 +1,486 @@
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+#include <mutex>
+#include <condition_variable>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "write_ahead_log.hpp"
+#include "library.hpp"
+
+using namespace std;
+
+/* The size of the header of a record: payload length, checksum and kind. */
+static const size_t RECORD_HEADER_SIZE = 2 * sizeof(uint32_t) + 1;
+
+/* The largest payload accepted on replay, anything bigger is a corrupted length. */
+static const uint32_t MAX_PAYLOAD_SIZE = 1 << 24;
+
+/**
+ * @brief Computes the FNV-1a checksum of the kind and payload of a record.
+ *
+ * @param kind The kind of the record.
+ * @param payload The payload of the record.
+ * @param size The size of the payload.
+ * @return uint32_t The checksum.
+*/
+static uint32_t Checksum(uint8_t kind, const char *payload, size_t size)
+{
+    uint32_t hash = 2166136261u;
+    hash = (hash ^ kind) * 16777619u;
+    for(size_t i = 0; i < size; i++)
+    {
+        hash = (hash ^ static_cast<uint8_t>(payload[i])) * 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * @brief Appends a fixed-width integer to a payload.
+ *
+ * @param payload The payload being encoded.
+ * @param value The value to append.
+*/
+template <typename T>
+static void PutValue(string &payload, T value)
+{
+    payload.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+/**
+ * @brief Appends a length-prefixed string to a payload.
+ *
+ * @param payload The payload being encoded.
+ * @param value The string to append.
+*/
+static void PutString(string &payload, const string &value)
+{
+    PutValue<uint32_t>(payload, static_cast<uint32_t>(value.size()));
+    payload.append(value);
+}
+
+/**
+ * @brief Reads a fixed-width integer from a payload.
+ *
+ * @param cursor The next byte of the payload, moved past the value.
+ * @param end The end of the payload.
+ * @param value Receives the value.
+ * @return false if the payload is too short.
+*/
+template <typename T>
+static bool GetValue(const char *&cursor, const char *end, T &value)
+{
+    if(static_cast<size_t>(end - cursor) < sizeof(value))
+    {
+        return false;
+    }
+    memcpy(&value, cursor, sizeof(value));
+    cursor += sizeof(value);
+    return true;
+}
+
+/**
+ * @brief Reads a length-prefixed string from a payload.
+ *
+ * @param cursor The next byte of the payload, moved past the string.
+ * @param end The end of the payload.
+ * @param value Receives the string.
+ * @return false if the payload is too short.
+*/
+static bool GetString(const char *&cursor, const char *end, string &value)
+{
+    uint32_t length;
+    if(!GetValue(cursor, end, length) || static_cast<size_t>(end - cursor) < length)
+    {
+        return false;
+    }
+    value.assign(cursor, length);
+    cursor += length;
+    return true;
+}
+
+/**
+ * @brief Destructs the log, committing the pending records.
+*/
+WriteAheadLog::~WriteAheadLog()
+{
+    Close();
+}
+
+/**
+ * @brief Opens (or creates) a log file for replay and appending.
+ *
+ * @param path The path of the log file.
+ * @return true if the file could be opened.
+*/
+bool WriteAheadLog::Open(const string &path)
+{
+    Close();
+    fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    healthy = (fd >= 0);
+    return healthy;
+}
+
+/**
+ * @brief Commits the pending records and closes the log file.
+*/
+void WriteAheadLog::Close()
+{
+    if(fd < 0)
+    {
+        return;
+    }
+    Commit(last_sequence);
+    close(fd);
+    fd = -1;
+}
+
+/**
+ * @brief Frames a payload as a record and appends it to the pending batch.
+ *
+ * @param kind The kind of the record.
+ * @param payload The encoded fields of the record.
+ * @return uint64_t The sequence number of the record.
+*/
+uint64_t WriteAheadLog::Append(log_record_t kind, const string &payload)
+{
+    // Frame the record outside the lock.
+    string record;
+    record.reserve(RECORD_HEADER_SIZE + payload.size());
+    PutValue<uint32_t>(record, static_cast<uint32_t>(payload.size()));
+    PutValue<uint32_t>(record, Checksum(static_cast<uint8_t>(kind), payload.data(), payload.size()));
+    PutValue<uint8_t>(record, static_cast<uint8_t>(kind));
+    record.append(payload);
+
+    // Queue it in the pending batch, in sequence order.
+    lock_guard<mutex> guard(lock);
+    pending.append(record);
+    return ++last_sequence;
+}
+
+/**
+ * @brief Waits until a record and every record before it are on disk.
+ *
+ * @param sequence The sequence number returned when the record was logged.
+ * @return true if the record is durable, false if the log could not be written.
+*/
+bool WriteAheadLog::Commit(uint64_t sequence)
+{
+    unique_lock<mutex> guard(lock);
+
+    while(healthy && durable_sequence < sequence)
+    {
+        if(flushing)
+        {
+            // A leader is writing, its batch may already hold the record.
+            flushed.wait(guard);
+            continue;
+        }
+
+        // Become the leader: take the whole pending batch and write it without the lock.
+        flushing = true;
+        string batch;
+        batch.swap(pending);
+        uint64_t batch_last = last_sequence;
+        guard.unlock();
+
+        bool written = true;
+        const char *data = batch.data();
+        size_t left = batch.size();
+        while(written && left > 0)
+        {
+            // A write interrupted by a signal is retried, any other failure is final.
+            ssize_t count = write(fd, data, left);
+            if(count < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            written = (count > 0);
+            if(written)
+            {
+                data += count;
+                left -= static_cast<size_t>(count);
+            }
+        }
+        written = written && (fdatasync(fd) == 0);
+
+        // Publish the new durable point and wake the followers.
+        guard.lock();
+        flushing = false;
+        healthy = healthy && written;
+        durable_sequence = batch_last;
+        batch_count++;
+        flushed.notify_all();
+    }
+
+    return healthy;
+}
+
+/**
+ * @brief Applies every record of the log to a library.
+ *
+ * @param library The library the records are applied to.
+ * @return size_t The number of records replayed.
+*/
+size_t WriteAheadLog::Replay(Library &library)
+{
+    struct stat info;
+    if(fd < 0 || fstat(fd, &info) != 0)
+    {
+        return 0;
+    }
+
+    // Read the whole log, it only holds the mutations since the last snapshot.
+    string content(static_cast<size_t>(info.st_size), '\0');
+    size_t read_bytes = 0;
+    while(read_bytes < content.size())
+    {
+        ssize_t count = pread(fd, &content[read_bytes], content.size() - read_bytes, read_bytes);
+        if(count <= 0)
+        {
+            break;
+        }
+        read_bytes += static_cast<size_t>(count);
+    }
+    content.resize(read_bytes);
+
+    size_t replayed = 0;
+    size_t offset = 0;
+    while(content.size() - offset >= RECORD_HEADER_SIZE)
+    {
+        // Check the frame of the record, a torn or corrupted record ends the log.
+        const char *header = content.data() + offset;
+        uint32_t size, checksum;
+        memcpy(&size, header, sizeof(size));
+        memcpy(&checksum, header + sizeof(size), sizeof(checksum));
+        uint8_t kind = static_cast<uint8_t>(header[2 * sizeof(uint32_t)]);
+        if(size > MAX_PAYLOAD_SIZE || content.size() - offset - RECORD_HEADER_SIZE < size)
+        {
+            break;
+        }
+        const char *cursor = header + RECORD_HEADER_SIZE;
+        const char *end = cursor + size;
+        if(Checksum(kind, cursor, size) != checksum)
+        {
+            break;
+        }
+
+        // Decode the record and apply it.
+        bool valid = false;
+        string title, author, gener, ISBN, name;
+        int32_t id;
+        uint64_t key, extra;
+        switch(kind)
+        {
+            case LOG_ADD_BOOK:
+                valid = GetString(cursor, end, title) && GetString(cursor, end, author) &&
+                        GetString(cursor, end, gener) && GetString(cursor, end, ISBN);
+                if(valid)
+                {
+                    library.EmplaceBook(title, author, gener, ISBN);
+                }
+                break;
+            case LOG_REMOVE_BOOK:
+                valid = GetString(cursor, end, ISBN);
+                if(valid)
+                {
+                    library.RemoveBookFromLibrary(ISBN);
+                }
+                break;
+            case LOG_REGISTER_USER:
+                valid = GetValue(cursor, end, id) && GetString(cursor, end, name);
+                if(valid)
+                {
+                    library.EmplaceUser(name, id);
+                }
+                break;
+            case LOG_REMOVE_USER:
+                valid = GetValue(cursor, end, id);
+                if(valid)
+                {
+                    library.RemoveUserFromLibrary(id);
+                }
+                break;
+            case LOG_BORROW_BOOK:
+                valid = GetValue(cursor, end, id) && GetValue(cursor, end, key) && GetValue(cursor, end, extra);
+                if(valid)
+                {
+                    library.UserBorrowBook(id, IsbnKey::FromValue(key, extra));
+                }
+                break;
+            case LOG_RETURN_BOOK:
+                valid = GetValue(cursor, end, id) && GetValue(cursor, end, key) && GetValue(cursor, end, extra);
+                if(valid)
+                {
+                    library.UserReturnBook(id, IsbnKey::FromValue(key, extra));
+                }
+                break;
+            default:
+                break;
+        }
+        if(!valid)
+        {
+            // An intact record this version can't read is not a torn tail: keep the file as it is
+            // and refuse new records, which would follow a record no replay gets past.
+            healthy = false;
+            return replayed;
+        }
+
+        offset += RECORD_HEADER_SIZE + size;
+        replayed++;
+    }
+
+    // Cut the torn tail so the next records follow the last valid one.
+    if(offset < static_cast<size_t>(info.st_size) && ftruncate(fd, static_cast<off_t>(offset)) != 0)
+    {
+        healthy = false;
+    }
+    lseek(fd, static_cast<off_t>(offset), SEEK_SET);
+
+    return replayed;
+}
+
+/**
+ * @brief Empties the log, once a snapshot holds the effect of every record.
+ *
+ * Every record logged so far must be covered by the snapshot, so the call must be made while
+ * the library still blocks every mutation, as Library::Checkpoint() does: the pending records
+ * are dropped and reported durable to their waiters.
+ *
+ * @return true if the file could be truncated.
+*/
+bool WriteAheadLog::Truncate()
+{
+    unique_lock<mutex> guard(lock);
+
+    // Let a leader finish its write, it must not land after the truncation.
+    while(flushing)
+    {
+        flushed.wait(guard);
+    }
+
+    pending.clear();
+    bool truncated = (fd >= 0) && ftruncate(fd, 0) == 0 && lseek(fd, 0, SEEK_SET) == 0 && fdatasync(fd) == 0;
+
+    // The snapshot holds every record logged so far.
+    durable_sequence = last_sequence;
+    flushed.notify_all();
+
+    return truncated;
+}
+
+/**
+ * @brief Logs the addition of a book.
+ *
+ * @param title The title of the book.
+ * @param author The author of the book.
+ * @param gener The genre of the book.
+ * @param ISBN The serial number of the book.
+ * @return uint64_t The sequence number to commit.
+*/
+uint64_t WriteAheadLog::LogAddBook(const string &title, const string &author, const string &gener, const string &ISBN)
+{
+    string payload;
+    PutString(payload, title);
+    PutString(payload, author);
+    PutString(payload, gener);
+    PutString(payload, ISBN);
+    return Append(LOG_ADD_BOOK, payload);
+}
+
+/**
+ * @brief Logs the removal of a book.
+ *
+ * @param ISBN The serial number of the book.
+ * @return uint64_t The sequence number to commit.
+*/
+uint64_t WriteAheadLog::LogRemoveBook(const string &ISBN)
+{
+    string payload;
+    PutString(payload, ISBN);
+    return Append(LOG_REMOVE_BOOK, payload);
+}
+
+/**
+ * @brief Logs the registration of a user.
+ *
+ * @param id The ID of the user.
+ * @param name The name of the user.
+ * @return uint64_t The sequence number to commit.
+*/
+uint64_t WriteAheadLog::LogRegisterUser(int id, const string &name)
+{
+    string payload;
+    PutValue<int32_t>(payload, id);
+    PutString(payload, name);
+    return Append(LOG_REGISTER_USER, payload);
+}
+
+/**
+ * @brief Logs the removal of a user.
+ *
+ * @param id The ID of the user.
+ * @return uint64_t The sequence number to commit.
+*/
+uint64_t WriteAheadLog::LogRemoveUser(int id)
+{
+    string payload;
+    PutValue<int32_t>(payload, id);
+    return Append(LOG_REMOVE_USER, payload);
+}
+
+/**
+ * @brief Logs a loan.
+ *
+ * @param user_id The ID of the borrower.
+ * @param key The key of the book.
+ * @return uint64_t The sequence number to commit.
+*/
+uint64_t WriteAheadLog::LogBorrowBook(int user_id, IsbnKey key)
+{
+    string payload;
+    PutValue<int32_t>(payload, user_id);
+    PutValue<uint64_t>(payload, key.GetValue());
+    PutValue<uint64_t>(payload, key.GetExtra());
+    return Append(LOG_BORROW_BOOK, payload);
+}
+
+/**
+ * @brief Logs a return.
+ *
+ * @param user_id The ID of the borrower.
+ * @param key The key of the book.
+ * @return uint64_t The sequence number to commit.
+*/
+uint64_t WriteAheadLog::LogReturnBook(int user_id, IsbnKey key)
+{
+    string payload;
+    PutValue<int32_t>(payload, user_id);
+    PutValue<uint64_t>(payload, key.GetValue());
+    PutValue<uint64_t>(payload, key.GetExtra());
+    return Append(LOG_RETURN_BOOK, payload);
+}
+
+/**
+ * @brief Tells whether records can still be appended to the log.
+ *
+ * @return true if every write and sync succeeded and the replay could read every intact record.
+*/
+bool WriteAheadLog::IsHealthy()
+{
+    lock_guard<mutex> guard(lock);
+    return healthy;
+}
+
+/**
+ * @brief Gets the number of batches written so far.
+ *
+ * @return The number of fsyncs issued by the group commit.
+*/
+uint64_t WriteAheadLog::BatchCount()
+{
+    lock_guard<mutex> guard(lock);
+    return batch_count;
+}
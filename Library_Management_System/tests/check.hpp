@@ -0,0 +1,42 @@
+#ifndef _CHECK_HPP_
+#define _CHECK_HPP_
+
+#include <iostream>
+
+/**
+ * @brief The minimal assertions of the unit tests, which need nothing beyond the core.
+ *
+ * A failed CHECK() reports its file, line and condition and the test goes on; REQUIRE() also
+ * returns from the calling test function. Every test program returns CheckFailures() from
+ * main(), so ctest fails when any check did.
+ */
+
+/**
+ * @brief Gets the number of checks failed so far by the test program.
+*/
+inline int &CheckFailures()
+{
+    static int failures = 0;
+    return failures;
+}
+
+/**
+ * @brief Records the outcome of a check, reporting it when it failed.
+ *
+ * @return The outcome of the check.
+*/
+inline bool Check(bool passed, const char *condition, const char *file, int line)
+{
+    if(!passed)
+    {
+        std::cerr << file << ":" << line << ": check failed: " << condition << "\n";
+        CheckFailures()++;
+    }
+    return passed;
+}
+
+#define CHECK(condition) Check(static_cast<bool>(condition), #condition, __FILE__, __LINE__)
+
+#define REQUIRE(condition) do { if(!CHECK(condition)) return; } while(0)
+
+#endif
@@ -0,0 +1,237 @@
+#include <string>
+#include <vector>
+#include <memory>
+#include <random>
+#include <type_traits>
+#include <utility>
+#include <unordered_map>
+#include "flat_hash_map.hpp"
+#include "check.hpp"
+
+using namespace std;
+
+/**
+ * @brief Tests of the open addressing hash map, checked operation by operation against
+ * std::unordered_map: inserts, erases leaving tombstones, rehashes and moves.
+ */
+
+// The entries expose a const key, as those of std::unordered_map do
+static_assert(is_same<FlatHashMap<int, string>::value_type, unordered_map<int, string>::value_type>::value,
+              "the entries of the map must be pair<const K, V>");
+static_assert(!is_assignable<decltype((declval<FlatHashMap<int, string>::iterator>()->first)), int>::value,
+              "the key of an entry must not be assignable through an iterator");
+
+/**
+ * @brief A hash sending every key to one of a few values, so the probe sequences collide.
+ */
+struct CollidingHash
+{
+    size_t operator()(int key) const
+    {
+        return static_cast<size_t>(key % 7) * 0x9e3779b97f4a7c15ULL;
+    }
+};
+
+/**
+ * @brief Checks that a map holds exactly the entries of the reference map.
+*/
+template <typename Map>
+static void CheckSameEntries(const Map &map, const unordered_map<int, string> &reference)
+{
+    CHECK(map.size() == reference.size());
+    CHECK(map.empty() == reference.empty());
+
+    // Every entry is visited once and matches the reference
+    size_t visited = 0;
+    for(auto it = map.begin(); it != map.end(); ++it)
+    {
+        auto expected = reference.find(it->first);
+        CHECK(expected != reference.end() && expected->second == it->second);
+        visited++;
+    }
+    CHECK(visited == reference.size());
+
+    for(const pair<const int, string> &entry : reference)
+    {
+        auto found = map.find(entry.first);
+        CHECK(found != map.end() && found->second == entry.second);
+    }
+}
+
+/**
+ * @brief Runs random inserts, overwrites and erases over a small key range, so the erased slots
+ * turn into tombstones that later inserts reuse and rehashes drop.
+*/
+template <typename Hash>
+static void TestRandomOperations(unsigned seed, int key_range, size_t operations)
+{
+    FlatHashMap<int, string, Hash> map;
+    unordered_map<int, string> reference;
+    mt19937 random(seed);
+
+    for(size_t i = 0; i < operations; i++)
+    {
+        int key = static_cast<int>(random() % key_range);
+        switch(random() % 6)
+        {
+            case 0:
+            case 1:
+            {
+                // Insert, an existing key keeps its value
+                string value = "v" + to_string(i);
+                bool inserted = map.emplace(key, value).second;
+                CHECK(inserted == reference.emplace(key, value).second);
+                break;
+            }
+            case 2:
+            {
+                // Overwrite through operator[]
+                map[key] = "w" + to_string(i);
+                reference[key] = "w" + to_string(i);
+                break;
+            }
+            case 3:
+            case 4:
+            {
+                // Erase by key
+                CHECK(map.erase(key) == reference.erase(key));
+                break;
+            }
+            default:
+            {
+                // Erase through an iterator, or look a key up
+                auto found = map.find(key);
+                CHECK((found != map.end()) == (reference.count(key) == 1));
+                if(found != map.end() && (i % 2) == 0)
+                {
+                    map.erase(found);
+                    reference.erase(key);
+                }
+                CHECK(map.count(key) == reference.count(key));
+                break;
+            }
+        }
+
+        if(i % 997 == 0)
+        {
+            CheckSameEntries(map, reference);
+        }
+    }
+    CheckSameEntries(map, reference);
+
+    // Emptying the map one key at a time leaves only tombstones, which the next inserts reuse
+    for(int key = 0; key < key_range; key++)
+    {
+        CHECK(map.erase(key) == reference.erase(key));
+    }
+    CheckSameEntries(map, reference);
+    for(int key = 0; key < key_range; key += 3)
+    {
+        map.emplace(key, to_string(key));
+        reference.emplace(key, to_string(key));
+    }
+    CheckSameEntries(map, reference);
+}
+
+/**
+ * @brief Growing from empty through many rehashes, with and without a reservation.
+*/
+static void TestGrowth()
+{
+    for(bool reserved : {false, true})
+    {
+        FlatHashMap<int, string> map;
+        unordered_map<int, string> reference;
+        if(reserved)
+        {
+            map.reserve(50000);
+        }
+        for(int key = 0; key < 50000; key++)
+        {
+            map.emplace(key * 31, to_string(key));
+            reference.emplace(key * 31, to_string(key));
+        }
+        CheckSameEntries(map, reference);
+
+        // Erase most entries, then refill: the tombstones force a rehash at the same size
+        for(int key = 0; key < 50000; key++)
+        {
+            if(key % 8 != 0)
+            {
+                map.erase(key * 31);
+                reference.erase(key * 31);
+            }
+        }
+        for(int key = 50000; key < 90000; key++)
+        {
+            map.emplace(key * 31, to_string(key));
+            reference.emplace(key * 31, to_string(key));
+        }
+        CheckSameEntries(map, reference);
+
+        map.clear();
+        reference.clear();
+        CheckSameEntries(map, reference);
+        map.emplace(7, "seven");
+        reference.emplace(7, "seven");
+        CheckSameEntries(map, reference);
+    }
+}
+
+/**
+ * @brief Moving and swapping maps moves their entries, values without a copy included.
+*/
+static void TestMoveAndSwap()
+{
+    FlatHashMap<int, string> first;
+    FlatHashMap<int, string> second;
+    unordered_map<int, string> first_reference;
+    unordered_map<int, string> second_reference;
+    for(int key = 0; key < 1000; key++)
+    {
+        first.emplace(key, "a" + to_string(key));
+        first_reference.emplace(key, "a" + to_string(key));
+    }
+    second.emplace(-1, "b");
+    second_reference.emplace(-1, "b");
+
+    first.swap(second);
+    CheckSameEntries(first, second_reference);
+    CheckSameEntries(second, first_reference);
+
+    FlatHashMap<int, string> moved(std::move(second));
+    CheckSameEntries(moved, first_reference);
+    CheckSameEntries(second, unordered_map<int, string>());
+
+    first = std::move(moved);
+    CheckSameEntries(first, first_reference);
+
+    // Values that can only be moved live in the map in place
+    FlatHashMap<int, unique_ptr<int>> owners;
+    for(int key = 0; key < 100; key++)
+    {
+        owners.emplace(key, unique_ptr<int>(new int(key)));
+    }
+    for(int key = 0; key < 100; key += 2)
+    {
+        owners.erase(key);
+    }
+    bool intact = true;
+    for(auto it = owners.begin(); it != owners.end(); ++it)
+    {
+        intact &= (it->first % 2 == 1) && (*it->second == it->first);
+    }
+    CHECK(intact);
+    CHECK(owners.size() == 50);
+}
+
+int main()
+{
+    TestRandomOperations<hash<int>>(1, 64, 200000);
+    TestRandomOperations<hash<int>>(2, 5000, 200000);
+    TestRandomOperations<CollidingHash>(3, 300, 50000);
+    TestGrowth();
+    TestMoveAndSwap();
+
+    return (CheckFailures() == 0) ? 0 : 1;
+}
@@ -0,0 +1,132 @@
+#include <string>
+#include "isbn_key.hpp"
+#include "check.hpp"
+
+using namespace std;
+
+/**
+ * @brief Tests of the binary ISBN keys: checksums of ISBN-10 and ISBN-13, conversion of an
+ * ISBN-10 to its ISBN-13 form, and local serials kept byte for byte.
+ */
+
+/**
+ * @brief Checks that a key survives a trip through its packed words.
+*/
+static void CheckRebuilds(const IsbnKey &key)
+{
+    CHECK(IsbnKey::FromValue(key.GetValue(), key.GetExtra()) == key);
+}
+
+/**
+ * @brief Valid ISBN-13s are normalized to their 13 digits, separators ignored.
+*/
+static void TestIsbn13()
+{
+    IsbnKey key = IsbnKey::FromString("978-0-306-40615-7");
+    CHECK(key.IsValid() && key.IsIsbn());
+    CHECK(key.ToString() == "9780306406157");
+    CHECK(key.GetValue() == 9780306406157ULL);
+    CHECK(key.GetExtra() == 0);
+    CHECK(IsbnKey::FromString("9780306406157") == key);
+    CHECK(IsbnKey::FromString(" 978 0306406157 ") == key);
+    CheckRebuilds(key);
+
+    // The 979 prefix has no ISBN-10 form
+    IsbnKey prefix979 = IsbnKey::FromString("979-10-90636-07-1");
+    CHECK(prefix979.IsIsbn() && prefix979.ToString() == "9791090636071");
+}
+
+/**
+ * @brief Valid ISBN-10s are converted to the ISBN-13 of the same book.
+*/
+static void TestIsbn10()
+{
+    CHECK(IsbnKey::FromString("0-306-40615-2") == IsbnKey::FromString("9780306406157"));
+    CHECK(IsbnKey::FromString("0306406152").ToString() == "9780306406157");
+
+    // An X check character stands for 10, in either case
+    IsbnKey with_x = IsbnKey::FromString("0-8044-2957-X");
+    CHECK(with_x.IsIsbn() && with_x.ToString() == "9780804429573");
+    CHECK(IsbnKey::FromString("080442957x") == with_x);
+    CheckRebuilds(with_x);
+
+    // The ISBN-13 check digit is recomputed, not copied from the ISBN-10
+    CHECK(IsbnKey::FromString("0-19-852663-6").ToString() == "9780198526636");
+    CHECK(IsbnKey::FromString("1-56619-909-3").ToString() == "9781566199094");
+}
+
+/**
+ * @brief A serial shaped like an ISBN but failing its checksum is invalid, with or without separators.
+*/
+static void TestBadChecksums()
+{
+    for(const char *serial : {"9780306406158", "978-0-306-40615-8", "978 0306406158", "0306406153", "0-306-40615-3",
+                              "0 306 40615 3", "0-306-40615-X", "030640615x"})
+    {
+        CHECK(!IsbnKey::FromString(serial).IsValid());
+    }
+
+    // An X anywhere but the check character is not ISBN-shaped, so it is a local serial
+    IsbnKey inner_x = IsbnKey::FromString("03064X6152");
+    CHECK(inner_x.IsValid() && !inner_x.IsIsbn());
+    CHECK(inner_x.ToString() == "03064X6152");
+
+    // Other digit counts are local serials too
+    CHECK(IsbnKey::FromString("030640615").IsValid() && !IsbnKey::FromString("030640615").IsIsbn());
+    CHECK(IsbnKey::FromString("97803064061571").IsValid() && !IsbnKey::FromString("97803064061571").IsIsbn());
+}
+
+/**
+ * @brief Local serials are kept byte for byte, up to 15 printable characters.
+*/
+static void TestLocalSerials()
+{
+    IsbnKey short_serial = IsbnKey::FromString("123qwe");
+    CHECK(short_serial.IsValid() && !short_serial.IsIsbn());
+    CHECK(short_serial.ToString() == "123qwe");
+    CHECK(short_serial.GetExtra() == 0);
+    CheckRebuilds(short_serial);
+
+    // The separators of a local serial are part of it
+    CHECK(IsbnKey::FromString("173-813") != IsbnKey::FromString("1738-13"));
+    CHECK(IsbnKey::FromString("173-813").ToString() == "173-813");
+    CHECK(IsbnKey::FromString("A B") != IsbnKey::FromString("AB"));
+    CHECK(IsbnKey::FromString("A B").ToString() == "A B");
+
+    // Separators count towards the 15 characters of a local serial
+    CHECK(IsbnKey::FromString("AB-CD-EF-GH-IJK").IsValid());
+    CHECK(!IsbnKey::FromString("AB-CD-EF-GH-IJKL").IsValid());
+
+    // Characters 8 to 15 live in the second word
+    IsbnKey longest = IsbnKey::FromString("ABCDEFGHIJKLMNO");
+    CHECK(longest.IsValid() && longest.ToString() == "ABCDEFGHIJKLMNO");
+    CHECK(longest.GetExtra() != 0);
+    CheckRebuilds(longest);
+    CHECK(IsbnKey::FromString("ABCDEFGH1") != IsbnKey::FromString("ABCDEFGH2"));
+    CHECK(IsbnKey::FromString("ABCDEFG") != IsbnKey::FromString("ABCDEFG "));
+    CHECK(IsbnKeyHash()(IsbnKey::FromString("ABCDEFGH1")) != IsbnKeyHash()(IsbnKey::FromString("ABCDEFGH2")));
+}
+
+/**
+ * @brief Empty, too long or unprintable serials give the invalid key.
+*/
+static void TestInvalidSerials()
+{
+    CHECK(!IsbnKey::FromString("").IsValid());
+    CHECK(!IsbnKey::FromString("ABCDEFGHIJKLMNOP").IsValid());
+    CHECK(!IsbnKey::FromString(string("ab\x01", 3)).IsValid());
+    CHECK(!IsbnKey::FromString(string("ab\0c", 4)).IsValid());
+    CHECK(!IsbnKey().IsValid());
+    CHECK(IsbnKey().ToString().empty());
+}
+
+int main()
+{
+    TestIsbn13();
+    TestIsbn10();
+    TestBadChecksums();
+    TestLocalSerials();
+    TestInvalidSerials();
+
+    return (CheckFailures() == 0) ? 0 : 1;
+}
@@ -0,0 +1,305 @@
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+#include "library.hpp"
+#include "book.hpp"
+#include "user.hpp"
+#include "check.hpp"
+
+using namespace std;
+
+/**
+ * @brief Tests of the binary snapshots: a round trip of books, users and loans, the rejection of
+ * damaged files, which must leave the library they are loaded into untouched, and books held
+ * past the library they were loaded into.
+ *
+ * Usage: snapshot_test [directory]   (default: the current directory, for the scratch files)
+ */
+
+/* The directory of the scratch files. */
+static string scratch_directory = ".";
+
+/**
+ * @brief Gets the path of a scratch file.
+*/
+static string ScratchPath(const string &name)
+{
+    return scratch_directory + "/" + name;
+}
+
+/**
+ * @brief Reads a whole file.
+*/
+static string ReadFile(const string &path)
+{
+    ifstream in(path, ios::binary);
+    return string(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+}
+
+/**
+ * @brief Writes a whole file.
+*/
+static void WriteFile(const string &path, const string &bytes)
+{
+    ofstream out(path, ios::binary | ios::trunc);
+    out.write(bytes.data(), bytes.size());
+}
+
+/**
+ * @brief Describes the books, loans and users of a library in a canonical order.
+ *
+ * @param library The library to describe.
+ * @return One line per book (serial, title, author, genre, borrower) and per user (ID, name, loans).
+*/
+static vector<string> Describe(Library &library)
+{
+    vector<string> lines;
+    for(const shared_ptr<Book> &book : library.GetAllBooks())
+    {
+        int borrower = 0;
+        book->GetBookBorrower(borrower);
+        lines.push_back("book " + book->GetBookNumber() + " " + book->GetBookName() + " " + book->GetBookAuthor() + " " +
+                        book->GetBookGener() + " " + to_string(borrower));
+    }
+    for(User *user : library.GetAllUsers())
+    {
+        // The loans of a user are listed in the order they were made
+        string line = "user " + to_string(user->GetUserId()) + " " + user->GetUserName();
+        for(const shared_ptr<Book> &book : user->GetBorrowedBooks())
+        {
+            line += " " + book->GetBookNumber();
+        }
+        lines.push_back(line);
+    }
+    sort(lines.begin(), lines.end());
+    return lines;
+}
+
+/**
+ * @brief Fills a library with the books of three genres, two users, three loans and a removed book.
+ *
+ * @return true if every operation succeeded.
+*/
+static bool FillLibrary(Library &library)
+{
+    bool filled = true;
+    for(int i = 0; i < 20; i++)
+    {
+        filled &= CHECK(library.EmplaceBook("Title " + to_string(i), "Author " + to_string(i % 3), (i % 2) ? "Physics" : "Law",
+                                            "L" + to_string(i)) == ADDED_SUCCESSFULLY);
+    }
+    filled &= CHECK(library.EmplaceBook("Introduction to Algorithms", "Cormen", "Computing", "978-0-262-03384-8") == ADDED_SUCCESSFULLY);
+    filled &= CHECK(library.EmplaceUser("ada", 1) == ADDED_SUCCESSFULLY);
+    filled &= CHECK(library.EmplaceUser("alan", 2) == ADDED_SUCCESSFULLY);
+    filled &= CHECK(library.UserBorrowBook(1, string("L7")) == LOAN_SUCCEEDED);
+    filled &= CHECK(library.UserBorrowBook(1, string("L3")) == LOAN_SUCCEEDED);
+    filled &= CHECK(library.UserBorrowBook(2, string("9780262033848")) == LOAN_SUCCEEDED);
+
+    // A removed book leaves a free slot behind
+    filled &= CHECK(library.RemoveBookFromLibrary("L10") == REMOVED);
+    return filled;
+}
+
+/**
+ * @brief A saved library loads back with the same books, users, loans and indexes.
+*/
+static void TestRoundTrip()
+{
+    string path = ScratchPath("round_trip.snap");
+    Library saved;
+    REQUIRE(FillLibrary(saved));
+    REQUIRE(saved.SaveSnapshot(path) == SNAPSHOT_SAVED);
+
+    Library loaded;
+    REQUIRE(loaded.LoadSnapshot(path) == SNAPSHOT_LOADED);
+    CHECK(Describe(loaded) == Describe(saved));
+    CHECK(loaded.CountBorrowedBooks() == 3);
+    CHECK(loaded.CountAvailableBooks() == saved.CountAvailableBooks());
+
+    // The restored indexes answer like the saved ones
+    CHECK(loaded.SearchForBook("Introduction to Algorithms") != nullptr);
+    CHECK(loaded.SearchForBooksByAuthor("Author 1").size() == saved.SearchForBooksByAuthor("Author 1").size());
+    CHECK(loaded.SearchForBooksByGenre("physics").size() == 10);
+    CHECK(loaded.GetGenreInventory("Law").available == saved.GetGenreInventory("Law").available);
+
+    // The restored loans can be returned, and the free slot reused
+    int borrower = 0;
+    CHECK(loaded.FindBookBorrower("L3", borrower) && borrower == 1);
+    CHECK(loaded.UserReturnBook(1, string("L3")) == LOAN_SUCCEEDED);
+    CHECK(loaded.UserBorrowBook(2, string("L3")) == LOAN_SUCCEEDED);
+    CHECK(loaded.EmplaceBook("Title 10", "Author 1", "Law", "L10") == ADDED_SUCCESSFULLY);
+}
+
+/**
+ * @brief A loaded snapshot replaces the library, the books still held by a caller stay alive.
+*/
+static void TestLoadReplacesLibrary()
+{
+    string path = ScratchPath("replace.snap");
+    Library saved;
+    REQUIRE(FillLibrary(saved));
+    REQUIRE(saved.SaveSnapshot(path) == SNAPSHOT_SAVED);
+
+    Library library;
+    REQUIRE(library.EmplaceBook("Other", "Someone", "Poetry", "X1") == ADDED_SUCCESSFULLY);
+    shared_ptr<Book> held = library.SearchForBook("Other");
+    REQUIRE(held != nullptr);
+
+    REQUIRE(library.LoadSnapshot(path) == SNAPSHOT_LOADED);
+    CHECK(Describe(library) == Describe(saved));
+    CHECK(library.SearchForBook("Other") == nullptr);
+    CHECK(held->GetBookName() == "Other");
+}
+
+/**
+ * @brief Books held by a caller outlive the library, whichever way they were added.
+ *
+ * The books and their control blocks live in the arena of the library, which they co-own: a
+ * build with -fsanitize=address reports any access to a released slab.
+*/
+static void TestBooksOutliveLibrary()
+{
+    string path = ScratchPath("outlive.snap");
+    {
+        Library saved;
+        REQUIRE(FillLibrary(saved));
+        REQUIRE(saved.SaveSnapshot(path) == SNAPSHOT_SAVED);
+    }
+
+    shared_ptr<Book> emplaced, imported, loaded;
+    vector<shared_ptr<Book>> listed;
+    {
+        Library library;
+        REQUIRE(library.EmplaceBook("Other", "Someone", "Poetry", "X1") == ADDED_SUCCESSFULLY);
+        emplaced = library.SearchForBook("Other");
+        vector<BookRecord> records = {{"Imported", "Someone", "Poetry", "X2"}};
+        REQUIRE(library.ImportBooks(records) == 1);
+        imported = library.SearchForBook("Imported");
+
+        Library restored;
+        REQUIRE(restored.LoadSnapshot(path) == SNAPSHOT_LOADED);
+        loaded = restored.SearchForBook("Introduction to Algorithms");
+        listed = restored.GetAllBooks();
+    }
+
+    // Both libraries are gone, the books and the blocks holding them are not
+    CHECK(emplaced != nullptr && emplaced->GetBookName() == "Other");
+    CHECK(imported != nullptr && imported->GetBookNumber() == "X2");
+    int borrower = 0;
+    CHECK(loaded != nullptr && loaded->GetBookBorrower(borrower) && borrower == 2);
+    CHECK(listed.size() == 20);
+    emplaced.reset();
+    listed.clear();
+    CHECK(imported.use_count() == 1 && loaded.use_count() == 1);
+}
+
+/**
+ * @brief A missing, truncated or damaged snapshot is rejected and the library is left as it was.
+*/
+static void TestDamagedFilesAreRejected()
+{
+    string path = ScratchPath("damaged.snap");
+    Library saved;
+    REQUIRE(FillLibrary(saved));
+    REQUIRE(saved.SaveSnapshot(path) == SNAPSHOT_SAVED);
+    string bytes = ReadFile(path);
+    REQUIRE(bytes.size() > 64);
+
+    Library library;
+    REQUIRE(library.EmplaceBook("Other", "Someone", "Poetry", "X1") == ADDED_SUCCESSFULLY);
+    REQUIRE(library.EmplaceUser("grace", 9) == ADDED_SUCCESSFULLY);
+    REQUIRE(library.UserBorrowBook(9, string("X1")) == LOAN_SUCCEEDED);
+    vector<string> before = Describe(library);
+
+    CHECK(library.LoadSnapshot(ScratchPath("missing.snap")) == SNAPSHOT_NOT_OPENED);
+
+    // Cut at several lengths, down to a file shorter than the header
+    for(size_t size : {bytes.size() - 1, bytes.size() / 2, size_t(16), size_t(0)})
+    {
+        WriteFile(path, bytes.substr(0, size));
+        CHECK(library.LoadSnapshot(path) == SNAPSHOT_CORRUPTED);
+        CHECK(Describe(library) == before);
+    }
+
+    // A wrong magic number
+    string damaged = bytes;
+    damaged[0] ^= 0x20;
+    WriteFile(path, damaged);
+    CHECK(library.LoadSnapshot(path) == SNAPSHOT_CORRUPTED);
+
+    // Garbage appended after the sections
+    WriteFile(path, bytes + string(100, '\xff'));
+    CHECK(library.LoadSnapshot(path) == SNAPSHOT_CORRUPTED);
+
+    // Nothing was applied, the library still works as before
+    CHECK(Describe(library) == before);
+    CHECK(library.SearchForBook("Other") != nullptr);
+    CHECK(library.UserReturnBook(9, string("X1")) == LOAN_SUCCEEDED);
+}
+
+/**
+ * @brief A flipped byte anywhere in the file is rejected, or loads a consistent library.
+ *
+ * The records hold no checksum, so a flipped character of a title may well load, but a snapshot
+ * is never half applied and never leaves a loan without a registered borrower.
+*/
+static void TestFlippedBytes()
+{
+    string path = ScratchPath("flipped.snap");
+    Library saved;
+    REQUIRE(FillLibrary(saved));
+    REQUIRE(saved.SaveSnapshot(path) == SNAPSHOT_SAVED);
+    string bytes = ReadFile(path);
+
+    for(size_t offset = 0; offset < bytes.size(); offset++)
+    {
+        string damaged = bytes;
+        damaged[offset] ^= 0x5a;
+        WriteFile(path, damaged);
+
+        Library library;
+        REQUIRE(library.EmplaceBook("Other", "Someone", "Poetry", "X1") == ADDED_SUCCESSFULLY);
+        vector<string> before = Describe(library);
+        if(library.LoadSnapshot(path) != SNAPSHOT_LOADED)
+        {
+            CHECK(Describe(library) == before);
+            continue;
+        }
+
+        // Every book on loan is held by a registered user, and the counters agree
+        vector<int> users;
+        for(User *user : library.GetAllUsers())
+        {
+            users.push_back(user->GetUserId());
+        }
+        size_t borrowed = 0;
+        for(const shared_ptr<Book> &book : library.GetAllBooks())
+        {
+            int borrower = 0;
+            if(book->GetBookBorrower(borrower))
+            {
+                borrowed++;
+                CHECK(find(users.begin(), users.end(), borrower) != users.end());
+            }
+        }
+        CHECK(borrowed == library.CountBorrowedBooks());
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if(argc > 1)
+    {
+        scratch_directory = argv[1];
+    }
+
+    TestRoundTrip();
+    TestLoadReplacesLibrary();
+    TestBooksOutliveLibrary();
+    TestDamagedFilesAreRejected();
+    TestFlippedBytes();
+
+    return (CheckFailures() == 0) ? 0 : 1;
+}
@@ -0,0 +1,408 @@
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iterator>
+#include <thread>
+#include <algorithm>
+#include <unistd.h>
+#include "library.hpp"
+#include "book.hpp"
+#include "user.hpp"
+#include "write_ahead_log.hpp"
+#include "check.hpp"
+
+using namespace std;
+
+/**
+ * @brief Tests of the write-ahead log: a replay rebuilds the logged mutations, concurrent loans
+ * included, a torn or corrupted tail is cut at the last valid record while an intact record the
+ * replay can't read leaves the file untouched, a log that can't be written reports every mutation
+ * as not durable, and a checkpoint empties the log.
+ *
+ * Usage: write_ahead_log_test [directory]   (default: the current directory, for the scratch files)
+ */
+
+/* The directory of the scratch files. */
+static string scratch_directory = ".";
+
+/* The number of records logged by LogMutations(). */
+static const size_t LOGGED_RECORDS = 9;
+
+/**
+ * @brief Gets the path of a scratch file, removing any file left there by a previous run.
+*/
+static string ScratchPath(const string &name)
+{
+    string path = scratch_directory + "/" + name;
+    unlink(path.c_str());
+    return path;
+}
+
+/**
+ * @brief Reads a whole file.
+*/
+static string ReadFile(const string &path)
+{
+    ifstream in(path, ios::binary);
+    return string(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+}
+
+/**
+ * @brief Writes a whole file.
+*/
+static void WriteFile(const string &path, const string &bytes)
+{
+    ofstream out(path, ios::binary | ios::trunc);
+    out.write(bytes.data(), bytes.size());
+}
+
+/**
+ * @brief Frames a payload as a record of the log: length, FNV-1a checksum of the kind and payload, kind.
+*/
+static string FrameRecord(uint8_t kind, const string &payload)
+{
+    uint32_t size = static_cast<uint32_t>(payload.size());
+    uint32_t checksum = 2166136261u;
+    checksum = (checksum ^ kind) * 16777619u;
+    for(char byte : payload)
+    {
+        checksum = (checksum ^ static_cast<uint8_t>(byte)) * 16777619u;
+    }
+    return string(reinterpret_cast<const char *>(&size), sizeof(size)) +
+           string(reinterpret_cast<const char *>(&checksum), sizeof(checksum)) + string(1, static_cast<char>(kind)) + payload;
+}
+
+/**
+ * @brief Describes the books, loans and users of a library in a canonical order.
+*/
+static vector<string> Describe(Library &library)
+{
+    vector<string> lines;
+    for(const shared_ptr<Book> &book : library.GetAllBooks())
+    {
+        int borrower = 0;
+        book->GetBookBorrower(borrower);
+        lines.push_back("book " + book->GetBookNumber() + " " + book->GetBookName() + " " + to_string(borrower));
+    }
+    for(User *user : library.GetAllUsers())
+    {
+        lines.push_back("user " + to_string(user->GetUserId()) + " " + user->GetUserName());
+    }
+    sort(lines.begin(), lines.end());
+    return lines;
+}
+
+/**
+ * @brief Applies one mutation of every kind to a library, the last one adds the book "B9".
+*/
+static void LogMutations(Library &library)
+{
+    CHECK(library.EmplaceBook("Optics", "Hecht", "Physics", "B1") == ADDED_SUCCESSFULLY);
+    CHECK(library.EmplaceBook("Calculus", "Spivak", "Mathematics", "978-0-914098-91-1") == ADDED_SUCCESSFULLY);
+    CHECK(library.EmplaceBook("Torts", "Prosser", "Law", "B3") == ADDED_SUCCESSFULLY);
+    CHECK(library.EmplaceUser("ada", 1) == ADDED_SUCCESSFULLY);
+    CHECK(library.EmplaceUser("alan", 2) == ADDED_SUCCESSFULLY);
+    CHECK(library.UserBorrowBook(1, string("B1")) == LOAN_SUCCEEDED);
+    CHECK(library.UserBorrowBook(2, string("0914098918")) == LOAN_SUCCEEDED);
+    CHECK(library.RemoveBookFromLibrary("B3") == REMOVED);
+    CHECK(library.EmplaceBook("Statics", "Meriam", "Engineering", "B9") == ADDED_SUCCESSFULLY);
+}
+
+/**
+ * @brief Replays a log file into a new library.
+ *
+ * @param path The path of the log.
+ * @param library The library the records are applied to.
+ * @return The number of records replayed.
+*/
+static size_t ReplayFile(const string &path, Library &library)
+{
+    WriteAheadLog wal;
+    if(!CHECK(wal.Open(path)))
+    {
+        return 0;
+    }
+    return wal.Replay(library);
+}
+
+/**
+ * @brief A replay rebuilds every logged mutation.
+*/
+static void TestReplay()
+{
+    string path = ScratchPath("replay.wal");
+    Library logged;
+    {
+        WriteAheadLog wal;
+        REQUIRE(wal.Open(path));
+        REQUIRE(wal.Replay(logged) == 0);
+        logged.AttachLog(&wal);
+        LogMutations(logged);
+        logged.AttachLog(nullptr);
+    }
+
+    Library replayed;
+    CHECK(ReplayFile(path, replayed) == LOGGED_RECORDS);
+    CHECK(Describe(replayed) == Describe(logged));
+    CHECK(replayed.CountBorrowedBooks() == 2);
+}
+
+/**
+ * @brief A torn last record is dropped and cut, the next records follow the last valid one.
+*/
+static void TestTornTail()
+{
+    string path = ScratchPath("torn.wal");
+    Library logged;
+    {
+        WriteAheadLog wal;
+        REQUIRE(wal.Open(path));
+        REQUIRE(wal.Replay(logged) == 0);
+        logged.AttachLog(&wal);
+        LogMutations(logged);
+        logged.AttachLog(nullptr);
+    }
+    string bytes = ReadFile(path);
+
+    // Every cut inside the last record loses that record alone
+    for(size_t cut = 1; cut < 12; cut++)
+    {
+        WriteFile(path, bytes.substr(0, bytes.size() - cut));
+        Library replayed;
+        CHECK(ReplayFile(path, replayed) == LOGGED_RECORDS - 1);
+        CHECK(replayed.SearchForBook("Statics") == nullptr);
+        CHECK(replayed.SearchForBook("Optics") != nullptr);
+    }
+
+    // The torn tail is cut, so a record appended after the replay is replayed in turn
+    WriteFile(path, bytes.substr(0, bytes.size() - 5));
+    {
+        Library library;
+        WriteAheadLog wal;
+        REQUIRE(wal.Open(path));
+        REQUIRE(wal.Replay(library) == LOGGED_RECORDS - 1);
+        library.AttachLog(&wal);
+        CHECK(library.EmplaceBook("Dynamics", "Meriam", "Engineering", "B10") == ADDED_SUCCESSFULLY);
+        library.AttachLog(nullptr);
+    }
+    Library reopened;
+    CHECK(ReplayFile(path, reopened) == LOGGED_RECORDS);
+    CHECK(reopened.SearchForBook("Dynamics") != nullptr);
+    CHECK(reopened.SearchForBook("Statics") == nullptr);
+
+    // Garbage after the last record is ignored
+    WriteFile(path, bytes + string(7, '\x5a'));
+    Library padded;
+    CHECK(ReplayFile(path, padded) == LOGGED_RECORDS);
+    CHECK(Describe(padded) == Describe(logged));
+
+    // A corrupted record ends the log, nothing after it is applied
+    string damaged = bytes;
+    damaged[bytes.size() / 2] ^= 0x40;
+    WriteFile(path, damaged);
+    Library cut;
+    size_t count = ReplayFile(path, cut);
+    CHECK(count < LOGGED_RECORDS);
+    CHECK(cut.SearchForBook("Statics") == nullptr);
+    CHECK(ReadFile(path).size() < bytes.size());
+}
+
+/**
+ * @brief An intact record the replay can't read stops it, without cutting the file or logging after it.
+*/
+static void TestUnreadableRecord()
+{
+    string path = ScratchPath("unreadable.wal");
+    Library logged;
+    {
+        WriteAheadLog wal;
+        REQUIRE(wal.Open(path));
+        REQUIRE(wal.Replay(logged) == 0);
+        logged.AttachLog(&wal);
+        LogMutations(logged);
+        logged.AttachLog(nullptr);
+    }
+    string bytes = ReadFile(path);
+
+    // A kind unknown to this version, then known kinds whose payload is too short for their fields:
+    // a loan holds the user ID and both words of the book key
+    string short_loan = FrameRecord(LOG_BORROW_BOOK, string("\x01\0\0\0", 4) + string(8, '\0'));
+    for(const string &record : {FrameRecord(42, "from a later version"), FrameRecord(LOG_REMOVE_USER, "ab"), short_loan})
+    {
+        string content = bytes + record + FrameRecord(LOG_REMOVE_BOOK, string("\x02\0\0\0B1", 6));
+        WriteFile(path, content);
+
+        Library library;
+        WriteAheadLog wal;
+        REQUIRE(wal.Open(path));
+        CHECK(wal.Replay(library) == LOGGED_RECORDS);
+        CHECK(!wal.IsHealthy());
+        CHECK(Describe(library) == Describe(logged));
+
+        // The log refuses new records, and the file keeps every byte
+        library.AttachLog(&wal);
+        CHECK(library.EmplaceBook("Dynamics", "Meriam", "Engineering", "B10") == ADDED_NOT_DURABLE);
+        library.AttachLog(nullptr);
+        CHECK(ReadFile(path) == content);
+    }
+}
+
+/**
+ * @brief A log whose writes fail reports every mutation as applied but not durable.
+ *
+ * The log is opened on /dev/full, where every write fails with ENOSPC.
+*/
+static void TestFailedWrites()
+{
+    Library library;
+    WriteAheadLog wal;
+    REQUIRE(wal.Open("/dev/full"));
+    REQUIRE(wal.Replay(library) == 0);
+    library.AttachLog(&wal);
+
+    CHECK(library.EmplaceBook("Optics", "Hecht", "Physics", "B1") == ADDED_NOT_DURABLE);
+    CHECK(library.AddNewBookToLibrary(new Book("Torts", "Prosser", "Law", "B3")) == ADDED_NOT_DURABLE);
+    CHECK(library.EmplaceUser("ada", 1) == ADDED_NOT_DURABLE);
+    CHECK(library.RegisterNewUser(new User("alan", 2)) == ADDED_NOT_DURABLE);
+    CHECK(library.UserBorrowBook(1, string("B1")) == LOAN_NOT_DURABLE);
+    CHECK(library.UserReturnBook(1, string("B1")) == LOAN_NOT_DURABLE);
+
+    // In a batch only the operations applied are not durable, the refused ones keep their status
+    loan_request_t requests[] = {{2, IsbnKey::FromString("B1")}, {1, IsbnKey::FromString("B1")}};
+    vector<loan_status_t> results = library.BorrowBooks(requests, 2);
+    CHECK(results.size() == 2 && results[0] == LOAN_NOT_DURABLE && results[1] == LOAN_NOT_AVAILABLE);
+    results = library.ReturnBooks(requests, 2);
+    CHECK(results.size() == 2 && results[0] == LOAN_NOT_DURABLE && results[1] == LOAN_NOT_BORROWED);
+
+    vector<BookRecord> records = {{"Statics", "Meriam", "Engineering", "B9"}, {"Optics", "Hecht", "Physics", "B1"}};
+    bool durable = true;
+    CHECK(library.ImportBooks(records, &durable) == 1);
+    CHECK(!durable);
+
+    CHECK(library.RemoveBookFromLibrary("B3") == REMOVED_NOT_DURABLE);
+    CHECK(library.RemoveUserFromLibrary(2) == REMOVED_NOT_DURABLE);
+
+    // The mutations are applied all the same, only their durability is lost
+    CHECK(library.SearchForBook("Statics") != nullptr);
+    CHECK(library.SearchForBook("Torts") == nullptr);
+    CHECK(library.GetAllUsers().size() == 1);
+    library.AttachLog(nullptr);
+}
+
+/**
+ * @brief A checkpoint empties the log, and the snapshot plus the later records rebuild the library.
+*/
+static void TestCheckpoint()
+{
+    string path = ScratchPath("checkpoint.snap");
+    string log_path = ScratchPath("checkpoint.snap.wal");
+    Library library;
+    {
+        WriteAheadLog wal;
+        REQUIRE(wal.Open(log_path));
+        REQUIRE(wal.Replay(library) == 0);
+        library.AttachLog(&wal);
+        LogMutations(library);
+        REQUIRE(library.Checkpoint(path) == SNAPSHOT_SAVED);
+        CHECK(ReadFile(log_path).empty());
+
+        // Only the mutations after the checkpoint are logged
+        CHECK(library.UserReturnBook(1, string("B1")) == LOAN_SUCCEEDED);
+        CHECK(library.EmplaceUser("grace", 3) == ADDED_SUCCESSFULLY);
+        library.AttachLog(nullptr);
+    }
+
+    Library restored;
+    REQUIRE(restored.LoadSnapshot(path) == SNAPSHOT_LOADED);
+    CHECK(ReplayFile(log_path, restored) == 2);
+    CHECK(Describe(restored) == Describe(library));
+}
+
+/**
+ * @brief Returns racing the loans of the same books replay to the loans of the live library.
+ *
+ * Every book starts on loan and changes hands once: its holder returns it while the other users
+ * keep trying to claim it. A return logged after the loan that followed it would replay as a
+ * refused loan then a return, and lose the loan for good.
+*/
+static void TestConcurrentLoans()
+{
+    const int USERS = 8;
+    const int BOOKS = 256;
+    string path = ScratchPath("concurrent.wal");
+    Library logged;
+    {
+        WriteAheadLog wal;
+        REQUIRE(wal.Open(path));
+        REQUIRE(wal.Replay(logged) == 0);
+        logged.AttachLog(&wal);
+        for(int user = 1; user <= USERS; user++)
+        {
+            REQUIRE(logged.EmplaceUser("user " + to_string(user), user) == ADDED_SUCCESSFULLY);
+        }
+        for(int book = 0; book < BOOKS; book++)
+        {
+            string serial = "C" + to_string(book);
+            REQUIRE(logged.EmplaceBook("Title " + to_string(book), "Author", "Genre", serial) == ADDED_SUCCESSFULLY);
+            REQUIRE(logged.UserBorrowBook(book % USERS + 1, serial) == LOAN_SUCCEEDED);
+        }
+
+        // Every user walks the books in order, the odd ones through the batch calls
+        vector<thread> threads;
+        for(int user = 1; user <= USERS; user++)
+        {
+            threads.emplace_back([&logged, user]()
+            {
+                for(int book = 0; book < BOOKS; book++)
+                {
+                    string serial = "C" + to_string(book);
+                    loan_request_t request = {user, IsbnKey::FromString(serial)};
+                    bool batch = (book % 2 == 1);
+                    int holder = book % USERS + 1;
+                    if(user == holder)
+                    {
+                        // The holder hands the book back once
+                        CHECK((batch ? logged.ReturnBooks(&request, 1)[0] : logged.UserReturnBook(user, serial)) == LOAN_SUCCEEDED);
+                        continue;
+                    }
+
+                    // The others try to claim it until one of them holds it
+                    int borrower = 0;
+                    while((batch ? logged.BorrowBooks(&request, 1)[0] : logged.UserBorrowBook(user, serial)) != LOAN_SUCCEEDED &&
+                          !(logged.FindBookBorrower(serial, borrower) && borrower != holder))
+                    {
+                        this_thread::yield();
+                    }
+                }
+            });
+        }
+        for(thread &worker : threads)
+        {
+            worker.join();
+        }
+        logged.AttachLog(nullptr);
+    }
+    REQUIRE(logged.CountBorrowedBooks() == size_t(BOOKS));
+
+    Library replayed;
+    CHECK(ReplayFile(path, replayed) > size_t(USERS + 3 * BOOKS));
+    CHECK(Describe(replayed) == Describe(logged));
+    CHECK(replayed.CountBorrowedBooks() == size_t(BOOKS));
+}
+
+int main(int argc, char **argv)
+{
+    if(argc > 1)
+    {
+        scratch_directory = argv[1];
+    }
+
+    TestReplay();
+    TestTornTail();
+    TestUnreadableRecord();
+    TestConcurrentLoans();
+    TestFailedWrites();
+    TestCheckpoint();
+
+    return (CheckFailures() == 0) ? 0 : 1;
+}